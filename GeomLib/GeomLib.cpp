@@ -1,14 +1,27 @@
+#define GEOMLIB_COUNTERS
 #include "source/ThreadPool.h"
 #include "source/TessModel.h"
 #include "source/Cylinder.h"
 #include "source/Testing.h"
 #include "source/Segment.h"
+#include "source/SegmentIntersector.h"
 #include "source/Matrix.h"
+#include "source/Quaternion.h"
+#include "source/Expression.h"
+#include "source/Raycaster.h"
+#include "source/MassProperties.h"
+#include "source/Slicer.h"
+#include "source/ConvexHull.h"
+#include "source/Circle.h"
+#include "source/OBB.h"
+#include "source/MeshIO.h"
 #include "source/Timer.h"
 #include "source/Line.h"
 #include "source/Ray.h"
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <stdexcept>
 
 using namespace geomlib;
 
@@ -214,6 +227,1066 @@ int main()
 	SUBTEST_EQ("Invertion", coordTrue * tmp, one);
 	//SUBTEST_ASSERT("Impossible invertion", !coordFalse.Invertion(tmp));
 
+
+	TEST("Acceleration structure");
+
+	TessModel<double> accel;
+	accel.SplitCylinder(Cylinder<double>(Point<double>(0, 0, 0), Vector<double>(0, 0, 1), 2), 4, 0.01);
+	Ray<double> side(Point<double>(5, 0.3, 1.3), Vector<double>(-1, 0, 0));
+	Point<double> hitFast, hitLinear;
+	int indFast, indLinear;
+	bool found = accel.FindIntersection(side, hitFast, indFast);
+	accel.FindIntersection(side, hitLinear, indLinear, 0, accel.Acceleration().Indices().size());
+	SUBTEST_ASSERT("Hit through tree", found && indFast >= 0);
+	SUBTEST_EQ("Same hit as linear scan", hitFast, hitLinear);
+	TessModel<double> accelEmpty;
+	Ray<double> accelAway(Point<double>(5, 0.3, 1.3), Vector<double>(1, 0, 0));
+	SUBTEST_ASSERT("Misses report false", !accel.FindIntersection(accelAway, hitLinear, indLinear, 0, accel.TrianglesCount()) && indLinear == -1 &&
+		!accelEmpty.FindIntersection(side, hitLinear, indLinear) && indLinear == -1);
+
+	accel.TransformSurface(2, Matrix<double>::TranslationInit(Vector<double>(30, 0, 0)));
+	SUBTEST_ASSERT("Refit after move 1", !accel.FindIntersection(side, hitFast, indFast));
+	side = Ray<double>(Point<double>(40, 0.3, 1.3), Vector<double>(-1, 0, 0));
+	SUBTEST_ASSERT("Refit after move 2", accel.FindIntersection(side, hitFast, indFast) && accel.GetSurfaceByTriangle(indFast) == 2);
+	SUBTEST_ASSERT("Degradation after move", accel.Acceleration().NeedsRebuild());
+
+	{
+		ThreadPool accelPool(2);
+		accel.SetThreadPool(&accelPool);
+		accel.TransformSurface(2, Matrix<double>::GetIdentity());
+		accelPool.WaitEnd();
+		SUBTEST_ASSERT("Background rebuild", accel.SyncAcceleration() && !accel.Acceleration().NeedsRebuild());
+		accel.SetThreadPool(nullptr);
+	}
+	SUBTEST_ASSERT("Hit after rebuild", accel.FindIntersection(side, hitFast, indFast) && accel.GetSurfaceByTriangle(indFast) == 2);
+
+
+	TEST("Merging models");
+
+	std::vector<TessModel<double>> parts(50);
+	for (int i = 0; i < (int)parts.size(); i++)
+		parts[i].SplitCylinder(Cylinder<double>(Point<double>(5 * i, 0, 0), Vector<double>(0, 0, 1), 1), 1, 0.1);
+	TessModel<double> sequential, bulk, moved;
+	for (auto& part : parts)
+		sequential.MergeModels(part);
+	{
+		ThreadPool mergePool(4);
+		bulk.MergeAll(parts, &mergePool);
+	}
+	Ray<double> across(Point<double>(35, -10, 0.4), Vector<double>(0, 1, 0));
+	SUBTEST_EQ("Same size", bulk.TrianglesCount(), sequential.TrianglesCount());
+	SUBTEST_EQ("Surfaces count", bulk.SurfacesCount(), 3 * (int)parts.size());
+	SUBTEST_ASSERT("Hit in merged model", bulk.FindIntersection(across, hitFast, indFast) && bulk.GetSurfaceByTriangle(indFast) == 23);
+	SUBTEST_ASSERT("Same hit after sequential merge", sequential.FindIntersection(across, hitLinear, indLinear) && indLinear == indFast && hitFast == hitLinear);
+
+	moved.MergeModels(std::move(parts[7]));
+	SUBTEST_ASSERT("Merge by move", parts[7].IsEmpty() && moved.FindIntersection(across, hitLinear, indLinear) && moved.GetSurfaceByTriangle(indLinear) == 2);
+	moved.AddSurface({ Point<double>(34, -5, 0), Point<double>(36, -5, 0), Point<double>(35, -5, 2) }, {}, { { 0, 1, 2 } });
+	SUBTEST_ASSERT("Added surface", moved.FindIntersection(across, hitLinear, indLinear) && moved.GetSurfaceByTriangle(indLinear) == 3);
+
+
+	TEST("Normals");
+
+	TessModel<double> normModel, normParallel;
+	normModel.SplitCylinder(Cylinder<double>(Point<double>(0, 0, 0), Vector<double>(0, 0, 1), 2), 4, 0.01);
+	Vector<double> capNormal = normModel.NormalToTriangle(0);
+	SUBTEST_ASSERT("Cap face normal", capNormal.IsParallel(Vector<double>(0, 0, 1)) && AreEqual(capNormal.Length(), 1));
+	normModel.TransformSurface(0, Matrix<double>::RotationAroundXInit(acos(-1)));
+	SUBTEST_ASSERT("Face normal after move", normModel.NormalToTriangle(0) == capNormal.Opposite());
+	normModel.TransformSurface(0, Matrix<double>::RotationAroundXInit(acos(-1)));
+
+	normParallel = normModel;
+	normModel.RecomputeVertexNormals(false);
+	SUBTEST_ASSERT("Area weighted cap normal", normModel.GetNormal(normModel.GetTriangle(0).ind[0]).IsParallel(Vector<double>(0, 0, 1)));
+	{
+		ThreadPool normalsPool(4);
+		normParallel.RecomputeVertexNormals(false, &normalsPool);
+	}
+	bool sameNormals = true;
+	for (int i = 0; i < normModel.PointsCount(); i++)
+		sameNormals = sameNormals && normModel.GetNormal(i).X() == normParallel.GetNormal(i).X() && normModel.GetNormal(i).Y() == normParallel.GetNormal(i).Y() && normModel.GetNormal(i).Z() == normParallel.GetNormal(i).Z();
+	SUBTEST_ASSERT("Parallel recomputation is deterministic", sameNormals);
+	normModel.RecomputeVertexNormals(true);
+	int sideVertex = normModel.GetTriangle(normModel.TrianglesCount() - 1).ind[0];
+	Vector<double> radial = normModel.GetPoint(sideVertex) - Point<double>(0, 0, normModel.GetPoint(sideVertex).Z());
+	SUBTEST_ASSERT("Angle weighted side normal", normModel.GetNormal(sideVertex).IsParallel(radial) && AreEqual(normModel.GetNormal(sideVertex).Length(), 1));
+
+	TEST("Compressed storage");
+
+	TessModel<double> packModel, unpacked;
+	packModel.SplitCylinder(Cylinder<double>(Point<double>(0, 0, 0), Vector<double>(0, 0, 1), 2), 4, 0.01);
+	std::stringstream plain, packed;
+	packModel.Serialize(plain);
+	packModel.SerializeCompressed(packed);
+	unpacked.DeserializeCompressed(packed);
+	SUBTEST_EQ("Triangles kept", unpacked.TrianglesCount(), packModel.TrianglesCount());
+	SUBTEST_EQ("Surfaces kept", unpacked.SurfacesCount(), packModel.SurfacesCount());
+	SUBTEST_ASSERT("Smaller than plain storage", packed.str().size() < plain.str().size() / 3);
+	Vector<double> packStep = packModel.Bounds().Extent() * (1.0 / 65535);
+	double worstError = 0;
+	for (int i = 0; i < unpacked.PointsCount(); i++)
+	{
+		double nearest = DBL_MAX;
+		for (int j = 0; j < packModel.PointsCount(); j++)
+		{
+			Vector<double> d = unpacked.GetPoint(i) - packModel.GetPoint(j);
+			nearest = std::min(nearest, std::max(std::max(abs(d.X()) / packStep.X(), abs(d.Y()) / packStep.Y()), abs(d.Z()) / packStep.Z()));
+		}
+		worstError = std::max(worstError, nearest);
+	}
+	SUBTEST_ASSERT("Quantization error within half step", worstError <= 0.5 + 1e-6);
+	Point<double> packHit, unpackHit;
+	int packInd, unpackInd;
+	Ray<double> packRay(Point<double>(10, 0.3, 1.3), Vector<double>(-1, 0, 0));
+	packModel.FindIntersection(packRay, packHit, packInd);
+	unpacked.FindIntersection(packRay, unpackHit, unpackInd);
+	SUBTEST_ASSERT("Same hit after round trip", (packHit - unpackHit).Length() < 1e-3 && packModel.GetSurfaceByTriangle(packInd) == unpacked.GetSurfaceByTriangle(unpackInd));
+	std::string packBlob = packed.str();
+	bool truncatedFails = true;
+	for (int len : { 0, 10, 24, 72, 76, 200, (int)packBlob.size() / 2, (int)packBlob.size() - 1 })
+	{
+		std::stringstream cut(packBlob.substr(0, len));
+		truncatedFails = truncatedFails && !unpacked.DeserializeCompressed(cut) && unpacked.IsEmpty() && unpacked.SurfacesCount() == 0;
+	}
+	SUBTEST_ASSERT("Truncated input fails", truncatedFails);
+	//header is posBits, normBits, vertices, normals flag, triangles, surfaces
+	auto corrupt = [&packBlob](int field, int val) {
+		std::string blob = packBlob;
+		blob.replace(field * sizeof(int), sizeof(int), (const char*)&val, sizeof(int));
+		return std::stringstream(blob);
+	};
+	std::stringstream hugeCount = corrupt(4, 1 << 29), wideBits = corrupt(0, 40), fewVertices = corrupt(2, 3);
+	SUBTEST_ASSERT("Corrupt header fails", !unpacked.DeserializeCompressed(hugeCount) && !unpacked.DeserializeCompressed(wideBits) && !unpacked.DeserializeCompressed(fewVertices) && unpacked.IsEmpty());
+	std::string badSurfaces = packBlob;
+	badSurfaces.back() = (char)0x7F;
+	std::stringstream badEnds(badSurfaces);
+	SUBTEST_ASSERT("Surface past the triangles fails", !unpacked.DeserializeCompressed(badEnds) && unpacked.IsEmpty());
+	std::stringstream packedAgain(packBlob);
+	SUBTEST_ASSERT("Intact input still loads", unpacked.DeserializeCompressed(packedAgain) && unpacked.TrianglesCount() == packModel.TrianglesCount());
+
+	TEST("Mesh formats");
+
+	TessModel<double> ioModel, fromObj, fromStl, fromAscii;
+	ioModel.SplitCylinder(Cylinder<double>(Point<double>(0, 0, 0), Vector<double>(0, 0, 1), 2), 4, 0.01);
+	{
+		ThreadPool ioPool(4);
+		SUBTEST_ASSERT("Write files", SaveOBJ(ioModel, "io_test.obj", &ioPool) && SaveSTL(ioModel, "io_test.stl") && SaveSTL(ioModel, "io_test_ascii.stl", false, &ioPool));
+		SUBTEST_ASSERT("Read files", LoadOBJ(fromObj, "io_test.obj", &ioPool) && LoadSTL(fromStl, "io_test.stl") && LoadSTL(fromAscii, "io_test_ascii.stl", &ioPool));
+	}
+	std::remove("io_test.obj");
+	std::remove("io_test.stl");
+	std::remove("io_test_ascii.stl");
+	bool samePoints = fromObj.PointsCount() == ioModel.PointsCount();
+	for (int i = 0; samePoints && i < ioModel.PointsCount(); i++)
+		samePoints = fromObj.GetPoint(i).X() == ioModel.GetPoint(i).X() && fromObj.GetPoint(i).Y() == ioModel.GetPoint(i).Y() && fromObj.GetPoint(i).Z() == ioModel.GetPoint(i).Z();
+	SUBTEST_ASSERT("OBJ keeps exact points", samePoints);
+	SUBTEST_ASSERT("OBJ keeps surfaces", fromObj.SurfacesCount() == ioModel.SurfacesCount() && fromObj.TrianglesCount() == ioModel.TrianglesCount());
+	SUBTEST_ASSERT("Binary STL keeps triangles", fromStl.TrianglesCount() == ioModel.TrianglesCount() && fromStl.SurfacesCount() == 1);
+	SUBTEST_ASSERT("ASCII STL keeps surfaces", fromAscii.SurfacesCount() == ioModel.SurfacesCount() && fromAscii.PointsCount() <= ioModel.PointsCount());
+	Point<double> ioHit, stlHit;
+	int ioInd, stlInd;
+	Ray<double> ioRay(Point<double>(10, 0.3, 1.3), Vector<double>(-1, 0, 0));
+	ioModel.FindIntersection(ioRay, ioHit, ioInd);
+	SUBTEST_ASSERT("Same hit after STL", fromStl.FindIntersection(ioRay, stlHit, stlInd) && (ioHit - stlHit).Length() < 1e-5);
+	{
+		//two squares side by side, the groups share the vertices of the common edge
+		std::ofstream sharedFile("io_shared.obj", std::ios::binary);
+		sharedFile << "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv 2 0 0\nv 2 1 0\ng left\nf 1 2 3\nf 1 3 4\ng right\nf 2 5 6\nf 2 6 3\n";
+	}
+	TessModel<double> sharedObj;
+	SUBTEST_ASSERT("Read shared vertices", LoadOBJ(sharedObj, "io_shared.obj") && sharedObj.SurfacesCount() == 2 && sharedObj.PointsCount() == 8);
+	std::remove("io_shared.obj");
+	sharedObj.TransformSurface(0, Matrix<double>::TranslationInit(Vector<double>(0, 0, 5)));
+	Point<double> sharedHit;
+	int sharedInd;
+	bool rightKept = true;
+	for (double x : { 1.05, 1.5, 1.95 })
+		rightKept = rightKept && sharedObj.FindIntersection(Ray<double>(Point<double>(x, 0.9, 10), Vector<double>(0, 0, -1)), sharedHit, sharedInd) && sharedObj.GetSurfaceByTriangle(sharedInd) == 1 && sharedHit.Z() == 0;
+	SUBTEST_ASSERT("Moving a surface keeps its neighbour", rightKept && sharedObj.SurfaceBounds(1).Max().Z() == 0 && sharedObj.SurfaceBounds(0).Min().Z() == 5);
+	{
+		std::ofstream crlfFile("io_crlf.obj", std::ios::binary);
+		crlfFile << "v 0 0 0\r\nv 1 0 0\r\nv 0 1 0\r\nvn 0 0 1\r\nf 1//1 2//1 3//1\r\n";
+		std::ofstream bareFile("io_bare.obj", std::ios::binary);
+		//the bare line comes after the vertices that have coordinates
+		bareFile << "v 0 0 0\r\nv 1 0 0\r\nv 0 1 0\r\nv\r\nvn\nf 1 2 3\r\n";
+	}
+	TessModel<double> crlfObj, bareObj;
+	SUBTEST_ASSERT("Read CRLF lines", LoadOBJ(crlfObj, "io_crlf.obj") && crlfObj.TrianglesCount() == 1 && crlfObj.PointsCount() == 3 && crlfObj.HasNormals());
+	SUBTEST_ASSERT("Bare vertex line fails", !LoadOBJ(bareObj, "io_bare.obj") && bareObj.IsEmpty());
+	std::remove("io_crlf.obj");
+	std::remove("io_bare.obj");
+
+	TEST("Layout");
+
+	SUBTEST_EQ("Morton code of axes", Morton30(1, 2, 4), (uint32_t)0b1010100);
+	SUBTEST_EQ("Morton code of corner", Morton63(0x1FFFFF, 0x1FFFFF, 0x1FFFFF), 0x7FFFFFFFFFFFFFFFull);
+	TessModel<double> layout, ordered;
+	layout.SplitCylinder(Cylinder<double>(Point<double>(0, 0, 0), Vector<double>(0, 0, 1), 2), 4, 0.01);
+	ordered = layout;
+	{
+		ThreadPool layoutPool(4);
+		ordered.OptimizeLayout(&layoutPool);
+	}
+	SUBTEST_ASSERT("Surfaces kept", ordered.SurfacesCount() == layout.SurfacesCount() && ordered.TrianglesCount() == layout.TrianglesCount());
+	bool sameSurfaces = true;
+	for (int s = 0; s < layout.SurfacesCount(); s++)
+	{
+		int first, last;
+		layout.SurfaceRange(s, first, last);
+		std::multiset<std::string> before, after;
+		for (int i = first; i <= last; i++)
+		{
+			before.insert(layout.GetPoint(layout.GetTriangle(i).ind[0]).ToString() + layout.GetPoint(layout.GetTriangle(i).ind[1]).ToString() + layout.GetPoint(layout.GetTriangle(i).ind[2]).ToString());
+			after.insert(ordered.GetPoint(ordered.GetTriangle(i).ind[0]).ToString() + ordered.GetPoint(ordered.GetTriangle(i).ind[1]).ToString() + ordered.GetPoint(ordered.GetTriangle(i).ind[2]).ToString());
+		}
+		sameSurfaces = sameSurfaces && before == after;
+	}
+	SUBTEST_ASSERT("Same triangles in every surface", sameSurfaces);
+	SUBTEST_ASSERT("Vertices numbered by first use", ordered.GetTriangle(0).ind[0] == 0 && ordered.GetTriangle(0).ind[1] <= 2 && ordered.GetTriangle(0).ind[2] <= 2);
+	Point<double> layoutHit, orderedHit;
+	int layoutInd, orderedInd;
+	Ray<double> layoutRay(Point<double>(10, 0.3, 1.3), Vector<double>(-1, 0, 0));
+	layout.FindIntersection(layoutRay, layoutHit, layoutInd);
+	SUBTEST_ASSERT("Same hit after reordering", ordered.FindIntersection(layoutRay, orderedHit, orderedInd) && orderedHit == layoutHit);
+
+	TEST("Linear build");
+
+	std::vector<uint64_t> radixKeys, sortedKeys;
+	std::vector<int> radixValues;
+	for (int i = 0; i < 200000; i++)
+	{
+		radixKeys.push_back(((uint64_t)i * 2654435761u) % 1000003);
+		radixValues.push_back(i);
+	}
+	sortedKeys = radixKeys;
+	std::stable_sort(sortedKeys.begin(), sortedKeys.end());
+	{
+		ThreadPool radixPool(4);
+		RadixSort(radixKeys, radixValues, 20, &radixPool);
+	}
+	bool radixStable = true;
+	for (int i = 1; i < (int)radixKeys.size(); i++)
+		radixStable = radixStable && (radixKeys[i - 1] < radixKeys[i] || radixValues[i - 1] < radixValues[i]);
+	SUBTEST_ASSERT("Radix sort", radixKeys == sortedKeys && radixStable);
+	{
+		ThreadPool throwPool(2);
+		std::atomic<int> throwVisited{ 0 };
+		bool throwCaught = false;
+		try
+		{
+			throwPool.ParallelFor(0, 64, [&](int from, int to) {
+				throwVisited += to - from;
+				if (from <= 13 && 13 < to)
+					throw std::runtime_error("chunk failed");
+			});
+		}
+		catch (const std::runtime_error& err)
+		{
+			throwCaught = std::string(err.what()) == "chunk failed";
+		}
+		throwPool.WaitEnd();
+		SUBTEST_ASSERT("Exception from a chunk", throwCaught && throwVisited == 64);
+	}
+
+	TessModel<double> linear, linearSerial;
+	linear.SplitCylinder(Cylinder<double>(Point<double>(0, 0, 0), Vector<double>(0, 0, 1), 2), 4, 0.001);
+	linearSerial = linear;
+	{
+		ThreadPool linearPool(4);
+		linear.RebuildAcceleration(&linearPool, true);
+	}
+	linearSerial.RebuildAcceleration(nullptr, true);
+	const BVH<double>& lbvh = linear.Acceleration();
+	std::vector<int> leafHits(linear.TrianglesCount(), 0);
+	bool boxesNested = true;
+	for (const auto& node : lbvh.Nodes())
+	{
+		for (int i = node.first; i < node.first + node.count; i++)
+			leafHits[lbvh.Indices()[i]]++;
+		if (!node.IsLeaf())
+			boxesNested = boxesNested && node.box.Contains(lbvh.Nodes()[node.left].box) && node.box.Contains(lbvh.Nodes()[node.right].box);
+	}
+	SUBTEST_ASSERT("Every triangle in one leaf", std::count(leafHits.begin(), leafHits.end(), 1) == linear.TrianglesCount());
+	SUBTEST_ASSERT("Boxes contain children", boxesNested);
+	SUBTEST_ASSERT("Same tree with and without pool", lbvh.Indices() == linearSerial.Acceleration().Indices() && lbvh.Nodes().size() == linearSerial.Acceleration().Nodes().size());
+	Point<double> linearHit, sahHit;
+	int linearInd, sahInd;
+	Ray<double> linearRay(Point<double>(10, 0.3, 1.3), Vector<double>(-1, 0, 0));
+	linear.FindIntersection(linearRay, linearHit, linearInd);
+	linearSerial.RebuildAcceleration();
+	linearSerial.FindIntersection(linearRay, sahHit, sahInd);
+	SUBTEST_ASSERT("Same hit as SAH tree", linearHit == sahHit && linearInd == sahInd);
+
+	TEST("Intersection results");
+
+	IntersectionResult<double> hits;
+	Cylinder<double> hitCyl(Point<double>(0, 0, 0), Vector<double>(0, 0, 1), 2);
+	SUBTEST_ASSERT("Line through cylinder", hitCyl.FindIntersections(Line<double>(Point<double>(-5, 0, 1), Vector<double>(1, 0, 0)), hits) && hits.Count() == 2
+		&& hits[0] == Point<double>(-2, 0, 1) && hits[1] == Point<double>(2, 0, 1) && AreEqual(hits.Parameter(0), 3) && AreEqual(hits.Parameter(1), 7));
+	SUBTEST_ASSERT("Ray from inside of cylinder", hitCyl.FindIntersections(Ray<double>(Point<double>(0, 0, 1), Vector<double>(0, 2, 1)), hits) && hits.Count() == 1 && hits[0] == Point<double>(0, 2, 2) && AreEqual(hits.Parameter(0), 1));
+	SUBTEST_ASSERT("Tangent to cylinder", hitCyl.IsTangent(Line<double>(Point<double>(3, 2, 0), Vector<double>(1, 0, 1))) && hitCyl.FindIntersections(Line<double>(Point<double>(3, 2, 0), Vector<double>(1, 0, 1))).size() == 1);
+	SUBTEST_ASSERT("Segment short of cylinder", !hitCyl.FindIntersections(Segment<double>(Point<double>(-5, 0, 1), Point<double>(-3, 0, 1)), hits) && hits.IsEmpty());
+	SUBTEST_ASSERT("Plane parameter", Plane<double>(Point<double>(0, 0, 3), Vector<double>(0, 0, 1)).FindIntersections(Ray<double>(Point<double>(1, 1, 1), Vector<double>(0, 0, 4)), hits) && AreEqual(hits.Parameter(0), 0.5));
+	SUBTEST_ASSERT("Line parameter", Line<double>(Point<double>(0, 0, 0), Vector<double>(1, 0, 0)).FindIntersections(Segment<double>(Point<double>(3, -1, 0), Point<double>(3, 3, 0)), hits) && hits[0] == Point<double>(3, 0, 0) && AreEqual(hits.Parameter(0), 0.25));
+	hitCyl.FindIntersections(Line<double>(Point<double>(-5, 0, 1), Vector<double>(1, 0, 0)), hits);
+	SUBTEST_ASSERT("Vector wrapper", hitCyl.FindIntersections(Line<double>(Point<double>(-5, 0, 1), Vector<double>(1, 0, 0))) == hits.ToVector());
+
+	TEST("Fused line intersection");
+
+	IntersectionResult<double> lineHit;
+	Segment<double> fusedA(Point<double>(0, 0, 0), Point<double>(4, 0, 0)), fusedB(Point<double>(1, -1, 0), Point<double>(1, 3, 0));
+	SUBTEST_ASSERT("Segments cross", fusedA.FindIntersections(fusedB, lineHit) && lineHit[0] == Point<double>(1, 0, 0) && AreEqual(lineHit.Parameter(0), 0.25));
+	SUBTEST_ASSERT("Skew lines", !Line<double>(Point<double>(0, 0, 0), Vector<double>(1, 0, 0)).Intersects(Line<double>(Point<double>(0, 0, 1), Vector<double>(0, 1, 0))));
+	SUBTEST_ASSERT("Parallel lines", !Line<double>(Point<double>(0, 0, 0), Vector<double>(1, 0, 0)).Intersects(Line<double>(Point<double>(0, 1, 0), Vector<double>(-2, 0, 0))));
+	SUBTEST_ASSERT("Collinear ray behind segment", !fusedA.Intersects(Ray<double>(Point<double>(-1, 0, 0), Vector<double>(-1, 0, 0))));
+	SUBTEST_ASSERT("Collinear ray over segment", fusedA.FindIntersections(Ray<double>(Point<double>(-1, 0, 0), Vector<double>(1, 0, 0)), lineHit) && lineHit[0] == Point<double>(0, 0, 0) && AreEqual(lineHit.Parameter(0), 1));
+	std::vector<Segment<double>> fusedFirst, fusedSecond;
+	for (int i = 0; i < 8; i++)
+	{
+		fusedFirst.push_back(Segment<double>(Point<double>(0, i, 0), Point<double>(10, i, 0)));
+		fusedSecond.push_back(Segment<double>(Point<double>(i, -1, 0), Point<double>(i, i % 2 ? 3 : i - 0.5, 0)));
+	}
+	std::vector<IntersectionResult<double>> fusedRes(8);
+	SUBTEST_EQ("Batch pairs", Segment<double>::IntersectPairs(fusedFirst, fusedSecond, fusedRes), 2);
+	SUBTEST_ASSERT("Batch pair points", fusedRes[3][0] == Point<double>(3, 3, 0) && fusedRes[2].IsEmpty());
+	SUBTEST_EQ("Batch against ray", Segment<double>::IntersectAll(Ray<double>(Point<double>(-1, 0.5, 0), Vector<double>(1, 0, 0)), fusedSecond, fusedRes), 7);
+
+	TEST("Segment sets");
+
+	std::vector<Segment<double>> segSet;
+	unsigned segSeed = 12345;
+	auto segRandom = [&segSeed]() { segSeed = segSeed * 1103515245 + 12345; return (segSeed >> 8) % 10000 / 100.0; };
+	for (int i = 0; i < 1500; i++)
+	{
+		Point<double> from(segRandom(), segRandom(), 0);
+		segSet.push_back(Segment<double>(from, Vector<double>(segRandom() / 20 - 2.5, segRandom() / 20 - 2.5, 0)));
+	}
+	//a polyline along x shares vertices, touching ends count as intersections
+	for (int i = 0; i < 50; i++)
+		segSet.push_back(Segment<double>(Point<double>(i, 50.5, 0), Point<double>(i + 1, 50.5, 0)));
+	std::vector<std::pair<int, int>> segBrute;
+	IntersectionResult<double> segHit;
+	for (int i = 0; i < (int)segSet.size(); i++)
+		for (int j = i + 1; j < (int)segSet.size(); j++)
+			if (segSet[i].FindIntersections(segSet[j], segHit))
+				segBrute.push_back({ i, j });
+	std::vector<SegmentIntersector<double>::Hit> segFound;
+	{
+		ThreadPool segPool(4);
+		segFound = SegmentIntersector<double>::FindAll(segSet, &segPool);
+	}
+	bool segSame = segFound.size() == segBrute.size();
+	for (int k = 0; segSame && k < (int)segFound.size(); k++)
+		segSame = segFound[k].first == segBrute[k].first && segFound[k].second == segBrute[k].second;
+	SUBTEST_ASSERT("Same pairs as all-pairs test", segSame && segBrute.size() > 49);
+	SUBTEST_ASSERT("Points of pairs", segSet[segFound[0].first].Belongs(segFound[0].points[0]) && segSet[segFound[0].second].Belongs(segFound[0].points[0]));
+	std::vector<Segment<double>> segLeft(segSet.begin(), segSet.begin() + 700), segRight(segSet.begin() + 700, segSet.end());
+	auto segBetween = SegmentIntersector<double>::FindBetween(segLeft, segRight);
+	int segCross = std::count_if(segBrute.begin(), segBrute.end(), [](const std::pair<int, int>& p) { return p.first < 700 && p.second >= 700; });
+	SUBTEST_ASSERT("Pairs between two sets", (int)segBetween.size() == segCross && segRight[segBetween[0].second].Belongs(segBetween[0].points[0]));
+
+	TEST("Surface frames");
+
+	Plane<double> framePlane(Point<double>(1, 2, 3), Vector<double>(1, 1, 2));
+	Cylinder<double> frameCyl(Point<double>(1, -1, 0), Vector<double>(0, 1, 1), 1.5);
+	std::vector<Point<double>> framePts;
+	std::vector<double> frameU(200), frameV(200), frameU2(200), frameV2(200);
+	for (int i = 0; i < 200; i++)
+	{
+		frameU[i] = i * 0.37 - 30;
+		frameV[i] = fmod(i * 0.61, 2 * acos(-1));
+	}
+	framePts.resize(200);
+	framePlane.GetPointByParameters(frameU, frameV, framePts);
+	bool frameOk = framePlane.GetParameters(framePts, frameU2, frameV2) == 200;
+	for (int i = 0; frameOk && i < 200; i++)
+		frameOk = abs(frameU[i] - frameU2[i]) < 1e-9 && abs(frameV[i] - frameV2[i]) < 1e-9 && framePlane.Belongs(framePts[i]);
+	SUBTEST_ASSERT("Plane away from origin round trip", frameOk);
+	frameCyl.GetPointByParameters(frameU, frameV, framePts);
+	frameOk = frameCyl.GetParameters(framePts, frameU2, frameV2) == 200;
+	for (int i = 0; frameOk && i < 200; i++)
+		frameOk = abs(frameU[i] - frameU2[i]) < 1e-9 && abs(frameV[i] - frameV2[i]) < 1e-9 && frameCyl.Belongs(framePts[i]);
+	SUBTEST_ASSERT("Cylinder round trip below start", frameOk);
+	framePlane.GetPointByParameters(frameU, frameV, framePts);
+	framePts[0] = framePts[0] + Vector<double>(0, 0, 1);
+	SUBTEST_EQ("Points off the surface", framePlane.GetParameters(framePts, frameU2, frameV2), 199);
+	SUBTEST_ASSERT("NaN parameters off the surface", frameU2[0] != frameU2[0]);
+	frameCyl.SetDirection(Vector<double>(0, 0, 1));
+	SUBTEST_ASSERT("Frame follows direction", frameCyl.GetParameters(Point<double>(1, 0.5, 7), u, v) && u == 7);
+
+	TEST("Quaternions");
+
+	Vector<double> quatAxis(1, -2, 0.5);
+	Quaternion<double> quatA = Quaternion<double>::RotationInit(quatAxis, 0.7);
+	Quaternion<double> quatB = Quaternion<double>::RotationInit(Vector<double>(0, 0, 1), acos(-1) / 2);
+	SUBTEST_EQ("Same as Vector::Rotate", quatA.Rotate(v2), v2.Rotate(quatAxis, 0.7));
+	SUBTEST_ASSERT("Same as rotation matrix", quatA.ToMatrix() == Matrix<double>::RotationInit(quatAxis, 0.7));
+	SUBTEST_EQ("Matrix applies the same rotation", v2 * quatA.ToMatrix(), quatA.Rotate(v2));
+	SUBTEST_ASSERT("From matrix", Quaternion<double>::FromMatrix(quatA.ToMatrix()).IsSameRotation(quatA));
+	SUBTEST_ASSERT("From half turn matrix", Quaternion<double>::FromMatrix(Matrix<double>::RotationInit(quatAxis, acos(-1))).IsSameRotation(Quaternion<double>::RotationInit(quatAxis, acos(-1))));
+	SUBTEST_EQ("Composition order", (quatB * quatA).Rotate(v2), quatB.Rotate(quatA.Rotate(v2)));
+	SUBTEST_ASSERT("Conjugate undoes", (quatA * quatA.Conjugate()).IsSameRotation(Quaternion<double>()));
+	SUBTEST_ASSERT("Slerp halfway", Quaternion<double>::Slerp(Quaternion<double>(), quatB, 0.5).IsSameRotation(Quaternion<double>::RotationInit(Vector<double>(0, 0, 1), acos(-1) / 4)));
+	SUBTEST_ASSERT("Slerp ends", Quaternion<double>::Slerp(quatA, quatB, 0).IsSameRotation(quatA) && Quaternion<double>::Slerp(quatA, quatB, 1).IsSameRotation(quatB));
+	std::vector<Vector<double>> quatVecs;
+	std::vector<Point<double>> quatPts;
+	for (int i = 0; i < 100; i++)
+	{
+		quatVecs.push_back(Vector<double>(i, 1 - i * 0.5, i % 7));
+		quatPts.push_back(Point<double>(i, 1 - i * 0.5, i % 7));
+	}
+	std::vector<Vector<double>> quatOrig = quatVecs;
+	RotateAll(quatVecs, quatA);
+	RotateAll(quatPts, quatA, p2);
+	bool quatSame = true;
+	for (int i = 0; quatSame && i < 100; i++)
+		quatSame = quatVecs[i] == quatA.Rotate(quatOrig[i]) && quatPts[i] == p2 + quatA.Rotate(Point<double>(i, 1 - i * 0.5, i % 7) - p2);
+	SUBTEST_ASSERT("Batch rotation", quatSame);
+
+	TEST("Expressions");
+
+	constexpr Vector<double> exprConst = Vector<double>(1, 2, 3) + Vector<double>(1, 0, -1) * 2;
+	static_assert(exprConst.X() == 3 && exprConst.Y() == 2 && exprConst.Z() == 1, "constexpr arithmetic");
+	constexpr Point<double> exprLazyConst = Lazy(Point<double>(1, 1, 1)) - Lazy(Vector<double>(0, 1, 2)) * 2;
+	static_assert(exprLazyConst.Z() == -3, "constexpr lazy arithmetic");
+	SUBTEST_EQ("Constant expression", exprConst.CrossProduct(Vector<double>(0, 0, 1)), Vector<double>(2, -3, 0));
+	Point<double> exprEager = p2 + v1 * 0.5 - (v2 - v1) * 3;
+	Point<double> exprLazy = Lazy(p2) + Lazy(v1) * 0.5 - (Lazy(v2) - v1) * 3;
+	SUBTEST_EQ("Same as eager operators", exprLazy, exprEager);
+	Vector<double> exprVec = -(Lazy(p2) - p1) / 2;
+	SUBTEST_EQ("Negation and division", exprVec, (p1 - p2) * 0.5);
+	SUBTEST_EQ("Dot product of expressions", (Lazy(v1) + v2).DotProduct(Lazy(v1) - v2), v1.LengthPow2() - v2.LengthPow2());
+
+	TEST("Performance");
+
+	double perfSink = 0;
+	Matrix<double> perfMatrix = Matrix<double>::RotationInit(Vector<double>(1, 2, 3), 0.3) * Matrix<double>::TranslationInit(Vector<double>(1, -1, 2));
+	SUBTEST_PERF("Matrix inversion", 15, perfSink += perfMatrix.InvertedCopy().Matr()[0]);
+	SUBTEST_PERF("Accelerated ray query", 15, bulk.FindIntersection(across, hitFast, indFast); perfSink += indFast);
+	SUBTEST_ASSERT("Timed bodies ran", perfSink != 0);
+	{
+		std::ofstream badBaseline("perf_malformed.txt");
+		badBaseline << "Kept\t120\nNot a number\tfast\nNo tab\n\t5\nTrailing\t7x\n\nAlso kept\t80\r\n";
+	}
+	PerfBaseline malformed("perf_malformed.txt");
+	std::remove("perf_malformed.txt");
+	PerfStats perfFast;
+	perfFast.m_dblMedian = 1;
+	perfFast.m_dblDeviation = 0;
+	SUBTEST_ASSERT("Malformed baseline lines skipped", malformed.Report("Kept", perfFast).find("baseline 120 ns") != std::string::npos &&
+		malformed.Report("Also kept", perfFast).find("baseline 80 ns") != std::string::npos && malformed.Report("Not a number", perfFast).find("new baseline") != std::string::npos &&
+		malformed.Report("Trailing", perfFast).find("new baseline") != std::string::npos);
+
+	TEST("Query counters");
+
+	Counters::Reset();
+	bulk.FindIntersection(across, hitFast, indFast);
+	uint64_t countTested = Counters::Total(Counter::TrianglesTested);
+	SUBTEST_ASSERT("Accelerated query counts", countTested > 0 && countTested < (uint64_t)bulk.TrianglesCount() && Counters::Total(Counter::NodesVisited) > 0);
+	Counters::Reset();
+	bulk.FindIntersection(across, hitLinear, indLinear, 0, 100);
+	SUBTEST_EQ("Linear scan tests every triangle", Counters::Total(Counter::TrianglesTested), (uint64_t)100);
+	Counters::Reset();
+	{
+		ThreadPool countPool(3);
+		COUNT_HARDWARE_SCOPE(parallel_query);
+		bulk.FindIntersectionParallel(across, hitLinear, indLinear, countPool);
+	}
+	SUBTEST_EQ("Threads add up", Counters::Total(Counter::TrianglesTested), (uint64_t)bulk.TrianglesCount());
+	SUBTEST_ASSERT("Wait time", Counters::Total(Counter::WaitNanoseconds) > 0);
+
+	TEST("Asynchronous queries");
+
+	{
+		ThreadPool asyncPool(3);
+		TessModel<double>::RayHit asyncHit;
+		bulk.FindIntersection(across, hitLinear, indLinear);
+		auto asyncOne = bulk.FindIntersectionAsync(across, asyncPool);
+		SUBTEST_ASSERT("Same hit as blocking query", asyncOne.Get(asyncHit) && asyncHit.ind == indLinear && asyncHit.pt == hitLinear);
+
+		std::vector<Async<TessModel<double>::RayHit>> asyncMany;
+		std::vector<Ray<double>> asyncRays;
+		for (int i = 0; i < 2000; i++)
+		{
+			asyncRays.push_back(Ray<double>(Point<double>(i % 250, -10, 0.4), Vector<double>(0, 1, 0)));
+			asyncMany.push_back(bulk.FindIntersectionAsync(asyncRays.back(), asyncPool));
+		}
+		bool asyncSame = true;
+		for (int i = 0; i < 2000; i++)
+		{
+			int ind;
+			bulk.FindIntersection(asyncRays[i], hitLinear, ind);
+			asyncSame = asyncSame && asyncMany[i].Get(asyncHit) && asyncHit.ind == ind;
+		}
+		SUBTEST_ASSERT("Thousands in flight", asyncSame);
+
+		auto asyncBatch = bulk.FindIntersectionsAsync(asyncRays, asyncPool, 100);
+		auto asyncCount = asyncBatch.Then([](const std::vector<TessModel<double>::RayHit>& hits) {
+			return (int)std::count_if(hits.begin(), hits.end(), [](const TessModel<double>::RayHit& hit) { return hit.ind >= 0; });
+		});
+		int asyncHits = 0;
+		for (auto& one : asyncMany)
+			if (one.Get(asyncHit) && asyncHit.ind >= 0)
+				asyncHits++;
+		int asyncChained;
+		SUBTEST_ASSERT("Continuation of batch", asyncCount.Get(asyncChained) && asyncChained == asyncHits && asyncHits > 0);
+
+		//a single worker is held by a gate, so the queued query has not started when it is cancelled
+		ThreadPool asyncSingle(1);
+		Promise<int> asyncGate;
+		auto asyncBlocker = RunAsync(asyncSingle, [gate = asyncGate.GetAsync()]() { int v = 0; gate.Get(v); return v; });
+		auto asyncLate = bulk.FindIntersectionsAsync(asyncRays, asyncSingle);
+		auto asyncLateThen = asyncLate.Then([](const std::vector<TessModel<double>::RayHit>& hits) { return (int)hits.size(); });
+		asyncLate.Cancel();
+		asyncGate.Set(1);
+		std::vector<TessModel<double>::RayHit> asyncLateHits;
+		SUBTEST_ASSERT("Cancelled before start", !asyncLate.Get(asyncLateHits) && asyncLate.IsCancelled() && !asyncLateThen.Get(asyncChained));
+
+		Promise<int> asyncDone;
+		auto asyncCoroutine = [&](Async<TessModel<double>::RayHit> query) -> AsyncTask {
+			std::optional<TessModel<double>::RayHit> res = co_await query;
+			asyncDone.Set(res ? res->ind : -2);
+		};
+		asyncCoroutine(bulk.FindIntersectionAsync(across, asyncPool));
+		int asyncAwaited;
+		SUBTEST_ASSERT("Awaited in coroutine", asyncDone.GetAsync().Get(asyncAwaited) && asyncAwaited == indFast);
+
+		auto asyncThrows = RunAsync(asyncPool, []() -> int { throw std::runtime_error("query failed"); });
+		auto asyncAfterThrow = asyncThrows.Then([](const int& v) { return v + 1; });
+		bool asyncRethrown = false;
+		try
+		{
+			asyncAfterThrow.Get(asyncChained);
+		}
+		catch (const std::runtime_error& err)
+		{
+			asyncRethrown = std::string(err.what()) == "query failed";
+		}
+		SUBTEST_ASSERT("Exception reaches the continuation", asyncRethrown && asyncThrows.IsFailed() && !asyncThrows.IsCancelled());
+
+		int asyncSide = 0;
+		bool asyncSideDone = false;
+		Async<bool> asyncNoResult = asyncOne.Then([&asyncSide](const TessModel<double>::RayHit& hit) { asyncSide = hit.ind; });
+		SUBTEST_ASSERT("Continuation without a result", asyncNoResult.Get(asyncSideDone) && asyncSideDone && asyncSide == indLinear);
+	}
+	{
+		//tasks still queued when the pool goes away run before it is gone
+		std::vector<Async<int>> asyncLeft;
+		{
+			ThreadPool asyncIdle(0), asyncBusy(1);
+			asyncLeft.push_back(RunAsync(asyncIdle, []() { return 1; }));
+			asyncLeft.push_back(RunAsync(asyncBusy, []() { std::this_thread::sleep_for(std::chrono::milliseconds(20)); return 2; }));
+			for (int i = 0; i < 5; i++)
+				asyncLeft.push_back(RunAsync(asyncBusy, [i]() { return 3 + i; }));
+		}
+		bool asyncAllDone = true;
+		for (int i = 0; i < (int)asyncLeft.size(); i++)
+		{
+			int v = 0;
+			asyncAllDone = asyncAllDone && asyncLeft[i].IsReady() && asyncLeft[i].Get(v) && v == i + 1;
+		}
+		SUBTEST_ASSERT("Pending tasks complete at pool destruction", asyncAllDone);
+	}
+
+	TEST("Coherent ray batches");
+
+	std::vector<Ray<double>> binRays;
+	for (int i = 0; i < 5000; i++)
+		binRays.push_back(Ray<double>(Point<double>((i * 37) % 250, (i * 13) % 40 - 20, (i % 7) / 7.0), Vector<double>(sin(i), cos(1.3 * i), sin(0.7 * i))));
+	std::vector<int> binOrder = CoherentRayOrder<double>(binRays);
+	std::vector<int> binSorted = binOrder;
+	std::sort(binSorted.begin(), binSorted.end());
+	bool binPermutation = true, binOctants = true;
+	for (int i = 0; i < (int)binSorted.size(); i++)
+		binPermutation = binPermutation && binSorted[i] == i;
+	auto octantOf = [&](int i) {
+		const Vector<double>& dir = binRays[i].Direction();
+		return (dir.X() < 0 ? 4 : 0) + (dir.Y() < 0 ? 2 : 0) + (dir.Z() < 0 ? 1 : 0);
+	};
+	for (int i = 1; i < (int)binOrder.size(); i++)
+		binOctants = binOctants && octantOf(binOrder[i - 1]) <= octantOf(binOrder[i]);
+	SUBTEST_ASSERT("Order is a permutation", binPermutation && binSorted.size() == binRays.size());
+	SUBTEST_ASSERT("Binned by octant", binOctants);
+
+	std::vector<TessModel<double>::RayHit> binPlain(binRays.size()), binCoherent(binRays.size()), binParallel(binRays.size());
+	bulk.FindIntersections(binRays, binPlain, nullptr, false);
+	bulk.FindIntersections(binRays, binCoherent);
+	{
+		ThreadPool binPool(3);
+		bulk.FindIntersections(binRays, binParallel, &binPool);
+	}
+	bool binSame = true;
+	int binHits = 0;
+	for (int i = 0; i < (int)binRays.size(); i++)
+	{
+		int ind;
+		bulk.FindIntersection(binRays[i], hitLinear, ind);
+		binSame = binSame && binPlain[i].ind == ind && binCoherent[i].ind == ind && binParallel[i].ind == ind && (ind < 0 || binCoherent[i].pt == hitLinear);
+		binHits += ind >= 0;
+	}
+	SUBTEST_ASSERT("Hits scattered back to caller order", binSame && binHits > 0);
+
+	TEST("Raycaster");
+
+	Camera<double> camera = Camera<double>::LookAt(Point<double>(35, -10, 0.4), Point<double>(35, 0, 0.4), Vector<double>(0, 0, 1), 0.5);
+	SUBTEST_ASSERT("Center of the image looks at the target", camera.GetRay(63, 31, 127, 63).Direction() == Vector<double>(0, 1, 0));
+	SUBTEST_ASSERT("First row is at the top", camera.GetRay(63, 0, 127, 63).Direction().Z() > 0 && camera.GetRay(0, 31, 127, 63).Direction().X() < 0);
+	RaycastImage<double> image, imagePool;
+	Raycast(bulk, camera, image, 127, 63);
+	{
+		ThreadPool imagePoolThreads(3);
+		Raycast(bulk, camera, imagePool, 127, 63, &imagePoolThreads, 8);
+	}
+	int centerPix = 31 * 127 + 63;
+	SUBTEST_ASSERT("Depth of the center", bulk.FindIntersection(across, hitFast, indFast) && Epsilon::IsZero(image.m_vecDepth[centerPix] - hitFast.Distance(across.Start())) &&
+		image.m_vecSurfaces[centerPix] == bulk.GetSurfaceByTriangle(indFast) && image.m_vecNormals[centerPix] == bulk.NormalToTriangle(indFast));
+	SUBTEST_ASSERT("Same image with tiles on a pool", image.m_vecDepth == imagePool.m_vecDepth && image.m_vecSurfaces == imagePool.m_vecSurfaces && image.HitsCount() > 0 && image.HitsCount() < 127 * 63);
+	SUBTEST_ASSERT("Images saved", image.SaveDepthPGM("raycast_depth.pgm") && image.SaveDepthPFM("raycast_depth.pfm") && image.SaveNormalsPFM("raycast_normals.pfm") && image.SaveSurfacesPGM("raycast_surfaces.pgm"));
+	std::ifstream imageIn("raycast_normals.pfm", std::ios::binary);
+	std::string imageMagic;
+	int imageWidth = 0, imageHeight = 0;
+	imageIn >> imageMagic >> imageWidth >> imageHeight;
+	imageIn.seekg(0, std::ios::end);
+	SUBTEST_ASSERT("Normals file", imageMagic == "PF" && imageWidth == 127 && imageHeight == 63 && (int)imageIn.tellg() == 12 * 127 * 63 + 15);
+
+	TEST("Point containment");
+
+	TessModel<double> solid;
+	solid.SplitCylinder(Cylinder<double>(Point<double>(0, 0, 0), Vector<double>(0, 0, 1), 1), 2, 0.01);
+	SUBTEST_ASSERT("Center is inside", solid.Contains(Point<double>(0, 0, 1)));
+	SUBTEST_ASSERT("Beside, above and below are outside", !solid.Contains(Point<double>(1.5, 0, 1)) && !solid.Contains(Point<double>(0, 0, 2.5)) && !solid.Contains(Point<double>(0.2, 0.1, -0.5)));
+	SUBTEST_ASSERT("Points on the surface are inside", solid.Contains(Point<double>(0, 0, 2)) && solid.Contains(solid.GetPoint(solid.GetTriangle(0).ind[0])));
+	//the first direction of the test runs exactly through a vertex of the top from this point
+	Vector<double> containDir = Vector<double>(0.5124, 0.6987, 0.4993).Normalize();
+	Point<double> containVertex(0, 0, 0);
+	for (int i = 0; i < solid.PointsCount(); i++)
+		if (solid.GetPoint(i).Z() > containVertex.Z() || (solid.GetPoint(i).Z() == containVertex.Z() && solid.GetPoint(i).X() * solid.GetPoint(i).X() + solid.GetPoint(i).Y() * solid.GetPoint(i).Y() < containVertex.X() * containVertex.X() + containVertex.Y() * containVertex.Y()))
+			containVertex = solid.GetPoint(i);
+	SUBTEST_ASSERT("Ray through a vertex", solid.Contains(containVertex - containDir * 0.3) && !solid.Contains(containVertex + containDir * 0.3));
+	std::vector<Point<double>> containPts;
+	for (int i = 0; i < 20000; i++)
+		containPts.push_back(Point<double>(1.5 * sin(1.1 * i), 1.5 * cos(2.3 * i), 1 + 1.5 * sin(0.7 * i)));
+	std::vector<char> containIn(containPts.size()), containPool(containPts.size());
+	int containCount = solid.Contains(containPts, containIn), containExpected = 0;
+	{
+		ThreadPool containThreads(3);
+		solid.Contains(containPts, containPool, &containThreads);
+	}
+	bool containSame = true;
+	for (int i = 0; i < (int)containPts.size(); i++)
+	{
+		const Point<double>& pt = containPts[i];
+		double r = sqrt(pt.X() * pt.X() + pt.Y() * pt.Y());
+		//the tessellation cuts chords of the circle, points near the side are left out
+		if (r > 0.99 && r < 1.01)
+			continue;
+		bool truth = r < 1 && pt.Z() > 0 && pt.Z() < 2;
+		containExpected += truth;
+		containSame = containSame && (bool)containIn[i] == truth && containIn[i] == containPool[i];
+	}
+	SUBTEST_ASSERT("Batch matches the analytic solid", containSame && containExpected > 0 && containCount >= containExpected);
+
+	TEST("Mass properties");
+
+	//a 2 x 3 x 4 box far from the origin, with outward triangles
+	std::vector<Point<double>> massPts;
+	for (int i = 0; i < 8; i++)
+		massPts.push_back(Point<double>(1e6 + 2 * (i & 1), -1e6 + 3 * ((i >> 1) & 1), 5e5 + 4 * (i >> 2)));
+	TessModel<double> massBox;
+	massBox.AddSurface(massPts, {}, { { 0, 2, 1 }, { 1, 2, 3 }, { 4, 5, 6 }, { 5, 7, 6 }, { 0, 1, 4 }, { 1, 5, 4 } });
+	massBox.AddSurface(massPts, {}, { { 2, 6, 3 }, { 3, 6, 7 }, { 0, 4, 2 }, { 2, 4, 6 }, { 1, 3, 5 }, { 3, 7, 5 } });
+	MassProperties<double> massTotal;
+	std::vector<MassProperties<double>> massSurfaces;
+	ComputeMassProperties(massBox, massTotal, &massSurfaces);
+	SUBTEST_ASSERT("Box area and volume", std::abs(massTotal.m_dblArea - 52) < 1e-9 && std::abs(massTotal.m_dblVolume - 24) < 1e-9);
+	SUBTEST_ASSERT("Box centroid", massTotal.m_ptCentroid.Distance(Point<double>(1e6 + 1, -1e6 + 1.5, 5e5 + 2)) < 1e-9);
+	SUBTEST_ASSERT("Box inertia", std::abs(massTotal.m_dblInertia[0][0] - 24.0 / 12 * 25) < 1e-8 && std::abs(massTotal.m_dblInertia[1][1] - 24.0 / 12 * 20) < 1e-8 &&
+		std::abs(massTotal.m_dblInertia[2][2] - 24.0 / 12 * 13) < 1e-8 && std::abs(massTotal.m_dblInertia[0][1]) < 1e-8 && std::abs(massTotal.m_dblInertia[1][2]) < 1e-8);
+	SUBTEST_ASSERT("Surfaces add up", massSurfaces.size() == 2 && std::abs(massSurfaces[0].m_dblArea + massSurfaces[1].m_dblArea - 52) < 1e-9 &&
+		std::abs(massSurfaces[0].m_dblVolume + massSurfaces[1].m_dblVolume - 24) < 1e-9);
+
+	//the cylinder is a prism over a regular polygon with as many sides as SplitCylinder makes
+	int massSides = acos(-1) / acos(1 - 0.01) + 1;
+	double massPolygon = massSides * sin(2 * acos(-1) / massSides) / 2;
+	MassProperties<double> massCylinder;
+	ComputeMassProperties(solid, massCylinder);
+	SUBTEST_ASSERT("Cylinder volume and centroid", std::abs(massCylinder.m_dblVolume - 2 * massPolygon) < 1e-9 && massCylinder.m_ptCentroid.Distance(Point<double>(0, 0, 1)) < 1e-9);
+	SUBTEST_ASSERT("Cylinder inertia about the axis", std::abs(massCylinder.m_dblInertia[2][2] - 2 * massPolygon / 6 * (1 + 2 * pow(cos(acos(-1) / massSides), 2))) < 1e-9);
+	MassProperties<double> massOne, massThree;
+	{
+		ThreadPool massPool1(1), massPool3(3);
+		ComputeMassProperties(bulk, massOne, nullptr, &massPool1);
+		ComputeMassProperties(bulk, massThree, nullptr, &massPool3);
+	}
+	ComputeMassProperties(bulk, massTotal);
+	SUBTEST_ASSERT("Same bits for any thread count", massOne.m_dblVolume == massThree.m_dblVolume && massOne.m_dblVolume == massTotal.m_dblVolume &&
+		massOne.m_ptCentroid == massThree.m_ptCentroid && !memcmp(massOne.m_dblInertia, massThree.m_dblInertia, sizeof(massOne.m_dblInertia)) && massOne.m_dblArea == massThree.m_dblArea);
+
+	TEST("Slicing");
+
+	//signed area seen from +z
+	auto sliceArea = [](const Polyline<double>& line) {
+		double res = 0;
+		for (int i = 0; i < (int)line.m_vecPoints.size(); i++)
+		{
+			const Point<double>& a = line.m_vecPoints[i];
+			const Point<double>& b = line.m_vecPoints[(i + 1) % line.m_vecPoints.size()];
+			res += a.X() * b.Y() - b.X() * a.Y();
+		}
+		return res / 2;
+	};
+	std::vector<double> sliceOffsets;
+	for (int i = 0; i <= 200; i++)
+		sliceOffsets.push_back(i / 100.0);
+	auto sliceSolid = Slice(solid, Plane<double>(Point<double>(0, 0, 0), Vector<double>(0, 0, 2)), sliceOffsets);
+	bool sliceLoops = true;
+	//between the caps the diagonals of the side quads add a point each
+	for (int i = 1; i <= 200; i++)
+		sliceLoops = sliceLoops && sliceSolid[i].size() == 1 && sliceSolid[i][0].m_bClosed && (int)sliceSolid[i][0].m_vecPoints.size() == (i < 200 ? 2 : 1) * massSides &&
+			std::abs(sliceArea(sliceSolid[i][0]) - massPolygon) < 1e-9 && std::abs(sliceSolid[i][0].m_vecPoints[0].Z() - sliceOffsets[i]) < 1e-12;
+	SUBTEST_ASSERT("Counterclockwise loop on every plane", sliceLoops);
+	SUBTEST_ASSERT("Plane through the bottom cap cuts nothing", sliceSolid[0].empty());
+
+	//planes through the faces of the box: vertices on a plane count as above it, so only the upper face is cut
+	auto sliceBox = Slice(massBox, Plane<double>(Point<double>(0, -1e6 + 1.5, 0), Vector<double>(0, 1, 0)), std::vector<double>{ -1.5, 0, 1.5 });
+	SUBTEST_ASSERT("Box sections through faces", sliceBox[0].empty() && sliceBox[2].size() == 1 && sliceBox[2][0].m_bClosed && sliceBox[2][0].m_vecPoints.size() == 4);
+	SUBTEST_ASSERT("Box section through diagonals", sliceBox[1].size() == 1 && sliceBox[1][0].m_bClosed && sliceBox[1][0].m_vecPoints.size() == 8);
+
+	TessModel<double> sliceOpen;
+	sliceOpen.AddSurface({ Point<double>(0, 0, 0), Point<double>(2, 0, 0), Point<double>(0, 2, 0), Point<double>(2, 2, 0) }, {}, { { 0, 1, 2 }, { 1, 3, 2 } });
+	auto sliceLine = Slice(sliceOpen, Plane<double>(Point<double>(0, 0, 0), Vector<double>(1, 0, 0)), std::vector<double>{ 1 });
+	SUBTEST_ASSERT("Open surface gives an open polyline", sliceLine[0].size() == 1 && !sliceLine[0][0].m_bClosed && sliceLine[0][0].m_vecPoints.size() == 3);
+
+	std::vector<double> sliceMany;
+	for (int i = 0; i < 3000; i++)
+		sliceMany.push_back(-10 + i * 0.1);
+	auto sliceSerial = Slice(bulk, Plane<double>(Point<double>(0, 0, 0.5), Vector<double>(1, 0.3, 0.2)), sliceMany);
+	bool sliceSame = true;
+	int sliceCount = 0;
+	{
+		ThreadPool slicePool(3);
+		auto sliceParallel = Slice(bulk, Plane<double>(Point<double>(0, 0, 0.5), Vector<double>(1, 0.3, 0.2)), sliceMany, &slicePool);
+		for (int i = 0; i < (int)sliceMany.size(); i++)
+		{
+			sliceSame = sliceSame && sliceSerial[i].size() == sliceParallel[i].size();
+			for (int k = 0; sliceSame && k < (int)sliceSerial[i].size(); k++)
+				sliceSame = sliceSerial[i][k].m_vecPoints == sliceParallel[i][k].m_vecPoints && sliceSerial[i][k].m_bClosed;
+			sliceCount += sliceSerial[i].size();
+		}
+	}
+	SUBTEST_ASSERT("Plane ranges in parallel give the same loops", sliceSame && sliceCount > 0);
+
+	TEST("Simplification");
+
+	//every directed edge, compared by the positions of its ends, has exactly one reverse twin
+	auto simplifyClosed = [](const TessModel<double>& model) {
+		using Pos = std::array<double, 3>;
+		std::vector<std::pair<Pos, Pos>> edges;
+		for (int t = 0; t < model.TrianglesCount(); t++)
+			for (int j = 0; j < 3; j++)
+			{
+				const Point<double>& a = model.GetPoint(model.GetTriangle(t).ind[j]);
+				const Point<double>& b = model.GetPoint(model.GetTriangle(t).ind[(j + 1) % 3]);
+				edges.push_back({ { a.X(), a.Y(), a.Z() }, { b.X(), b.Y(), b.Z() } });
+			}
+		std::sort(edges.begin(), edges.end());
+		for (int i = 0; i < (int)edges.size(); i++)
+		{
+			if (i > 0 && edges[i] == edges[i - 1])
+				return false;
+			if (!std::binary_search(edges.begin(), edges.end(), std::make_pair(edges[i].second, edges[i].first)))
+				return false;
+		}
+		return true;
+	};
+
+	TessModel<double> simplifyGrid;
+	{
+		std::vector<Point<double>> gridPts;
+		std::vector<Triangle> gridTris;
+		for (int i = 0; i <= 20; i++)
+			for (int j = 0; j <= 20; j++)
+				gridPts.push_back(Point<double>(j * 0.1, i * 0.1, 1));
+		for (int i = 0; i < 20; i++)
+			for (int j = 0; j < 20; j++)
+			{
+				gridTris.push_back({ 21 * i + j, 21 * i + j + 1, 21 * (i + 1) + j });
+				gridTris.push_back({ 21 * i + j + 1, 21 * (i + 1) + j + 1, 21 * (i + 1) + j });
+			}
+		simplifyGrid.AddSurface(gridPts, {}, gridTris);
+	}
+	int gridLeft = simplifyGrid.Simplify(0, 1e-12);
+	MassProperties<double> gridMass;
+	ComputeMassProperties(simplifyGrid, gridMass);
+	SUBTEST_ASSERT("Flat square keeps only its corners", gridLeft == 2 && simplifyGrid.PointsCount() == 4 && std::abs(gridMass.m_dblArea - 4) < 1e-12);
+
+	TessModel<double> simplifyFine;
+	simplifyFine.SplitCylinder(Cylinder<double>(Point<double>(0, 0, 0), Vector<double>(0, 0, 1), 1), 2, 1e-5);
+	int fineCount = simplifyFine.TrianglesCount();
+	int fineLeft = simplifyFine.Simplify(400);
+	MassProperties<double> fineMass;
+	ComputeMassProperties(simplifyFine, fineMass);
+	SUBTEST_ASSERT("Down to the target", fineCount > 2000 && fineLeft <= 400 && fineLeft >= 390 && fineLeft == simplifyFine.TrianglesCount());
+	int fineFirst, fineLast;
+	bool fineSurfaces = simplifyFine.SurfacesCount() == 3;
+	for (int s = 0; fineSurfaces && s < 3; s++)
+	{
+		simplifyFine.SurfaceRange(s, fineFirst, fineLast);
+		fineSurfaces = fineLast >= fineFirst;
+	}
+	SUBTEST_ASSERT("Surfaces stay apart and closed", fineSurfaces && simplifyClosed(simplifyFine));
+	SUBTEST_ASSERT("Shape is kept", std::abs(fineMass.m_dblVolume - 2 * acos(-1)) < 0.05 && fineMass.m_ptCentroid.Distance(Point<double>(0, 0, 1)) < 1e-3 &&
+		simplifyFine.Contains(Point<double>(0, 0, 1)) && !simplifyFine.Contains(Point<double>(0, 0, 2.1)) && !simplifyFine.Contains(Point<double>(1.1, 0, 1)));
+
+	TessModel<double> simplifyBound;
+	simplifyBound.SplitCylinder(Cylinder<double>(Point<double>(0, 0, 0), Vector<double>(0, 0, 1), 1), 2, 1e-5);
+	int boundLeft = simplifyBound.Simplify(0, 1e-3);
+	bool boundNear = true;
+	for (int i = 0; i < simplifyBound.PointsCount(); i++)
+	{
+		const Point<double>& pt = simplifyBound.GetPoint(i);
+		boundNear = boundNear && std::abs(sqrt(pt.X() * pt.X() + pt.Y() * pt.Y()) - 1) < 1e-9;
+	}
+	SUBTEST_ASSERT("Error bound", boundLeft < fineCount && boundLeft > fineLeft && boundNear && simplifyClosed(simplifyBound));
+
+	//large enough to be cut into regions, which depend only on the mesh
+	TessModel<double> simplifySerial, simplifyParallel;
+	simplifySerial.SplitCylinder(Cylinder<double>(Point<double>(0, 0, 0), Vector<double>(0, 0, 1), 1), 2, 1e-8);
+	simplifyParallel.SplitCylinder(Cylinder<double>(Point<double>(0, 0, 0), Vector<double>(0, 0, 1), 1), 2, 1e-8);
+	{
+		ThreadPool simplifyPool(3);
+		simplifyParallel.Simplify(4000, std::numeric_limits<double>::max(), &simplifyPool);
+	}
+	simplifySerial.Simplify(4000);
+	bool simplifySame = simplifySerial.TrianglesCount() == simplifyParallel.TrianglesCount() && simplifySerial.PointsCount() == simplifyParallel.PointsCount();
+	for (int i = 0; simplifySame && i < simplifySerial.PointsCount(); i++)
+		simplifySame = simplifySerial.GetPoint(i) == simplifyParallel.GetPoint(i);
+	MassProperties<double> parallelMass;
+	ComputeMassProperties(simplifyParallel, parallelMass);
+	SUBTEST_ASSERT("Regions in parallel", simplifySame && simplifyParallel.TrianglesCount() <= 4000 && simplifyParallel.SurfacesCount() == 3 && simplifyClosed(simplifyParallel) &&
+		std::abs(parallelMass.m_dblVolume - 2 * acos(-1)) < 0.05);
+
+	TEST("Convex hull");
+
+	//no point of pts (every step-th for large sets) is above the plane of a triangle, and the triangles close the hull
+	auto hullContains = [&simplifyClosed](const TessModel<double>& model, const std::vector<Point<double>>& pts, int step = 1) {
+		for (int t = 0; t < model.TrianglesCount(); t++)
+		{
+			Vector<double> norm = model.NormalToTriangle(t);
+			const Point<double>& a = model.GetPoint(model.GetTriangle(t).ind[0]);
+			for (int i = 0; i < (int)pts.size(); i += step)
+				if (norm.DotProduct(pts[i] - a) > Epsilon::Eps())
+					return false;
+		}
+		return simplifyClosed(model);
+	};
+
+	//corners of a cube with points inside, on its faces and repeated corners
+	std::vector<Point<double>> hullCube;
+	for (int i = 0; i < 8; i++)
+		hullCube.push_back(Point<double>(i & 1, (i >> 1) & 1, (i >> 2) & 1));
+	for (int i = 0; i < 500; i++)
+		hullCube.push_back(Point<double>(0.5 + 0.49 * sin(1.3 * i), 0.5 + 0.49 * cos(0.7 * i), i % 3 ? 0.5 + 0.49 * sin(0.3 * i) : (i % 2)));
+	hullCube.insert(hullCube.end(), hullCube.begin(), hullCube.begin() + 8);
+	TessModel<double> cubeHull = ConvexHull<double>(hullCube);
+	MassProperties<double> hullMass;
+	ComputeMassProperties(cubeHull, hullMass);
+	SUBTEST_ASSERT("Cube keeps its corners", cubeHull.PointsCount() == 8 && cubeHull.TrianglesCount() == 12 && cubeHull.SurfacesCount() == 1 &&
+		std::abs(hullMass.m_dblVolume - 1) < 1e-12 && hullContains(cubeHull, hullCube));
+
+	//every point of a sphere is a vertex, a closed triangulation of v vertices has 2v - 4 triangles
+	std::vector<Point<double>> hullSphere;
+	for (int i = 0; i < 2000; i++)
+	{
+		double z = 1 - (2 * i + 1) / 2000.0, r = sqrt(1 - z * z), phi = i * acos(-1) * (3 - sqrt(5.0));
+		hullSphere.push_back(Point<double>(r * cos(phi), r * sin(phi), z));
+	}
+	TessModel<double> sphereHull = ConvexHull<double>(hullSphere);
+	ComputeMassProperties(sphereHull, hullMass);
+	SUBTEST_ASSERT("Points on a sphere", sphereHull.PointsCount() == 2000 && sphereHull.TrianglesCount() == 3996 && hullMass.m_dblVolume < 4 * acos(-1) / 3 &&
+		hullMass.m_dblVolume > 4 * acos(-1) / 3 * 0.99 && hullContains(sphereHull, hullSphere));
+
+	std::vector<Point<double>> hullFlat;
+	for (int i = 0; i < 100; i++)
+		hullFlat.push_back(Point<double>(sin(0.1 * i), cos(0.37 * i), 2 + 1e-9 * sin(3.0 * i)));
+	//the surface of a lattice cube turned off the axes, most points are exactly on the faces up to rounding
+	std::vector<Point<double>> hullGrid;
+	Quaternion<double> gridTurn = Quaternion<double>::RotationInit(Vector<double>(1, 2, 3), 0.7);
+	for (int i = 0; i <= 20; i++)
+		for (int j = 0; j <= 20; j++)
+			for (int k = 0; k <= 20; k++)
+				if (i % 20 == 0 || j % 20 == 0 || k % 20 == 0)
+					hullGrid.push_back(Point<double>(0, 0, 0) + gridTurn.Rotate(Vector<double>(i - 10, j - 10, k - 10)) * 50);
+	TessModel<double> gridHull = ConvexHull<double>(hullGrid);
+	ComputeMassProperties(gridHull, hullMass);
+	SUBTEST_ASSERT("Coplanar points of a turned lattice", gridHull.TrianglesCount() == 2 * gridHull.PointsCount() - 4 && std::abs(hullMass.m_dblVolume - 1e9) < 1e-3 &&
+		hullContains(gridHull, hullGrid));
+
+	SUBTEST_ASSERT("Points within eps of a plane give no hull", ConvexHull<double>(hullFlat).IsEmpty() && ConvexHull<double>(std::vector<Point<double>>(hullCube.begin(), hullCube.begin() + 3)).IsEmpty());
+
+	//enough points for the blocks, the same hull with and without the pool
+	std::vector<Point<double>> hullCloud;
+	for (int i = 0; i < 300000; i++)
+	{
+		double r = pow(0.5 + 0.5 * sin(0.77 * i), 0.2);
+		hullCloud.push_back(Point<double>(r * sin(1.1 * i) * cos(2.3 * i), r * sin(1.1 * i) * sin(2.3 * i), 3 * r * cos(1.1 * i)));
+	}
+	TessModel<double> cloudHull = ConvexHull<double>(hullCloud), cloudPool;
+	{
+		ThreadPool hullPool(3);
+		cloudPool = ConvexHull<double>(hullCloud, &hullPool);
+	}
+	bool hullSame = cloudHull.PointsCount() == cloudPool.PointsCount() && cloudHull.TrianglesCount() == cloudPool.TrianglesCount();
+	for (int i = 0; hullSame && i < cloudHull.PointsCount(); i++)
+		hullSame = cloudHull.GetPoint(i) == cloudPool.GetPoint(i);
+	SUBTEST_ASSERT("Blocks in parallel", hullSame && cloudHull.PointsCount() > 100 && hullContains(cloudPool, hullCloud, 97));
+
+	TEST("Bounding volumes");
+
+	double inf = std::numeric_limits<double>::infinity();
+	Segment<double> boundSeg(Point<double>(1, 2, 3), Point<double>(4, 0, 5));
+	bool linesOk = boundSeg.Bounds() == AABB<double>(Point<double>(1, 0, 3), Point<double>(4, 2, 5));
+	boundSeg.SetStart(Point<double>(0, 0, 0));
+	linesOk = linesOk && boundSeg.Bounds() == AABB<double>(Point<double>(0, -2, 0), Point<double>(3, 0, 2));
+	linesOk = linesOk && Ray<double>(Point<double>(1, 2, 3), Vector<double>(1, 0, -1)).Bounds() == AABB<double>(Point<double>(1, 2, -inf), Point<double>(inf, 2, 3));
+	linesOk = linesOk && Line<double>(Point<double>(1, 2, 3), Vector<double>(0, 0, 1)).Bounds() == AABB<double>(Point<double>(1, 2, -inf), Point<double>(1, 2, inf));
+	SUBTEST_ASSERT("Lines, rays and segments", linesOk);
+
+	Plane<double> boundPlane(Point<double>(1, 2, 3), Vector<double>(0, 0, 2));
+	bool planesOk = boundPlane.Bounds() == AABB<double>(Point<double>(-inf, -inf, 3), Point<double>(inf, inf, 3));
+	boundPlane.SetNormal(Vector<double>(1, 0, 1));
+	planesOk = planesOk && boundPlane.Bounds() == AABB<double>(Point<double>(-inf, -inf, -inf), Point<double>(inf, inf, inf));
+	boundPlane.SetNormal(Vector<double>(-1, 0, 0));
+	boundPlane.SetStart(Point<double>(5, 0, 0));
+	planesOk = planesOk && boundPlane.Bounds() == AABB<double>(Point<double>(5, -inf, -inf), Point<double>(5, inf, inf));
+	SUBTEST_ASSERT("Planes", planesOk);
+
+	//boxes hold every sample of the shape and each of their faces is touched by some sample
+	auto tightBox = [inf](const AABB<double>& box, const std::vector<Point<double>>& pts) {
+		double lo[3] = { box.Min().X(), box.Min().Y(), box.Min().Z() }, hi[3] = { box.Max().X(), box.Max().Y(), box.Max().Z() };
+		double gapLo[3] = { inf, inf, inf }, gapHi[3] = { inf, inf, inf };
+		for (const Point<double>& pt : pts)
+		{
+			double c[3] = { pt.X(), pt.Y(), pt.Z() };
+			for (int i = 0; i < 3; i++)
+			{
+				if (c[i] < lo[i] - 1e-12 || c[i] > hi[i] + 1e-12)
+					return false;
+				gapLo[i] = std::min(gapLo[i], c[i] - lo[i]);
+				gapHi[i] = std::min(gapHi[i], hi[i] - c[i]);
+			}
+		}
+		for (int i = 0; i < 3; i++)
+			if (gapLo[i] > 1e-4 || gapHi[i] > 1e-4)
+				return false;
+		return true;
+	};
+
+	Cylinder<double> boundCyl(Point<double>(1, 1, 0), Vector<double>(0, 0, 1), 2);
+	bool cylOk = boundCyl.Bounds() == AABB<double>(Point<double>(-1, -1, -inf), Point<double>(3, 3, inf));
+	cylOk = cylOk && boundCyl.Bounds(5, 0) == AABB<double>(Point<double>(-1, -1, 0), Point<double>(3, 3, 5));
+	boundCyl.SetDirection(Vector<double>(1, 2, 3));
+	boundCyl.SetRadius(0.5);
+	cylOk = cylOk && boundCyl.Bounds() == AABB<double>(Point<double>(-inf, -inf, -inf), Point<double>(inf, inf, inf));
+	std::vector<Point<double>> cylSamples;
+	for (int i = 0; i < 2000; i++)
+		cylSamples.push_back(boundCyl.GetPointByParameters(i % 2 ? 3 : -1, i * 2 * acos(-1) / 1000));
+	OBB<double> cylBox = boundCyl.OrientedBounds(-1, 3);
+	for (const Point<double>& pt : cylSamples)
+		cylOk = cylOk && cylBox.Contains(pt, 1e-12);
+	SUBTEST_ASSERT("Cylinders", cylOk && tightBox(boundCyl.Bounds(-1, 3), cylSamples) && boundCyl.Bounds(-1, 3).SurfaceArea() < cylBox.Bounds().SurfaceArea());
+
+	Circle<double> boundCircle(Point<double>(1, 2, 3), Vector<double>(0, 1, 1), 2);
+	boundCircle.SetAxis(Vector<double>(2, -1, 1));
+	Vector<double> circleBase1 = boundCircle.Axis().GetOrthogonal().NormalizedCopy();
+	Vector<double> circleBase2 = boundCircle.Axis().CrossProduct(circleBase1).NormalizedCopy();
+	std::vector<Point<double>> circleSamples;
+	for (int i = 0; i < 2000; i++)
+		circleSamples.push_back(boundCircle.Center() + (circleBase1 * cos(i * acos(-1) / 1000) + circleBase2 * sin(i * acos(-1) / 1000)) * 2);
+	bool circleOk = tightBox(boundCircle.Bounds(), circleSamples);
+	for (const Point<double>& pt : circleSamples)
+		circleOk = circleOk && boundCircle.OrientedBounds().Contains(pt, 1e-12);
+	SUBTEST_ASSERT("Circles", circleOk);
+
+	AABB<double> unitBox(Point<double>(0, 0, 0), Point<double>(1, 1, 1));
+	SUBTEST_ASSERT("Box overlaps", unitBox.Intersects(AABB<double>(Point<double>(1, 0, 0), Point<double>(2, 1, 1))) &&
+		!unitBox.Intersects(AABB<double>(Point<double>(1.1, 0.5, 0.5), Point<double>(2, 1, 1))) &&
+		unitBox.Intersects(AABB<double>(Point<double>(1.1, 0.5, 0.5), Point<double>(2, 1, 1)), 0.2) &&
+		unitBox.Contains(Point<double>(1, 0.5, 0)) && !unitBox.Contains(Point<double>(1, 0.5, -0.1)));
+
+	//sticks with diamond sections crossing one above the other, only the cross product of their edges separates them;
+	//turned off the axes, their axis aligned boxes overlap
+	auto stick = [](double height, bool alongX) {
+		double c = sqrt(0.5);
+		if (alongX)
+			return OBB<double>(Point<double>(0, 0, height), Vector<double>(1, 0, 0), Vector<double>(0, c, c), Vector<double>(0, -c, c), 2, 0.1, 0.1);
+		return OBB<double>(Point<double>(0, 0, height), Vector<double>(c, 0, -c), Vector<double>(0, 1, 0), Vector<double>(c, 0, c), 0.1, 2, 0.1);
+	};
+	Matrix<double> obbMove = Matrix<double>::RotationInit(Vector<double>(1, 2, 3), 0.7) * Matrix<double>::TranslationInit(Vector<double>(5, -2, 1));
+	bool obbOk = !stick(0, true).Intersects(stick(0.3, false)) && stick(0, true).Intersects(stick(0.25, false)) &&
+		!stick(0, true).Transformed(obbMove).Intersects(stick(0.3, false).Transformed(obbMove)) &&
+		stick(0, true).Transformed(obbMove).Intersects(stick(0.25, false).Transformed(obbMove)) &&
+		stick(0, true).Intersects(stick(0.3, false), 0.05) && stick(0, true).Transformed(obbMove).Bounds().Intersects(stick(0.3, false).Transformed(obbMove).Bounds());
+	//a box and a ray moved together keep the entry parameter of the axis aligned test
+	OBB<double> movedBox = OBB<double>(unitBox).Transformed(obbMove);
+	for (int i = 0; i < 100; i++)
+	{
+		Point<double> start(2 * sin(1.3 * i), 2 * cos(0.7 * i), 3);
+		Vector<double> dir(0.5 - start.X() + 0.3 * sin(5.1 * i), 0.5 - start.Y() + 0.3 * cos(2.9 * i), -2.5);
+		double tnear = -1, tnearBox = -1;
+		bool hit = unitBox.IntersectsRay(start, Vector<double>(1 / dir.X(), 1 / dir.Y(), 1 / dir.Z()), 10, tnearBox, 0);
+		obbOk = obbOk && hit == movedBox.IntersectsRay(start * obbMove, dir * obbMove, 10, tnear, 0) && (!hit || std::abs(tnear - tnearBox) < 1e-9);
+	}
+	SUBTEST_ASSERT("Oriented boxes", obbOk);
+
+	std::vector<AABB<double>> manyBoxes;
+	for (int i = 0; i < 1000; i++)
+	{
+		Point<double> corner(10 * sin(1.1 * i), 10 * cos(2.3 * i), 10 * sin(0.37 * i));
+		manyBoxes.push_back(AABB<double>(corner, corner + Vector<double>(1 + sin(i), 1 + cos(i), 1.5)));
+	}
+	AABBArray<double> boxArray(manyBoxes);
+	std::vector<char> boxMask(manyBoxes.size());
+	std::vector<double> boxNear(manyBoxes.size());
+	AABB<double> probe(Point<double>(-3, -3, -3), Point<double>(4, 2, 3));
+	int overlapping = boxArray.Overlaps(probe, boxMask);
+	bool arrayOk = overlapping > 0 && overlapping < (int)manyBoxes.size();
+	for (int i = 0; i < (int)manyBoxes.size(); i++)
+		arrayOk = arrayOk && boxMask[i] == manyBoxes[i].Intersects(probe) && boxArray.Get(i) == manyBoxes[i];
+	Point<double> arrayStart(-12, -11, -10);
+	Vector<double> arrayInv(1 / 2.0, 1 / 2.1, 1 / 1.9);
+	int crossed = boxArray.IntersectsRay(arrayStart, arrayInv, 20, boxMask, boxNear);
+	arrayOk = arrayOk && crossed > 0;
+	for (int i = 0; i < (int)manyBoxes.size(); i++)
+	{
+		double tnear;
+		arrayOk = arrayOk && boxMask[i] == manyBoxes[i].IntersectsRay(arrayStart, arrayInv, 20, tnear) && (!boxMask[i] || boxNear[i] == tnear);
+	}
+	SUBTEST_ASSERT("Arrays of boxes", arrayOk);
+
+	auto surfaceBoxesOk = [](const TessModel<double>& model) {
+		bool ok = model.SurfacesCount() > 0;
+		for (int s = 0; s < model.SurfacesCount(); s++)
+		{
+			int first, last;
+			model.SurfaceRange(s, first, last);
+			AABB<double> box;
+			for (int t = first; t <= last; t++)
+				box.Expand(model.TriangleBox(t));
+			ok = ok && box == model.SurfaceBounds(s);
+		}
+		return ok;
+	};
+	TessModel<double> boundModel;
+	boundModel.SplitCylinder(Cylinder<double>(Point<double>(0, 0, 0), Vector<double>(0, 0, 1), 1), 2, 0.01);
+	bool modelOk = surfaceBoxesOk(boundModel);
+	boundModel.TransformSurface(1, Matrix<double>::TranslationInit(Vector<double>(0, 0, 3)));
+	modelOk = modelOk && surfaceBoxesOk(boundModel) && std::abs(boundModel.SurfaceBounds(1).Min().Z() - 5) < 1e-12;
+	boundModel.MergeModels(TessModel<double>(boundModel));
+	modelOk = modelOk && boundModel.SurfacesCount() == 6 && surfaceBoxesOk(boundModel);
+	boundModel.Simplify(boundModel.TrianglesCount() / 4);
+	SUBTEST_ASSERT("Surfaces of models", modelOk && surfaceBoxesOk(boundModel));
+
 	TESTING_SECTION_CLOSE;
 
 	std::cout << p1.ToString() << std::endl;
@@ -268,6 +1341,125 @@ int main()
 	mm.FindIntersectionParallel(testRay, p1, num, tp);
 	STOP_TIMER("parallel");
 
+	START_TIMER("sah build");
+	mm.RebuildAcceleration(&tp);
+	STOP_TIMER("sah build");
+	START_TIMER("linear build");
+	mm.RebuildAcceleration(&tp, true);
+	STOP_TIMER("linear build");
+
+	//rays through the whole model before and after the layout pass
+	TessModel<double> scattered = mm;
+	std::vector<Ray<double>> layoutRays;
+	for (int i = 0; i < 10000; i++)
+		layoutRays.push_back(Ray<double>(Point<double>(10, (i % 100) / 25.0 - 2, (i / 100) / 25.0), Vector<double>(-1, (i % 7) / 7.0 - 0.5, 0)));
+	START_TIMER("rays before layout");
+	for (auto& ray : layoutRays)
+		scattered.FindIntersection(ray, p1, num);
+	STOP_TIMER("rays before layout");
+	START_TIMER("optimize layout");
+	scattered.OptimizeLayout(&tp);
+	STOP_TIMER("optimize layout");
+	START_TIMER("rays after layout");
+	for (auto& ray : layoutRays)
+		scattered.FindIntersection(ray, p1, num);
+	STOP_TIMER("rays after layout");
+
+	//scattered rays in the order of the caller and binned by direction octant and start
+	std::vector<Ray<double>> binScattered;
+	std::vector<TessModel<double>::RayHit> binFound(100000);
+	for (int i = 0; i < (int)binFound.size(); i++)
+		binScattered.push_back(Ray<double>(Point<double>(4 * sin(1.1 * i), 4 * cos(2.3 * i), 4 * sin(0.3 * i)), Vector<double>(sin(i), cos(1.7 * i), sin(0.9 * i))));
+	START_TIMER("scattered rays in order");
+	mm.FindIntersections(binScattered, binFound, nullptr, false);
+	STOP_TIMER("scattered rays in order");
+	START_TIMER("scattered rays binned");
+	mm.FindIntersections(binScattered, binFound);
+	STOP_TIMER("scattered rays binned");
+
+	//image of the demo model on the pool, the main throughput benchmark of the query stack
+	RaycastImage<double> demoImage;
+	START_TIMER("raycast 512x512");
+	Raycast(mm, Camera<double>::LookAt(Point<double>(12, -12, 10), Point<double>(0, 0, 2), Vector<double>(0, 0, 1), 0.6), demoImage, 512, 512, &tp);
+	STOP_TIMER("raycast 512x512");
+
+	//sections of the demo model by a stack of planes along its axis
+	std::vector<double> demoLayers;
+	for (int i = 0; i < 2000; i++)
+		demoLayers.push_back(i * 0.002);
+	START_TIMER("slice 2000 layers");
+	auto demoSections = Slice(mm, Plane<double>(c1.Start(), c1.Direction()), demoLayers, &tp);
+	STOP_TIMER("slice 2000 layers");
+
+	//level of detail of a finer copy of the demo cylinder
+	TessModel<double> demoLod;
+	demoLod.SplitCylinder(c1, 4, 1e-9);
+	START_TIMER("simplify to 2%");
+	demoLod.Simplify(demoLod.TrianglesCount() / 50, std::numeric_limits<double>::max(), &tp);
+	STOP_TIMER("simplify to 2%");
+
+	//hull of a million points in a ball
+	std::vector<Point<double>> demoCloud;
+	for (int i = 0; i < 1000000; i++)
+	{
+		double r = cbrt(0.5 + 0.5 * sin(0.71 * i)), z = sin(1.3 * i), phi = 2.9 * i;
+		demoCloud.push_back(Point<double>(r * sqrt(1 - z * z) * cos(phi), r * sqrt(1 - z * z) * sin(phi), r * z));
+	}
+	START_TIMER("hull 1M points");
+	TessModel<double> demoHull = ConvexHull<double>(demoCloud, &tp);
+	STOP_TIMER("hull 1M points");
+
+	//one box against a million, one by one and as arrays of coordinates
+	std::vector<AABB<double>> demoBoxes;
+	for (int i = 0; i < 1000000; i++)
+	{
+		Point<double> corner(100 * sin(1.1 * i), 100 * cos(2.3 * i), 100 * sin(0.37 * i));
+		demoBoxes.push_back(AABB<double>(corner, corner + Vector<double>(1, 2, 3)));
+	}
+	AABB<double> demoProbe(Point<double>(-20, -20, -20), Point<double>(20, 20, 20));
+	std::vector<char> demoMask(demoBoxes.size());
+	START_TIMER("overlap one by one");
+	for (int i = 0; i < (int)demoBoxes.size(); i++)
+		demoMask[i] = demoBoxes[i].Intersects(demoProbe);
+	STOP_TIMER("overlap one by one");
+	AABBArray<double> demoArray(demoBoxes);
+	START_TIMER("overlap as arrays");
+	demoArray.Overlaps(demoProbe, demoMask);
+	STOP_TIMER("overlap as arrays");
+
+	//the same rotation of many vectors, one by one and as a batch
+	std::vector<Vector<double>> rotated(1 << 20, Vector<double>(1, 2, 3));
+	Vector<double> rotAxis(1, 1, 1);
+	START_TIMER("rotate one by one");
+	for (auto& vec : rotated)
+		vec = vec.Rotate(rotAxis, 0.1);
+	STOP_TIMER("rotate one by one");
+	START_TIMER("rotate all");
+	RotateAll(rotated, Quaternion<double>::RotationInit(rotAxis, 0.1));
+	STOP_TIMER("rotate all");
+
+	//projections on a plane with temporaries of the operators and with one lazy expression
+	Plane<double> exprPlane(Point<double>(1, 2, 3), Vector<double>(1, 1, 1));
+	std::vector<Point<double>> exprIn(1 << 20), exprOut(1 << 20);
+	for (int i = 0; i < (int)exprIn.size(); i++)
+		exprIn[i] = Point<double>(i % 101, i % 37, i % 13);
+	Vector<double> exprNorm = exprPlane.Normal();
+	START_TIMER("eager projections");
+	for (int i = 0; i < (int)exprIn.size(); i++)
+	{
+		double param = (exprPlane.Start() - exprIn[i]).DotProduct(exprNorm) / exprNorm.LengthPow2();
+		exprOut[i] = exprIn[i] + param * exprNorm - exprNorm * 0.5 + exprNorm * 0.5;
+	}
+	STOP_TIMER("eager projections");
+	START_TIMER("lazy projections");
+	for (int i = 0; i < (int)exprIn.size(); i++)
+	{
+		double param = (Lazy(exprPlane.Start()) - exprIn[i]).DotProduct(exprNorm) / exprNorm.LengthPow2();
+		exprOut[i] = Lazy(exprIn[i]) + Lazy(exprNorm) * param - Lazy(exprNorm) * 0.5 + Lazy(exprNorm) * 0.5;
+	}
+	STOP_TIMER("lazy projections");
+
 	Timer::PrintTimers();
+	Counters::PrintCounters();
 	int y = 0;
 }
\ No newline at end of file
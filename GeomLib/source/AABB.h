@@ -0,0 +1,204 @@
+#pragma once
+#include "Generic.h"
+#include <algorithm>
+#include <limits>
+#include <span>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace geomlib
+{
+	FLOATING(T)
+	class AABB
+	{
+	protected:
+		Point<T> m_ptMin;
+		Point<T> m_ptMax;
+	public:
+		//default box is empty, expanding it by any point makes it valid
+		AABB() : m_ptMin(std::numeric_limits<T>::max(), std::numeric_limits<T>::max(), std::numeric_limits<T>::max()),
+				 m_ptMax(-std::numeric_limits<T>::max(), -std::numeric_limits<T>::max(), -std::numeric_limits<T>::max()) {};
+		AABB(const Point<T>& mn, const Point<T>& mx) : m_ptMin(mn), m_ptMax(mx) {};
+		inline const Point<T>& Min() const { return m_ptMin; }
+		inline const Point<T>& Max() const { return m_ptMax; }
+
+		bool IsEmpty() const
+		{
+			return m_ptMin.X() > m_ptMax.X() || m_ptMin.Y() > m_ptMax.Y() || m_ptMin.Z() > m_ptMax.Z();
+		}
+
+		AABB<T>& Expand(const Point<T>& pt)
+		{
+			m_ptMin = Point<T>(std::min(m_ptMin.X(), pt.X()), std::min(m_ptMin.Y(), pt.Y()), std::min(m_ptMin.Z(), pt.Z()));
+			m_ptMax = Point<T>(std::max(m_ptMax.X(), pt.X()), std::max(m_ptMax.Y(), pt.Y()), std::max(m_ptMax.Z(), pt.Z()));
+			return *this;
+		}
+
+		AABB<T>& Expand(const AABB<T>& box)
+		{
+			m_ptMin = Point<T>(std::min(m_ptMin.X(), box.m_ptMin.X()), std::min(m_ptMin.Y(), box.m_ptMin.Y()), std::min(m_ptMin.Z(), box.m_ptMin.Z()));
+			m_ptMax = Point<T>(std::max(m_ptMax.X(), box.m_ptMax.X()), std::max(m_ptMax.Y(), box.m_ptMax.Y()), std::max(m_ptMax.Z(), box.m_ptMax.Z()));
+			return *this;
+		}
+
+		static AABB<T> Union(const AABB<T>& a, const AABB<T>& b)
+		{
+			AABB<T> res = a;
+			return res.Expand(b);
+		}
+
+		Point<T> Center() const
+		{
+			return Point<T>((m_ptMin.X() + m_ptMax.X()) / 2, (m_ptMin.Y() + m_ptMax.Y()) / 2, (m_ptMin.Z() + m_ptMax.Z()) / 2);
+		}
+
+		Vector<T> Extent() const
+		{
+			return m_ptMax - m_ptMin;
+		}
+
+		T SurfaceArea() const
+		{
+			if (IsEmpty()) return 0;
+			Vector<T> ext = Extent();
+			return 2 * (ext.X() * ext.Y() + ext.Y() * ext.Z() + ext.Z() * ext.X());
+		}
+
+		bool Contains(const AABB<T>& box) const
+		{
+			return m_ptMin.X() <= box.m_ptMin.X() && m_ptMin.Y() <= box.m_ptMin.Y() && m_ptMin.Z() <= box.m_ptMin.Z() &&
+				   m_ptMax.X() >= box.m_ptMax.X() && m_ptMax.Y() >= box.m_ptMax.Y() && m_ptMax.Z() >= box.m_ptMax.Z();
+		}
+
+		bool Contains(const Point<T>& pt) const
+		{
+			return m_ptMin.X() <= pt.X() && m_ptMin.Y() <= pt.Y() && m_ptMin.Z() <= pt.Z() &&
+				   m_ptMax.X() >= pt.X() && m_ptMax.Y() >= pt.Y() && m_ptMax.Z() >= pt.Z();
+		}
+
+		//boxes overlap when they are closer than eps along every axis, touching boxes overlap
+		bool Intersects(const AABB<T>& box, T eps = 0) const
+		{
+			return m_ptMin.X() <= box.m_ptMax.X() + eps && box.m_ptMin.X() <= m_ptMax.X() + eps &&
+				   m_ptMin.Y() <= box.m_ptMax.Y() + eps && box.m_ptMin.Y() <= m_ptMax.Y() + eps &&
+				   m_ptMin.Z() <= box.m_ptMax.Z() + eps && box.m_ptMin.Z() <= m_ptMax.Z() + eps;
+		}
+
+		bool operator== (const AABB<T>& rhs) const
+		{
+			return m_ptMin.X() == rhs.m_ptMin.X() && m_ptMin.Y() == rhs.m_ptMin.Y() && m_ptMin.Z() == rhs.m_ptMin.Z() &&
+				   m_ptMax.X() == rhs.m_ptMax.X() && m_ptMax.Y() == rhs.m_ptMax.Y() && m_ptMax.Z() == rhs.m_ptMax.Z();
+		}
+
+		//slab test, invDir holds reciprocals of the ray direction; tnear is a parameter along the ray
+		bool IntersectsRay(const Point<T>& start, const Vector<T>& invDir, T tmax, T& tnear, T eps = Epsilon::Eps()) const
+		{
+			T tx1 = (m_ptMin.X() - eps - start.X()) * invDir.X(), tx2 = (m_ptMax.X() + eps - start.X()) * invDir.X();
+			T ty1 = (m_ptMin.Y() - eps - start.Y()) * invDir.Y(), ty2 = (m_ptMax.Y() + eps - start.Y()) * invDir.Y();
+			T tz1 = (m_ptMin.Z() - eps - start.Z()) * invDir.Z(), tz2 = (m_ptMax.Z() + eps - start.Z()) * invDir.Z();
+			T tmin = std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::max(std::min(tz1, tz2), (T)0));
+			T tfar = std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::min(std::max(tz1, tz2), tmax));
+			tnear = tmin;
+			return tmin <= tfar;
+		}
+
+		std::string ToString() const
+		{
+			std::stringstream out;
+			out << "AABB with min point: ";
+			out << m_ptMin.ToString();
+			out << "    And max point: ";
+			out << m_ptMax.ToString();
+			return out.str();
+		}
+	};
+
+	//Boxes kept as separate arrays of coordinates. A box or a ray is tested against all of them in loops without
+	//branches over contiguous values, which the compiler turns into vector instructions; results go to a mask.
+	FLOATING(T)
+	class AABBArray
+	{
+	protected:
+		std::vector<T> m_vecMin[3];
+		std::vector<T> m_vecMax[3];
+	public:
+		AABBArray() = default;
+		AABBArray(std::span<const AABB<T>> boxes)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				m_vecMin[k].reserve(boxes.size());
+				m_vecMax[k].reserve(boxes.size());
+			}
+			for (const AABB<T>& box : boxes)
+				Add(box);
+		}
+
+		void Add(const AABB<T>& box)
+		{
+			m_vecMin[0].push_back(box.Min().X());
+			m_vecMin[1].push_back(box.Min().Y());
+			m_vecMin[2].push_back(box.Min().Z());
+			m_vecMax[0].push_back(box.Max().X());
+			m_vecMax[1].push_back(box.Max().Y());
+			m_vecMax[2].push_back(box.Max().Z());
+		}
+
+		void Clear()
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				m_vecMin[k].clear();
+				m_vecMax[k].clear();
+			}
+		}
+
+		inline int Size() const { return m_vecMin[0].size(); }
+
+		AABB<T> Get(int ind) const
+		{
+			return AABB<T>(Point<T>(m_vecMin[0][ind], m_vecMin[1][ind], m_vecMin[2][ind]), Point<T>(m_vecMax[0][ind], m_vecMax[1][ind], m_vecMax[2][ind]));
+		}
+
+		//mask[i] is 1 where box i overlaps box as by AABB::Intersects, returns the number of overlapping boxes
+		int Overlaps(const AABB<T>& box, std::span<char> mask, T eps = 0) const
+		{
+			const T *minX = m_vecMin[0].data(), *minY = m_vecMin[1].data(), *minZ = m_vecMin[2].data();
+			const T *maxX = m_vecMax[0].data(), *maxY = m_vecMax[1].data(), *maxZ = m_vecMax[2].data();
+			T loX = box.Min().X() - eps, loY = box.Min().Y() - eps, loZ = box.Min().Z() - eps;
+			T hiX = box.Max().X() + eps, hiY = box.Max().Y() + eps, hiZ = box.Max().Z() + eps;
+			int n = Size(), count = 0;
+			for (int i = 0; i < n; i++)
+			{
+				char hit = (minX[i] <= hiX) & (maxX[i] >= loX) & (minY[i] <= hiY) & (maxY[i] >= loY) & (minZ[i] <= hiZ) & (maxZ[i] >= loZ);
+				mask[i] = hit;
+				count += hit;
+			}
+			return count;
+		}
+
+		//slab test of one ray against every box as by AABB::IntersectsRay, tnear[i] is set for every box;
+		//returns the number of boxes hit
+		int IntersectsRay(const Point<T>& start, const Vector<T>& invDir, T tmax, std::span<char> mask, std::span<T> tnear, T eps = Epsilon::Eps()) const
+		{
+			T sx = start.X(), sy = start.Y(), sz = start.Z(), ix = invDir.X(), iy = invDir.Y(), iz = invDir.Z();
+			const T *minX = m_vecMin[0].data(), *minY = m_vecMin[1].data(), *minZ = m_vecMin[2].data();
+			const T *maxX = m_vecMax[0].data(), *maxY = m_vecMax[1].data(), *maxZ = m_vecMax[2].data();
+			int n = Size(), count = 0;
+			for (int i = 0; i < n; i++)
+			{
+				T tx1 = (minX[i] - eps - sx) * ix, tx2 = (maxX[i] + eps - sx) * ix;
+				T ty1 = (minY[i] - eps - sy) * iy, ty2 = (maxY[i] + eps - sy) * iy;
+				T tz1 = (minZ[i] - eps - sz) * iz, tz2 = (maxZ[i] + eps - sz) * iz;
+				T tmin = std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::max(std::min(tz1, tz2), (T)0));
+				T tfar = std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::min(std::max(tz1, tz2), tmax));
+				char hit = tmin <= tfar;
+				tnear[i] = tmin;
+				mask[i] = hit;
+				count += hit;
+			}
+			return count;
+		}
+	};
+}
\ No newline at end of file
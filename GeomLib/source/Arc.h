@@ -18,6 +18,7 @@ namespace geomlib
 			this->m_dblRadius = radius;
 			m_ptStart = start;
 			m_ptEnd = end;
+			this->UpdateBounds();
 		}
 		inline Point<T> Start() const { return m_ptStart; }
 		inline void SetStart(const Point<T>& start) { m_ptStart = start; }
@@ -0,0 +1,234 @@
+#pragma once
+#include "ThreadPool.h"
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace geomlib
+{
+	template <class R>
+	class Async;
+
+	template <class R>
+	class Promise;
+
+	//work that returns nothing is completed with true, so its Async still tells done, cancelled and failed apart
+	template <class F, class... A>
+	using AsyncResult = std::conditional_t<std::is_void_v<std::invoke_result_t<F, A...>>, bool, std::invoke_result_t<F, A...>>;
+
+	//result shared by a Promise and its Async handles; continuations run on the thread that completes it
+	template <class R>
+	class AsyncState
+	{
+	private:
+		std::mutex mtx;
+		std::condition_variable cv;
+		std::optional<R> value;
+		//set instead of value when the producer threw
+		std::exception_ptr error;
+		bool done = false;
+		std::atomic<bool> cancelled{ false };
+		std::vector<std::function<void()>> continuations;
+		friend class Async<R>;
+		friend class Promise<R>;
+
+		void Complete(std::optional<R>&& res, std::exception_ptr err = nullptr)
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			if (done)
+				return;
+			value = std::move(res);
+			error = err;
+			done = true;
+			std::vector<std::function<void()>> todo = std::move(continuations);
+			//notified under the lock, a woken waiter may destroy the state as soon as it is released
+			cv.notify_all();
+			lock.unlock();
+			for (auto& func : todo)
+				func();
+		}
+
+		//returns false without storing func if the result is already there
+		bool TryAddContinuation(std::function<void()>& func)
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (done)
+				return false;
+			continuations.push_back(std::move(func));
+			return true;
+		}
+
+		void AddContinuation(std::function<void()> func)
+		{
+			if (!TryAddContinuation(func))
+				func();
+		}
+	};
+
+	//producer side of an Async result
+	template <class R>
+	class Promise
+	{
+		static_assert(!std::is_void_v<R>, "Async results need a value, work without one is completed with bool");
+	private:
+		std::shared_ptr<AsyncState<R>> m_pState = std::make_shared<AsyncState<R>>();
+	public:
+		Async<R> GetAsync() const { return Async<R>(m_pState); }
+		//producers check it between parts of the work and finish early with SetCancelled
+		bool IsCancelled() const { return m_pState->cancelled; }
+		void Set(R res) { m_pState->Complete(std::move(res)); }
+		void SetCancelled() { m_pState->Complete(std::nullopt); }
+		//Get and co_await rethrow err, continuations pass it on
+		void SetException(std::exception_ptr err) { m_pState->Complete(std::nullopt, err); }
+
+		//completes with the result of func(), or with the exception it throws; continuations run outside of the catch
+		template <class F>
+		void SetFrom(F&& func)
+		{
+			std::optional<R> res;
+			try
+			{
+				if constexpr (std::is_void_v<decltype(func())>)
+				{
+					func();
+					res.emplace(true);
+				}
+				else
+					res.emplace(func());
+			}
+			catch (...)
+			{
+				SetException(std::current_exception());
+				return;
+			}
+			Set(std::move(*res));
+		}
+	};
+
+	//Handle of a result computed on a pool. It is waited for, chained with Then, or awaited in a coroutine;
+	//Wait and Get block the caller, so tasks of the same pool should use Then or co_await instead.
+	template <class R>
+	class Async
+	{
+		static_assert(!std::is_void_v<R>, "Async results need a value, work without one is completed with bool");
+	private:
+		std::shared_ptr<AsyncState<R>> m_pState;
+	public:
+		Async() = default;
+		explicit Async(std::shared_ptr<AsyncState<R>> state) : m_pState(std::move(state)) {}
+
+		inline bool IsValid() const { return (bool)m_pState; }
+
+		bool IsReady() const
+		{
+			std::lock_guard<std::mutex> lock(m_pState->mtx);
+			return m_pState->done;
+		}
+
+		//finished without a value and without an exception
+		bool IsCancelled() const
+		{
+			std::lock_guard<std::mutex> lock(m_pState->mtx);
+			return m_pState->done && !m_pState->value && !m_pState->error;
+		}
+
+		//finished with an exception of the producer
+		bool IsFailed() const
+		{
+			std::lock_guard<std::mutex> lock(m_pState->mtx);
+			return m_pState->done && m_pState->error;
+		}
+
+		//asks the producer to stop, work that has not started yet is skipped
+		void Cancel() { m_pState->cancelled = true; }
+
+		void Wait() const
+		{
+			std::unique_lock<std::mutex> lock(m_pState->mtx);
+			m_pState->cv.wait(lock, [this]() { return m_pState->done; });
+		}
+
+		//waits for the result, returns false if the work was cancelled and rethrows what the producer threw
+		bool Get(R& res) const
+		{
+			Wait();
+			if (m_pState->error)
+				std::rethrow_exception(m_pState->error);
+			if (!m_pState->value)
+				return false;
+			res = *m_pState->value;
+			return true;
+		}
+
+		//func(const R&) runs when the result is ready, the returned handle is cancelled if this one is
+		//and fails with the same exception if this one does
+		template <class F>
+		auto Then(F func) const -> Async<AsyncResult<F, const R&>>
+		{
+			using U = AsyncResult<F, const R&>;
+			Promise<U> next;
+			std::shared_ptr<AsyncState<R>> state = m_pState;
+			m_pState->AddContinuation([state, next, func = std::move(func)]() mutable {
+				if (state->error)
+					next.SetException(state->error);
+				else if (state->value && !next.IsCancelled())
+					next.SetFrom([&]() { return func(*state->value); });
+				else
+					next.SetCancelled();
+			});
+			return next.GetAsync();
+		}
+
+		//co_await gives std::optional<R>, empty if cancelled, and rethrows what the producer threw;
+		//the coroutine resumes on the completing thread
+		bool await_ready() const { return IsReady(); }
+		bool await_suspend(std::coroutine_handle<> handle) const
+		{
+			std::function<void()> resume = [handle]() { handle.resume(); };
+			//a result that came meanwhile continues the coroutine at once
+			return m_pState->TryAddContinuation(resume);
+		}
+		std::optional<R> await_resume() const
+		{
+			if (m_pState->error)
+				std::rethrow_exception(m_pState->error);
+			return m_pState->value;
+		}
+	};
+
+	//runs func() on tp; cancelled before it starts, func is not called; an exception of func fails the result
+	template <class F>
+	auto RunAsync(ThreadPool& tp, F func) -> Async<AsyncResult<F>>
+	{
+		using R = AsyncResult<F>;
+		Promise<R> promise;
+		tp.AssignTask(std::make_shared<FunctionTask>([promise, func = std::move(func)]() mutable {
+			if (promise.IsCancelled())
+				promise.SetCancelled();
+			else
+				promise.SetFrom(func);
+		}));
+		return promise.GetAsync();
+	}
+
+	//return type of coroutines that only await Async results: starts at once and nobody waits for its end
+	struct AsyncTask
+	{
+		struct promise_type
+		{
+			AsyncTask get_return_object() { return {}; }
+			std::suspend_never initial_suspend() { return {}; }
+			std::suspend_never final_suspend() noexcept { return {}; }
+			void return_void() {}
+			void unhandled_exception() { std::terminate(); }
+		};
+	};
+}
\ No newline at end of file
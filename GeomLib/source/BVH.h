@@ -0,0 +1,744 @@
+#pragma once
+#include "ThreadPool.h"
+#include "Morton.h"
+#include "AABB.h"
+#include "Ray.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <mutex>
+
+namespace geomlib
+{
+	//Bounding volume hierarchy over primitives (triangles) addressed by index.
+	//Each primitive range (surface) gets its own subtree, subtrees are joined by top-level nodes.
+	//Geometry is not stored here: every method that needs primitive bounds takes a functor boxOf(int) -> AABB<T>.
+	FLOATING(T)
+	class BVH
+	{
+	public:
+		struct Node
+		{
+			AABB<T> box;
+			int left = -1, right = -1, parent = -1;
+			//leaves refer to m_vecIndices[first, first + count)
+			int first = 0, count = 0;
+			inline bool IsLeaf() const { return count > 0; }
+		};
+
+	protected:
+		static const int s_iLeafSize = 4;
+		static const int s_iBins = 12;
+
+		std::vector<Node> m_vecNodes;
+		std::vector<int> m_vecIndices;
+		std::vector<int> m_vecLeafOf;
+		int m_iRoot = -1;
+		//incremented on every change of topology, background builds of an older version are dropped
+		int m_iVersion = 0;
+		//unnormalized SAH sum: areas of internal nodes plus areas of leaves weighted by primitive count
+		T m_dblAreaSum = 0;
+		//expected sum for the current primitives: value after the last full build plus freshly built subtrees
+		T m_dblBuiltSum = 0;
+		T m_dblRebuildRatio = 1.5;
+
+		struct PendingBuild
+		{
+			std::mutex mtx;
+			bool ready = false;
+			int version = 0;
+			std::vector<Node> nodes;
+			std::vector<int> indices;
+			int root = -1;
+		};
+		std::shared_ptr<PendingBuild> m_pPending;
+
+		class RebuildTask : public ThreadTask
+		{
+		private:
+			std::shared_ptr<PendingBuild> pending;
+			std::vector<std::pair<int, int>> ranges;
+			std::vector<AABB<T>> boxes;
+
+		public:
+			RebuildTask(const std::shared_ptr<PendingBuild>& _pending, const std::vector<std::pair<int, int>>& _ranges, std::vector<AABB<T>>&& _boxes)
+				: pending(_pending), ranges(_ranges), boxes(std::move(_boxes)) {}
+			void ToDo() override
+			{
+				BVH<T> tmp;
+				tmp.Build(ranges, [this](int i) -> const AABB<T>& { return boxes[i]; });
+				std::lock_guard<std::mutex> lock(pending->mtx);
+				pending->nodes = std::move(tmp.m_vecNodes);
+				pending->indices = std::move(tmp.m_vecIndices);
+				pending->root = tmp.m_iRoot;
+				pending->ready = true;
+			}
+		};
+
+		T Weight(int node) const
+		{
+			return m_vecNodes[node].IsLeaf() ? (T)m_vecNodes[node].count : (T)1;
+		}
+
+		//every change of a node box goes through here to keep m_dblAreaSum in O(1)
+		void SetBox(int node, const AABB<T>& box)
+		{
+			m_dblAreaSum += (box.SurfaceArea() - m_vecNodes[node].box.SurfaceArea()) * Weight(node);
+			m_vecNodes[node].box = box;
+		}
+
+		int NewNode()
+		{
+			m_vecNodes.emplace_back();
+			return (int)m_vecNodes.size() - 1;
+		}
+
+		template <class F>
+		AABB<T> LeafBox(const Node& leaf, F& boxOf) const
+		{
+			AABB<T> box;
+			for (int i = leaf.first; i < leaf.first + leaf.count; i++)
+				box.Expand(boxOf(m_vecIndices[i]));
+			return box;
+		}
+
+		//binned SAH build over m_vecIndices[first, last), returns index of the subtree root
+		template <class F>
+		int BuildRecursive(int first, int last, F& boxOf)
+		{
+			int node = NewNode();
+			AABB<T> box, centers;
+			for (int i = first; i < last; i++)
+			{
+				const AABB<T>& b = boxOf(m_vecIndices[i]);
+				box.Expand(b);
+				centers.Expand(b.Center());
+			}
+			m_vecNodes[node].box = box;
+			int count = last - first;
+			if (count <= s_iLeafSize)
+			{
+				MakeLeaf(node, first, count, box);
+				return node;
+			}
+
+			Vector<T> ext = centers.Extent();
+			int axis = (ext.X() >= ext.Y() && ext.X() >= ext.Z()) ? 0 : (ext.Y() >= ext.Z() ? 1 : 2);
+			T lo = Coord(centers.Min(), axis), span = Coord(centers.Max(), axis) - lo;
+			int mid = first + count / 2;
+			if (span > 0)
+			{
+				AABB<T> binBox[s_iBins];
+				int binCount[s_iBins] = {};
+				auto binOf = [&](int prim) {
+					int b = (int)((Coord(boxOf(prim).Center(), axis) - lo) / span * s_iBins);
+					return std::min(b, s_iBins - 1);
+				};
+				for (int i = first; i < last; i++)
+				{
+					int b = binOf(m_vecIndices[i]);
+					binCount[b]++;
+					binBox[b].Expand(boxOf(m_vecIndices[i]));
+				}
+				//sweep from the right to get areas of suffixes, then from the left to evaluate splits
+				T rightArea[s_iBins];
+				int rightCount[s_iBins];
+				AABB<T> acc;
+				int cnt = 0;
+				for (int b = s_iBins - 1; b > 0; b--)
+				{
+					acc.Expand(binBox[b]);
+					cnt += binCount[b];
+					rightArea[b] = acc.SurfaceArea();
+					rightCount[b] = cnt;
+				}
+				acc = AABB<T>();
+				cnt = 0;
+				T best = std::numeric_limits<T>::max();
+				int bestSplit = -1;
+				for (int b = 1; b < s_iBins; b++)
+				{
+					acc.Expand(binBox[b - 1]);
+					cnt += binCount[b - 1];
+					if (cnt == 0 || rightCount[b] == 0) continue;
+					T cost = acc.SurfaceArea() * cnt + rightArea[b] * rightCount[b];
+					if (cost < best)
+					{
+						best = cost;
+						bestSplit = b;
+					}
+				}
+				if (bestSplit > 0)
+				{
+					auto it = std::partition(m_vecIndices.begin() + first, m_vecIndices.begin() + last,
+						[&](int prim) { return binOf(prim) < bestSplit; });
+					mid = (int)(it - m_vecIndices.begin());
+				}
+			}
+			//all centroids coincide or SAH found no split: fall back to the median
+			if (mid == first || mid == last)
+				mid = first + count / 2;
+
+			int left = BuildRecursive(first, mid, boxOf);
+			int right = BuildRecursive(mid, last, boxOf);
+			m_vecNodes[node].left = left;
+			m_vecNodes[node].right = right;
+			m_vecNodes[left].parent = node;
+			m_vecNodes[right].parent = node;
+			m_dblAreaSum += box.SurfaceArea();
+			return node;
+		}
+
+		void MakeLeaf(int node, int first, int count, const AABB<T>& box)
+		{
+			m_vecNodes[node].first = first;
+			m_vecNodes[node].count = count;
+			m_dblAreaSum += box.SurfaceArea() * count;
+		}
+
+		void MapLeaves(int fromNode)
+		{
+			for (int node = fromNode; node < (int)m_vecNodes.size(); node++)
+			{
+				const Node& n = m_vecNodes[node];
+				for (int i = n.first; i < n.first + n.count; i++)
+					m_vecLeafOf[m_vecIndices[i]] = node;
+			}
+		}
+
+		//joins already built subtrees by median splits of their centers
+		int BuildTop(std::vector<int>& roots, int first, int last)
+		{
+			if (last - first == 1)
+				return roots[first];
+			AABB<T> box, centers;
+			for (int i = first; i < last; i++)
+			{
+				box.Expand(m_vecNodes[roots[i]].box);
+				centers.Expand(m_vecNodes[roots[i]].box.Center());
+			}
+			Vector<T> ext = centers.Extent();
+			int axis = (ext.X() >= ext.Y() && ext.X() >= ext.Z()) ? 0 : (ext.Y() >= ext.Z() ? 1 : 2);
+			int mid = (first + last) / 2;
+			std::nth_element(roots.begin() + first, roots.begin() + mid, roots.begin() + last, [&](int a, int b) {
+				return Coord(m_vecNodes[a].box.Center(), axis) < Coord(m_vecNodes[b].box.Center(), axis);
+			});
+			int left = BuildTop(roots, first, mid);
+			int right = BuildTop(roots, mid, last);
+			int node = NewNode();
+			m_vecNodes[node].box = box;
+			m_vecNodes[node].left = left;
+			m_vecNodes[node].right = right;
+			m_vecNodes[left].parent = node;
+			m_vecNodes[right].parent = node;
+			m_dblAreaSum += box.SurfaceArea();
+			return node;
+		}
+
+		template <class F>
+		void RefitRecursive(int node, F& boxOf)
+		{
+			Node& n = m_vecNodes[node];
+			if (n.IsLeaf())
+			{
+				SetBox(node, LeafBox(n, boxOf));
+				return;
+			}
+			RefitRecursive(n.left, boxOf);
+			RefitRecursive(n.right, boxOf);
+			SetBox(node, AABB<T>::Union(m_vecNodes[n.left].box, m_vecNodes[n.right].box));
+		}
+
+		static T Coord(const Point<T>& pt, int axis)
+		{
+			return axis == 0 ? pt.X() : (axis == 1 ? pt.Y() : pt.Z());
+		}
+
+	public:
+		BVH() = default;
+		BVH(const BVH<T>& rhs) { *this = rhs; }
+		BVH<T>& operator= (const BVH<T>& rhs)
+		{
+			//pending background build belongs to the source object and is not shared
+			m_vecNodes = rhs.m_vecNodes;
+			m_vecIndices = rhs.m_vecIndices;
+			m_vecLeafOf = rhs.m_vecLeafOf;
+			m_iRoot = rhs.m_iRoot;
+			m_iVersion = rhs.m_iVersion;
+			m_dblAreaSum = rhs.m_dblAreaSum;
+			m_dblBuiltSum = rhs.m_dblBuiltSum;
+			m_dblRebuildRatio = rhs.m_dblRebuildRatio;
+			m_pPending.reset();
+			return *this;
+		}
+
+		inline bool IsEmpty() const { return m_iRoot < 0; }
+		inline int Root() const { return m_iRoot; }
+		inline const std::vector<Node>& Nodes() const { return m_vecNodes; }
+		inline const std::vector<int>& Indices() const { return m_vecIndices; }
+		inline int Version() const { return m_iVersion; }
+		inline T RebuildRatio() const { return m_dblRebuildRatio; }
+		inline void SetRebuildRatio(T ratio) { m_dblRebuildRatio = ratio; }
+
+		void Clear()
+		{
+			m_vecNodes.clear();
+			m_vecIndices.clear();
+			m_vecLeafOf.clear();
+			m_iRoot = -1;
+			m_dblAreaSum = 0;
+			m_dblBuiltSum = 0;
+			m_iVersion++;
+		}
+
+		//SAH cost normalized by the root area, lower is better
+		T Cost() const
+		{
+			if (IsEmpty()) return 0;
+			T area = m_vecNodes[m_iRoot].box.SurfaceArea();
+			return area > 0 ? m_dblAreaSum / area : 0;
+		}
+
+		//ratio of the current SAH sum to the expected one, grows when refits and insertions inflate the top nodes
+		T Degradation() const
+		{
+			return m_dblBuiltSum > 0 ? m_dblAreaSum / m_dblBuiltSum : 1;
+		}
+
+		inline bool NeedsRebuild() const { return Degradation() > m_dblRebuildRatio; }
+
+		//full build, ranges are [first, last] of primitives, one subtree per range;
+		//subtrees are independent and are built in parallel if tp is given, boxOf must then be thread-safe
+		template <class F>
+		void Build(const std::vector<std::pair<int, int>>& ranges, F boxOf, ThreadPool* tp = nullptr)
+		{
+			Clear();
+			int count = 0;
+			for (auto& r : ranges)
+				count = std::max(count, r.second + 1);
+			m_vecLeafOf.assign(count, -1);
+
+			std::vector<BVH<T>> parts(ranges.size());
+			std::vector<int> roots(ranges.size(), -1);
+			auto buildParts = [&](int from, int to) {
+				for (int k = from; k < to; k++)
+				{
+					if (ranges[k].second < ranges[k].first) continue;
+					BVH<T>& part = parts[k];
+					part.m_vecIndices.reserve(ranges[k].second - ranges[k].first + 1);
+					for (int i = ranges[k].first; i <= ranges[k].second; i++)
+						part.m_vecIndices.push_back(i);
+					roots[k] = part.BuildRecursive(0, (int)part.m_vecIndices.size(), boxOf);
+				}
+			};
+			if (tp)
+				tp->ParallelFor(0, (int)ranges.size(), buildParts);
+			else
+				buildParts(0, (int)ranges.size());
+
+			//splice the parts into one array, offsets are known in advance so the copies are independent
+			std::vector<int> nodeBase(parts.size() + 1, 0), indexBase(parts.size() + 1, 0);
+			for (int k = 0; k < (int)parts.size(); k++)
+			{
+				nodeBase[k + 1] = nodeBase[k] + (int)parts[k].m_vecNodes.size();
+				indexBase[k + 1] = indexBase[k] + (int)parts[k].m_vecIndices.size();
+				m_dblAreaSum += parts[k].m_dblAreaSum;
+			}
+			m_vecNodes.resize(nodeBase.back());
+			m_vecIndices.resize(indexBase.back());
+			auto spliceParts = [&](int from, int to) {
+				for (int k = from; k < to; k++)
+				{
+					const BVH<T>& part = parts[k];
+					std::copy(part.m_vecIndices.begin(), part.m_vecIndices.end(), m_vecIndices.begin() + indexBase[k]);
+					for (int i = 0; i < (int)part.m_vecNodes.size(); i++)
+					{
+						Node n = part.m_vecNodes[i];
+						if (n.left >= 0) n.left += nodeBase[k];
+						if (n.right >= 0) n.right += nodeBase[k];
+						if (n.parent >= 0) n.parent += nodeBase[k];
+						n.first += indexBase[k];
+						m_vecNodes[nodeBase[k] + i] = n;
+						for (int j = n.first; j < n.first + n.count; j++)
+							m_vecLeafOf[m_vecIndices[j]] = nodeBase[k] + i;
+					}
+				}
+			};
+			if (tp)
+				tp->ParallelFor(0, (int)parts.size(), spliceParts);
+			else
+				spliceParts(0, (int)parts.size());
+
+			std::vector<int> tops;
+			for (int k = 0; k < (int)parts.size(); k++)
+				if (roots[k] >= 0)
+					tops.push_back(roots[k] + nodeBase[k]);
+			if (!tops.empty())
+			{
+				m_iRoot = BuildTop(tops, 0, (int)tops.size());
+				m_vecNodes[m_iRoot].parent = -1;
+			}
+			m_dblBuiltSum = m_dblAreaSum;
+		}
+
+		//Linear build for models that are queried right after loading: primitives are sorted by Morton codes
+		//of their centers and the hierarchy is emitted from the sorted codes (Karras, 2012), every step runs on tp.
+		//With several ranges the range number goes above a 30-bit code, so each range still forms its own subtree;
+		//a single range uses 63-bit codes. Quality is below the SAH build, ScheduleRebuild can replace it later.
+		template <class F>
+		void BuildLinear(const std::vector<std::pair<int, int>>& ranges, F boxOf, ThreadPool* tp = nullptr)
+		{
+			Clear();
+			int count = 0;
+			for (auto& r : ranges)
+				count = std::max(count, r.second + 1);
+			m_vecLeafOf.assign(count, -1);
+			std::vector<int> prims;
+			std::vector<int> rangeOf;
+			for (int k = 0; k < (int)ranges.size(); k++)
+				for (int i = ranges[k].first; i <= ranges[k].second; i++)
+				{
+					prims.push_back(i);
+					rangeOf.push_back(k);
+				}
+			int n = prims.size();
+			if (n == 0)
+				return;
+			auto parallel = [tp](int from, int to, auto body) {
+				if (tp)
+					tp->ParallelFor(from, to, body, 4096);
+				else
+					body(from, to);
+			};
+
+			//bounds of primitives and of their centers, chunks merge their partial results under a lock
+			std::vector<AABB<T>> boxes(n);
+			AABB<T> centers;
+			std::mutex mtx;
+			parallel(0, n, [&](int from, int to) {
+				AABB<T> local;
+				for (int i = from; i < to; i++)
+				{
+					boxes[i] = boxOf(prims[i]);
+					local.Expand(boxes[i].Center());
+				}
+				std::lock_guard<std::mutex> lock(mtx);
+				centers.Expand(local);
+			});
+
+			bool single = ranges.size() <= 1;
+			std::vector<uint64_t> keys(n);
+			std::vector<int> order(n);
+			parallel(0, n, [&](int from, int to) {
+				for (int i = from; i < to; i++)
+				{
+					Point<T> c = boxes[i].Center();
+					keys[i] = single ? MortonCode63(c, centers) : ((uint64_t)rangeOf[i] << 30 | MortonCode30(c, centers));
+					order[i] = i;
+				}
+			});
+			int rangeBits = single ? 0 : std::bit_width((unsigned)ranges.size());
+			RadixSort(keys, order, single ? 63 : 30 + rangeBits, tp);
+
+			//internal nodes are [0, n - 1), leaf of sorted position i is n - 1 + i; equal codes are told apart by positions
+			auto delta = [&](int i, int j) -> int {
+				if (j < 0 || j >= n)
+					return -1;
+				if (keys[i] == keys[j])
+					return 64 + std::countl_zero((uint32_t)(i ^ j));
+				return std::countl_zero(keys[i] ^ keys[j]);
+			};
+			int internal = n - 1;
+			std::vector<int> left(internal), right(internal), parent(2 * n - 1, -1), lo(internal), hi(internal);
+			parallel(0, internal, [&](int from, int to) {
+				for (int i = from; i < to; i++)
+				{
+					int d = delta(i, i + 1) - delta(i, i - 1) > 0 ? 1 : -1;
+					int minDelta = delta(i, i - d);
+					int lmax = 2;
+					while (delta(i, i + lmax * d) > minDelta)
+						lmax *= 2;
+					int l = 0;
+					for (int t = lmax / 2; t >= 1; t /= 2)
+						if (delta(i, i + (l + t) * d) > minDelta)
+							l += t;
+					int j = i + l * d;
+					int nodeDelta = delta(i, j);
+					int split = 0;
+					for (int t = (l + 1) / 2; ; t = (t + 1) / 2)
+					{
+						if (delta(i, i + (split + t) * d) > nodeDelta)
+							split += t;
+						if (t == 1)
+							break;
+					}
+					int gamma = i + split * d + std::min(d, 0);
+					lo[i] = std::min(i, j);
+					hi[i] = std::max(i, j);
+					left[i] = lo[i] == gamma ? internal + gamma : gamma;
+					right[i] = hi[i] == gamma + 1 ? internal + gamma + 1 : gamma + 1;
+					parent[left[i]] = i;
+					parent[right[i]] = i;
+				}
+			});
+
+			//bounds go up from the leaves, the second child to arrive at a node computes its box
+			std::vector<AABB<T>> nodeBox(2 * n - 1);
+			std::vector<std::atomic<int>> arrived(internal);
+			parallel(0, n, [&](int from, int to) {
+				for (int i = from; i < to; i++)
+				{
+					nodeBox[internal + i] = boxes[order[i]];
+					for (int node = parent[internal + i]; node >= 0; node = parent[node])
+					{
+						if (arrived[node].fetch_add(1, std::memory_order_acq_rel) == 0)
+							break;
+						nodeBox[node] = AABB<T>::Union(nodeBox[left[node]], nodeBox[right[node]]);
+					}
+				}
+			});
+
+			//depth-first emission, subtrees of at most s_iLeafSize primitives are collapsed into leaves
+			m_vecIndices.resize(n);
+			parallel(0, n, [&](int from, int to) {
+				for (int i = from; i < to; i++)
+					m_vecIndices[i] = prims[order[i]];
+			});
+			m_vecNodes.reserve(2 * n / s_iLeafSize + 1);
+			std::vector<std::pair<int, int>> stack = { { n > 1 ? 0 : internal, -1 } };
+			while (!stack.empty())
+			{
+				auto [src, par] = stack.back();
+				stack.pop_back();
+				int node = NewNode();
+				Node& dst = m_vecNodes[node];
+				dst.box = nodeBox[src];
+				dst.parent = par;
+				if (par >= 0)
+				{
+					if (m_vecNodes[par].left < 0)
+						m_vecNodes[par].left = node;
+					else
+						m_vecNodes[par].right = node;
+				}
+				int first = src >= internal ? src - internal : lo[src];
+				int last = src >= internal ? src - internal : hi[src];
+				if (last - first + 1 <= s_iLeafSize)
+				{
+					MakeLeaf(node, first, last - first + 1, dst.box);
+					continue;
+				}
+				m_dblAreaSum += dst.box.SurfaceArea();
+				stack.push_back({ right[src], node });
+				stack.push_back({ left[src], node });
+			}
+			MapLeaves(0);
+			m_iRoot = 0;
+			m_dblBuiltSum = m_dblAreaSum;
+		}
+
+		//inserts primitives [first, last] as a new subtree, the place is chosen by the least area growth
+		template <class F>
+		void Insert(int first, int last, F boxOf)
+		{
+			if (last < first) return;
+			if (IsEmpty())
+			{
+				Build({ { first, last } }, boxOf);
+				return;
+			}
+			m_iVersion++;
+			int start = (int)m_vecIndices.size();
+			for (int i = first; i <= last; i++)
+				m_vecIndices.push_back(i);
+			if ((int)m_vecLeafOf.size() <= last)
+				m_vecLeafOf.resize(last + 1, -1);
+			T before = m_dblAreaSum;
+			int nodes = (int)m_vecNodes.size();
+			int sub = BuildRecursive(start, (int)m_vecIndices.size(), boxOf);
+			MapLeaves(nodes);
+			//fresh subtree is as good as a full build would make it, only the top part may degrade
+			T subCost = m_dblAreaSum - before;
+			const AABB<T> box = m_vecNodes[sub].box;
+
+			int sibling = m_iRoot;
+			while (!m_vecNodes[sibling].IsLeaf())
+			{
+				const Node& n = m_vecNodes[sibling];
+				T area = n.box.SurfaceArea();
+				T combined = AABB<T>::Union(n.box, box).SurfaceArea();
+				T costHere = 2 * combined;
+				T inherited = 2 * (combined - area);
+				auto descend = [&](int child) {
+					T grown = AABB<T>::Union(m_vecNodes[child].box, box).SurfaceArea();
+					if (m_vecNodes[child].IsLeaf())
+						return grown * Weight(child) + inherited;
+					return grown - m_vecNodes[child].box.SurfaceArea() + inherited;
+				};
+				T costLeft = descend(n.left), costRight = descend(n.right);
+				if (costHere < costLeft && costHere < costRight)
+					break;
+				sibling = costLeft < costRight ? n.left : n.right;
+			}
+
+			int oldParent = m_vecNodes[sibling].parent;
+			int node = NewNode();
+			m_vecNodes[node].parent = oldParent;
+			m_vecNodes[node].left = sibling;
+			m_vecNodes[node].right = sub;
+			SetBox(node, AABB<T>::Union(m_vecNodes[sibling].box, box));
+			m_vecNodes[sibling].parent = node;
+			m_vecNodes[sub].parent = node;
+			if (oldParent < 0)
+				m_iRoot = node;
+			else if (m_vecNodes[oldParent].left == sibling)
+				m_vecNodes[oldParent].left = node;
+			else
+				m_vecNodes[oldParent].right = node;
+			for (int p = oldParent; p >= 0; p = m_vecNodes[p].parent)
+				SetBox(p, AABB<T>::Union(m_vecNodes[m_vecNodes[p].left].box, m_vecNodes[m_vecNodes[p].right].box));
+
+			m_dblBuiltSum += subCost;
+		}
+
+		//updates bounds after primitives moved, touches only their leaves and the ancestors that actually change
+		template <class F>
+		void Refit(const std::vector<int>& prims, F boxOf)
+		{
+			for (int prim : prims)
+			{
+				if (prim >= (int)m_vecLeafOf.size() || m_vecLeafOf[prim] < 0) continue;
+				int node = m_vecLeafOf[prim];
+				AABB<T> box = LeafBox(m_vecNodes[node], boxOf);
+				if (box == m_vecNodes[node].box) continue;
+				SetBox(node, box);
+				for (node = m_vecNodes[node].parent; node >= 0; node = m_vecNodes[node].parent)
+				{
+					box = AABB<T>::Union(m_vecNodes[m_vecNodes[node].left].box, m_vecNodes[m_vecNodes[node].right].box);
+					if (box == m_vecNodes[node].box) break;
+					SetBox(node, box);
+				}
+			}
+		}
+
+		template <class F>
+		void RefitAll(F boxOf)
+		{
+			if (!IsEmpty())
+				RefitRecursive(m_iRoot, boxOf);
+		}
+
+		//starts a full rebuild on the pool from a snapshot of the bounds; does nothing if one is already running
+		template <class F>
+		void ScheduleRebuild(ThreadPool& tp, const std::vector<std::pair<int, int>>& ranges, int count, F boxOf)
+		{
+			if (m_pPending)
+			{
+				std::lock_guard<std::mutex> lock(m_pPending->mtx);
+				if (!m_pPending->ready) return;
+			}
+			std::vector<AABB<T>> boxes(count);
+			for (int i = 0; i < count; i++)
+				boxes[i] = boxOf(i);
+			m_pPending = std::make_shared<PendingBuild>();
+			m_pPending->version = m_iVersion;
+			tp.AssignTask(std::shared_ptr<ThreadTask>(new RebuildTask(m_pPending, ranges, std::move(boxes))));
+		}
+
+		//takes over a finished background build, primitives may have moved since the snapshot so bounds are refit
+		template <class F>
+		bool AdoptRebuild(F boxOf)
+		{
+			if (!m_pPending) return false;
+			std::unique_lock<std::mutex> lock(m_pPending->mtx);
+			if (!m_pPending->ready) return false;
+			bool valid = m_pPending->version == m_iVersion;
+			if (valid)
+			{
+				m_vecNodes = std::move(m_pPending->nodes);
+				m_vecIndices = std::move(m_pPending->indices);
+				m_iRoot = m_pPending->root;
+			}
+			lock.unlock();
+			m_pPending.reset();
+			if (!valid) return false;
+
+			m_dblAreaSum = 0;
+			for (int node = 0; node < (int)m_vecNodes.size(); node++)
+				m_dblAreaSum += m_vecNodes[node].box.SurfaceArea() * Weight(node);
+			MapLeaves(0);
+			RefitAll(boxOf);
+			m_dblBuiltSum = m_dblAreaSum;
+			return true;
+		}
+
+		inline bool IsRebuildPending() const { return (bool)m_pPending; }
+
+		//closest hit traversal, visit(prim, tmax) tests a primitive and lowers tmax on a closer hit
+		template <class F>
+		void Traverse(const Ray<T>& ray, T& tmax, F visit) const
+		{
+			if (IsEmpty()) return;
+			const Vector<T>& dir = ray.Direction();
+			Vector<T> invDir(1 / dir.X(), 1 / dir.Y(), 1 / dir.Z());
+			Point<T> start = ray.Start();
+			int stack[64];
+			int top = 0, visited = 0;
+			T tnear;
+			if (!m_vecNodes[m_iRoot].box.IntersectsRay(start, invDir, tmax, tnear)) return;
+			stack[top++] = m_iRoot;
+			while (top > 0)
+			{
+				const Node& n = m_vecNodes[stack[--top]];
+				visited++;
+				if (!n.box.IntersectsRay(start, invDir, tmax, tnear)) continue;
+				if (n.IsLeaf())
+				{
+					for (int i = n.first; i < n.first + n.count; i++)
+						visit(m_vecIndices[i], tmax);
+					continue;
+				}
+				T tl, tr;
+				bool hl = m_vecNodes[n.left].box.IntersectsRay(start, invDir, tmax, tl);
+				bool hr = m_vecNodes[n.right].box.IntersectsRay(start, invDir, tmax, tr);
+				//nearer child is pushed last to be visited first
+				if (hl && hr)
+				{
+					if (tl < tr) { stack[top++] = n.right; stack[top++] = n.left; }
+					else { stack[top++] = n.left; stack[top++] = n.right; }
+				}
+				else if (hl) stack[top++] = n.left;
+				else if (hr) stack[top++] = n.right;
+				if (top > 62)
+				{
+					//tree is too deep for the fixed stack, finish this branch recursively
+					while (top > 0)
+						TraverseFrom(stack[--top], start, invDir, tmax, visit, visited);
+				}
+			}
+			//counted once per query, a shared counter per node would cost more than the traversal
+			COUNT_EVENT(NodesVisited, visited);
+		}
+
+	protected:
+		template <class F>
+		void TraverseFrom(int node, const Point<T>& start, const Vector<T>& invDir, T& tmax, F& visit, int& visited) const
+		{
+			T tnear;
+			const Node& n = m_vecNodes[node];
+			visited++;
+			if (!n.box.IntersectsRay(start, invDir, tmax, tnear)) return;
+			if (n.IsLeaf())
+			{
+				for (int i = n.first; i < n.first + n.count; i++)
+					visit(m_vecIndices[i], tmax);
+				return;
+			}
+			TraverseFrom(n.left, start, invDir, tmax, visit, visited);
+			TraverseFrom(n.right, start, invDir, tmax, visit, visited);
+		}
+	};
+}
\ No newline at end of file
@@ -1,5 +1,9 @@
 #pragma once
 #include "Generic.h"
+#include "AABB.h"
+#include "OBB.h"
+#include <algorithm>
+#include <cmath>
 
 namespace geomlib
 {
@@ -10,27 +14,46 @@ namespace geomlib
 		Point<T> m_ptCenter;
 		Vector<T> m_vecAxis;
 		T m_dblRadius;
+		//box of the circle, recomputed whenever center, axis or radius change
+		AABB<T> m_boxBounds;
+
+		//along a coordinate axis the circle spans radius * sin of the angle between it and the axis of the circle
+		void UpdateBounds()
+		{
+			T len = m_vecAxis.Length();
+			T a[3] = { m_vecAxis.X() / len, m_vecAxis.Y() / len, m_vecAxis.Z() / len };
+			Vector<T> half(m_dblRadius * sqrt(std::max<T>(1 - a[0] * a[0], 0)), m_dblRadius * sqrt(std::max<T>(1 - a[1] * a[1], 0)), m_dblRadius * sqrt(std::max<T>(1 - a[2] * a[2], 0)));
+			m_boxBounds = AABB<T>(m_ptCenter - half, m_ptCenter + half);
+		}
 	public:
 		Circle() = default;
-		Circle(const Point<T>& center, const Vector<T>& axis, T radius) : m_ptCenter(center), m_vecAxis(axis), m_dblRadius(radius) {};
+		Circle(const Point<T>& center, const Vector<T>& axis, T radius) : m_ptCenter(center), m_vecAxis(axis), m_dblRadius(radius) { UpdateBounds(); };
 		inline Point<T> Center() const { return m_ptCenter; }
-		inline void SetCenter(const Point<T>& center) { m_ptCenter = center; }
+		inline void SetCenter(const Point<T>& center) { m_ptCenter = center; UpdateBounds(); }
 		inline Vector<T> Axis() const { return m_vecAxis; }
-		inline void SetAxis(const Vector<T>& axis) { m_vecAxis = axis; }
+		inline void SetAxis(const Vector<T>& axis) { m_vecAxis = axis; UpdateBounds(); }
 		inline T Radius() const { return m_dblRadius; }
-		inline void SetRadius(T radius) { m_dblRadius = radius; }
+		inline void SetRadius(T radius) { m_dblRadius = radius; UpdateBounds(); }
+		inline const AABB<T>& Bounds() const { return m_boxBounds; }
+
+		//flat box in the plane of the circle
+		OBB<T> OrientedBounds() const
+		{
+			Vector<T> base1 = m_vecAxis.GetOrthogonal();
+			return OBB<T>(m_ptCenter, base1, m_vecAxis.CrossProduct(base1), m_vecAxis, m_dblRadius, m_dblRadius, 0);
+		}
 
 
 		bool Belongs(const Point<T>& pt, T epsPow2 = Epsilon::EpsPow2()) const
 		{
 			Vector<T> toPoint = pt - m_ptCenter;
-			return m_vecAxis.IsOrthogonal(toPoint, epsPow2) && Epsilon::IsZero(toPoint.Length2() - m_dblRadius * m_dblRadius));
+			return m_vecAxis.IsOrthogonal(toPoint, epsPow2) && Epsilon::IsZero(toPoint.LengthPow2() - m_dblRadius * m_dblRadius);
 		}
 
 		bool IsInCircle(const Point<T>& pt, T eps = Epsilon::Eps()) const
 		{
 			Vector<T> toPoint = pt - m_ptCenter;
-			return m_vecAxis.IsOrthogonal(toPoint) && toPoint.Length2() <= m_dblRadius * m_dblRadius + eps;
+			return m_vecAxis.IsOrthogonal(toPoint) && toPoint.LengthPow2() <= m_dblRadius * m_dblRadius + eps;
 		}
 
 		//Returns false if pt is not on circle, else assigns parameter of pt to param
@@ -49,7 +72,7 @@ namespace geomlib
 		}
 
 		//Returns false if pt is not on circle, else assigns tangent vector to tang
-		bool GetTangentIn(const Point<T>& pt, Vector<T>& tang) const
+		bool GetTangentIn(const Point<T>& pt, Vector<T>& tang, T eps = Epsilon::Eps()) const
 		{
 			if (!Belongs(pt, eps * eps))
 				return false;
@@ -72,7 +95,7 @@ namespace geomlib
 		{
 			m_ptCenter.Serialize(out);
 			m_vecAxis.Serialize(out);
-			out.write(&m_dblRadius, sizeof(T));
+			out.write((char*)&m_dblRadius, sizeof(T));
 		}
 
 		void Deserialize(std::istream& in)
@@ -80,6 +103,7 @@ namespace geomlib
 			m_ptCenter.Deserialize(in);
 			m_vecAxis.Deserialize(in);
 			in.read((char*)&m_dblRadius, sizeof(T));
+			UpdateBounds();
 		}
 
 	};
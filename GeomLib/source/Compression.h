@@ -0,0 +1,247 @@
+#pragma once
+#include "Generic.h"
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+
+namespace geomlib
+{
+	//appends values of fixed bit width to a byte buffer, little-endian bit order
+	class BitWriter
+	{
+	private:
+		std::vector<unsigned char>& m_vecOut;
+		uint64_t m_iAcc = 0;
+		int m_iBits = 0;
+	public:
+		BitWriter(std::vector<unsigned char>& out) : m_vecOut(out) {};
+		void Write(uint32_t val, int bits)
+		{
+			m_iAcc |= (uint64_t)val << m_iBits;
+			m_iBits += bits;
+			while (m_iBits >= 8)
+			{
+				m_vecOut.push_back((unsigned char)m_iAcc);
+				m_iAcc >>= 8;
+				m_iBits -= 8;
+			}
+		}
+		void Flush()
+		{
+			if (m_iBits > 0)
+				m_vecOut.push_back((unsigned char)m_iAcc);
+			m_iAcc = 0;
+			m_iBits = 0;
+		}
+	};
+
+	//reads values written by BitWriter, refills 32 bits at a time so the decode loop has no per-byte branches
+	class BitReader
+	{
+	private:
+		const unsigned char* m_pCur;
+		const unsigned char* m_pEnd;
+		uint64_t m_iAcc = 0;
+		int m_iBits = 0;
+	public:
+		BitReader(const unsigned char* begin, const unsigned char* end) : m_pCur(begin), m_pEnd(end) {};
+		uint32_t Read(int bits)
+		{
+			if (m_iBits < bits)
+			{
+				uint32_t word = 0;
+				int avail = std::min<int>(4, (int)(m_pEnd - m_pCur));
+				for (int i = 0; i < avail; i++)
+					word |= (uint32_t)m_pCur[i] << (8 * i);
+				m_pCur += avail;
+				m_iAcc |= (uint64_t)word << m_iBits;
+				m_iBits += 8 * avail;
+			}
+			uint32_t res = (uint32_t)(m_iAcc & ((bits == 32) ? 0xFFFFFFFFull : ((1ull << bits) - 1)));
+			m_iAcc >>= bits;
+			m_iBits -= bits;
+			return res;
+		}
+		//position of the first byte that was not consumed
+		const unsigned char* Position() const
+		{
+			return m_pCur - m_iBits / 8;
+		}
+	};
+
+	inline void WriteVarint(std::vector<unsigned char>& out, uint32_t val)
+	{
+		while (val >= 0x80)
+		{
+			out.push_back((unsigned char)(val | 0x80));
+			val >>= 7;
+		}
+		out.push_back((unsigned char)val);
+	}
+
+	//Returns false if the varint runs past end or does not fit 32 bits (more than 5 bytes), else assigns it to val
+	inline bool ReadVarint(const unsigned char*& p, const unsigned char* end, uint32_t& val)
+	{
+		uint32_t res = 0;
+		for (int shift = 0; shift < 35 && p < end; shift += 7)
+		{
+			unsigned char b = *p++;
+			if (shift == 28 && (b & 0x70))
+				return false;
+			res |= (uint32_t)(b & 0x7F) << shift;
+			if (b < 0x80)
+			{
+				val = res;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//octahedral mapping of a unit vector to two values in [-1, 1]
+	FLOATING(T)
+	void OctahedralEncode(const Vector<T>& vec, T& u, T& v)
+	{
+		T len = std::abs(vec.X()) + std::abs(vec.Y()) + std::abs(vec.Z());
+		if (len == 0)
+		{
+			u = v = 0;
+			return;
+		}
+		T x = vec.X() / len, y = vec.Y() / len;
+		if (vec.Z() < 0)
+		{
+			T tx = (1 - std::abs(y)) * (x >= 0 ? 1 : -1);
+			T ty = (1 - std::abs(x)) * (y >= 0 ? 1 : -1);
+			x = tx;
+			y = ty;
+		}
+		u = x;
+		v = y;
+	}
+
+	FLOATING(T)
+	Vector<T> OctahedralDecode(T u, T v)
+	{
+		T z = 1 - std::abs(u) - std::abs(v);
+		T x = u, y = v;
+		if (z < 0)
+		{
+			x = (1 - std::abs(v)) * (u >= 0 ? 1 : -1);
+			y = (1 - std::abs(u)) * (v >= 0 ? 1 : -1);
+		}
+		return Vector<T>(x, y, z).Normalize();
+	}
+
+	//reorders triangles [0, count) for a post-transform vertex cache (Forsyth's greedy scoring);
+	//local must be sized to the number of vertices and filled with -1, it is left in that state
+	template <class Tri>
+	void OptimizeVertexCache(Tri* tris, int count, std::vector<int>& local)
+	{
+		const int cacheSize = 32;
+		auto vertexScore = [](int pos, int remaining) -> double {
+			if (remaining == 0)
+				return -1;
+			double score = 0;
+			if (pos >= 0)
+				score = pos < 3 ? 0.75 : std::pow(1.0 - (double)(pos - 3) / (cacheSize - 3), 1.5);
+			return score + 2.0 / std::sqrt((double)remaining);
+		};
+
+		//triangles of every vertex, vertices are remapped to [0, used) to keep the arrays small
+		std::vector<int> verts;
+		for (int t = 0; t < count; t++)
+			for (int j = 0; j < 3; j++)
+				if (local[tris[t].ind[j]] < 0)
+				{
+					local[tris[t].ind[j]] = verts.size();
+					verts.push_back(tris[t].ind[j]);
+				}
+		int used = verts.size();
+		std::vector<int> offsets(used + 1, 0), adj(3 * count), remaining(used, 0), cachePos(used, -1);
+		for (int t = 0; t < count; t++)
+			for (int j = 0; j < 3; j++)
+				offsets[local[tris[t].ind[j]] + 1]++;
+		for (int v = 0; v < used; v++)
+			offsets[v + 1] += offsets[v];
+		std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+		for (int t = 0; t < count; t++)
+			for (int j = 0; j < 3; j++)
+				adj[cursor[local[tris[t].ind[j]]]++] = t;
+		for (int v = 0; v < used; v++)
+			remaining[v] = offsets[v + 1] - offsets[v];
+
+		std::vector<double> vScore(used), tScore(count, 0);
+		std::vector<char> emitted(count, 0);
+		for (int v = 0; v < used; v++)
+			vScore[v] = vertexScore(-1, remaining[v]);
+		for (int t = 0; t < count; t++)
+			for (int j = 0; j < 3; j++)
+				tScore[t] += vScore[local[tris[t].ind[j]]];
+
+		std::vector<Tri> order;
+		order.reserve(count);
+		std::vector<int> cache, next;
+		int scan = 0, best = -1;
+		while ((int)order.size() < count)
+		{
+			if (best < 0)
+			{
+				//nothing adjacent to the cache is left, continue with the next unused triangle
+				while (emitted[scan]) scan++;
+				best = scan;
+			}
+			emitted[best] = 1;
+			order.push_back(tris[best]);
+
+			next.clear();
+			for (int j = 0; j < 3; j++)
+			{
+				int v = local[tris[best].ind[j]];
+				next.push_back(v);
+				remaining[v]--;
+				for (int k = offsets[v]; k < offsets[v] + remaining[v] + 1; k++)
+					if (adj[k] == best)
+					{
+						std::swap(adj[k], adj[offsets[v] + remaining[v]]);
+						break;
+					}
+			}
+			for (int v : cache)
+				if (std::find(next.begin(), next.end(), v) == next.end())
+					next.push_back(v);
+			for (int i = cacheSize; i < (int)next.size(); i++)
+			{
+				cachePos[next[i]] = -1;
+				vScore[next[i]] = vertexScore(-1, remaining[next[i]]);
+			}
+			if ((int)next.size() > cacheSize)
+				next.resize(cacheSize);
+			cache.swap(next);
+
+			//rescore vertices in the cache and the triangles around them, pick the best of those triangles
+			for (int i = 0; i < (int)cache.size(); i++)
+			{
+				cachePos[cache[i]] = i;
+				vScore[cache[i]] = vertexScore(i, remaining[cache[i]]);
+			}
+			best = -1;
+			double bestScore = -1;
+			for (int v : cache)
+				for (int k = offsets[v]; k < offsets[v] + remaining[v]; k++)
+				{
+					int t = adj[k];
+					tScore[t] = vScore[local[tris[t].ind[0]]] + vScore[local[tris[t].ind[1]]] + vScore[local[tris[t].ind[2]]];
+					if (tScore[t] > bestScore)
+					{
+						bestScore = tScore[t];
+						best = t;
+					}
+				}
+		}
+		std::copy(order.begin(), order.end(), tris);
+		for (int v : verts)
+			local[v] = -1;
+	}
+}
\ No newline at end of file
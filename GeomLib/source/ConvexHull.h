@@ -0,0 +1,372 @@
+#pragma once
+#include "TessModel.h"
+#include "Epsilon.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <array>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace geomlib
+{
+	namespace hull
+	{
+		//Quickhull over a subset of points: the farthest point outside a face replaces every face it sees by a fan
+		//to the horizon, points are kept only in the outside set of the face they are farthest above. A point is
+		//outside a face when it is more than eps above its plane, so points within eps of the hull are dropped; points
+		//that became vertices before may stay on a face or an edge of the final hull.
+		FLOATING(T)
+		class Quickhull
+		{
+		public:
+			struct Face
+			{
+				int v[3];
+				//face across the edge from v[k] to v[(k + 1) % 3]
+				int adj[3];
+				Vector<T> normal;
+				T offset;
+				std::vector<int> outside;
+				bool alive;
+			};
+
+		protected:
+			std::span<const Point<T>> m_spanPoints;
+			T m_dblEps;
+			std::vector<Face> m_vecFaces;
+
+			T Dist(const Face& f, int p) const
+			{
+				return f.normal.DotProduct(m_spanPoints[p] - Point<T>(0, 0, 0)) - f.offset;
+			}
+
+			int AddFace(int a, int b, int c)
+			{
+				Face f;
+				f.v[0] = a;
+				f.v[1] = b;
+				f.v[2] = c;
+				f.adj[0] = f.adj[1] = f.adj[2] = -1;
+				f.normal = (m_spanPoints[b] - m_spanPoints[a]).CrossProduct(m_spanPoints[c] - m_spanPoints[a]);
+				if (f.normal.LengthPow2() > 0)
+					f.normal.Normalize();
+				f.offset = f.normal.DotProduct(m_spanPoints[a] - Point<T>(0, 0, 0));
+				f.alive = true;
+				m_vecFaces.push_back(std::move(f));
+				return m_vecFaces.size() - 1;
+			}
+
+			//gives p to the face it is farthest above, if any
+			void Assign(int p, const std::vector<int>& faces)
+			{
+				int best = -1;
+				T dist = m_dblEps;
+				for (int f : faces)
+				{
+					T d = Dist(m_vecFaces[f], p);
+					if (d > dist)
+					{
+						dist = d;
+						best = f;
+					}
+				}
+				if (best >= 0)
+					m_vecFaces[best].outside.push_back(p);
+			}
+
+			//whether the face f has to go when the eye is added; over its edge from a to b the eye would make the new face
+			//(a, b, eye). Next to a face the eye is nearly in plane with, that new face may have no area or lie folded back
+			//over the face, so the face goes as well.
+			bool Sees(int f, int a, int b, int eye) const
+			{
+				T d = Dist(m_vecFaces[f], eye);
+				if (d > 0 || d <= -m_dblEps)
+					return d > 0;
+				Vector<T> edge = m_spanPoints[b] - m_spanPoints[a];
+				Vector<T> norm = edge.CrossProduct(m_spanPoints[eye] - m_spanPoints[a]);
+				return norm.Length() <= m_dblEps * edge.Length() || norm.DotProduct(m_vecFaces[f].normal) < 0;
+			}
+
+			//tetrahedron of far apart points, false if all points are within eps of a plane
+			bool Simplex(const std::vector<int>& subset, std::vector<int>& faces)
+			{
+				auto coord = [this](int p, int axis) { return axis == 0 ? m_spanPoints[p].X() : (axis == 1 ? m_spanPoints[p].Y() : m_spanPoints[p].Z()); };
+				int ext[6] = { subset[0], subset[0], subset[0], subset[0], subset[0], subset[0] };
+				for (int p : subset)
+					for (int axis = 0; axis < 3; axis++)
+					{
+						if (coord(p, axis) < coord(ext[2 * axis], axis))
+							ext[2 * axis] = p;
+						if (coord(p, axis) > coord(ext[2 * axis + 1], axis))
+							ext[2 * axis + 1] = p;
+					}
+				int a = ext[0], b = ext[1];
+				for (int i = 0; i < 6; i++)
+					for (int j = i + 1; j < 6; j++)
+						if (m_spanPoints[ext[i]].Distance(m_spanPoints[ext[j]]) > m_spanPoints[a].Distance(m_spanPoints[b]))
+						{
+							a = ext[i];
+							b = ext[j];
+						}
+				if (m_spanPoints[a].Distance(m_spanPoints[b]) <= m_dblEps)
+					return false;
+				Vector<T> dir = (m_spanPoints[b] - m_spanPoints[a]).NormalizedCopy();
+				int c = a;
+				T far = 0;
+				for (int p : subset)
+				{
+					T d = (m_spanPoints[p] - m_spanPoints[a]).CrossProduct(dir).Length();
+					if (d > far)
+					{
+						far = d;
+						c = p;
+					}
+				}
+				if (far <= m_dblEps)
+					return false;
+				Vector<T> norm = (m_spanPoints[b] - m_spanPoints[a]).CrossProduct(m_spanPoints[c] - m_spanPoints[a]).Normalize();
+				int d = a;
+				far = 0;
+				for (int p : subset)
+				{
+					T h = std::abs(norm.DotProduct(m_spanPoints[p] - m_spanPoints[a]));
+					if (h > far)
+					{
+						far = h;
+						d = p;
+					}
+				}
+				if (far <= m_dblEps)
+					return false;
+				//triangles turn counterclockwise seen from outside
+				if (norm.DotProduct(m_spanPoints[d] - m_spanPoints[a]) > 0)
+					std::swap(b, c);
+				faces = { AddFace(a, b, c), AddFace(a, d, b), AddFace(b, d, c), AddFace(c, d, a) };
+				for (int f : faces)
+					for (int k = 0; k < 3; k++)
+						for (int g : faces)
+							for (int j = 0; j < 3; j++)
+								if (m_vecFaces[g].v[j] == m_vecFaces[f].v[(k + 1) % 3] && m_vecFaces[g].v[(j + 1) % 3] == m_vecFaces[f].v[k])
+									m_vecFaces[f].adj[k] = g;
+				for (int p : subset)
+					if (p != a && p != b && p != c && p != d)
+						Assign(p, faces);
+				return true;
+			}
+
+			void AddPoint(int start)
+			{
+				std::vector<int>& out = m_vecFaces[start].outside;
+				int eye = out[0];
+				for (int p : out)
+					if (Dist(m_vecFaces[start], p) > Dist(m_vecFaces[start], eye))
+						eye = p;
+
+				//faces that see the eye are connected, the edges where they meet the others form the horizon. Whether a face
+				//is seen depends on the edge it is reached over, so the horizon is known only when all are found.
+				std::vector<int> visible = { start };
+				m_vecFaces[start].alive = false;
+				for (int i = 0; i < (int)visible.size(); i++)
+					for (int k = 0; k < 3; k++)
+					{
+						int n = m_vecFaces[visible[i]].adj[k];
+						if (m_vecFaces[n].alive && Sees(n, m_vecFaces[visible[i]].v[k], m_vecFaces[visible[i]].v[(k + 1) % 3], eye))
+						{
+							m_vecFaces[n].alive = false;
+							visible.push_back(n);
+						}
+					}
+				std::vector<std::pair<int, int>> horizon;
+				for (int f : visible)
+					for (int k = 0; k < 3; k++)
+						if (m_vecFaces[m_vecFaces[f].adj[k]].alive)
+							horizon.push_back({ f, k });
+
+				std::vector<int> created;
+				for (auto& h : horizon)
+				{
+					int a = m_vecFaces[h.first].v[h.second], b = m_vecFaces[h.first].v[(h.second + 1) % 3];
+					int other = m_vecFaces[h.first].adj[h.second];
+					int nf = AddFace(a, b, eye);
+					m_vecFaces[nf].adj[0] = other;
+					for (int j = 0; j < 3; j++)
+						if (m_vecFaces[other].adj[j] == h.first)
+							m_vecFaces[other].adj[j] = nf;
+					created.push_back(nf);
+				}
+				//the new faces form a fan around the eye, neighbours share the ends of their horizon edges
+				for (int nf : created)
+					for (int g : created)
+					{
+						if (m_vecFaces[g].v[0] == m_vecFaces[nf].v[1])
+							m_vecFaces[nf].adj[1] = g;
+						if (m_vecFaces[g].v[1] == m_vecFaces[nf].v[0])
+							m_vecFaces[nf].adj[2] = g;
+					}
+
+				for (int f : visible)
+				{
+					std::vector<int> pts;
+					pts.swap(m_vecFaces[f].outside);
+					for (int p : pts)
+						if (p != eye)
+							Assign(p, created);
+				}
+			}
+
+		public:
+			Quickhull(std::span<const Point<T>> pts, T eps) : m_spanPoints(pts), m_dblEps(eps) {};
+
+			//hull of the points of subset, false if they do not span a volume
+			bool Build(const std::vector<int>& subset)
+			{
+				m_vecFaces.clear();
+				std::vector<int> faces;
+				if (subset.size() < 4 || !Simplex(subset, faces))
+					return false;
+				std::vector<int> stack = faces;
+				while (!stack.empty())
+				{
+					int f = stack.back();
+					stack.pop_back();
+					if (!m_vecFaces[f].alive || m_vecFaces[f].outside.empty())
+						continue;
+					int first = m_vecFaces.size();
+					AddPoint(f);
+					for (int nf = first; nf < (int)m_vecFaces.size(); nf++)
+						stack.push_back(nf);
+				}
+				return true;
+			}
+
+			inline const std::vector<Face>& Faces() const { return m_vecFaces; }
+
+			//points on the hull in ascending order
+			std::vector<int> Vertices() const
+			{
+				std::vector<int> res;
+				for (const Face& f : m_vecFaces)
+					if (f.alive)
+						res.insert(res.end(), f.v, f.v + 3);
+				std::sort(res.begin(), res.end());
+				res.erase(std::unique(res.begin(), res.end()), res.end());
+				return res;
+			}
+		};
+	}
+
+	//Convex hull of pts as a closed model of one surface with outward triangles, or an empty model when the points
+	//lie within eps of a plane. No point is more than eps outside the hull, some vertices may lie on its flat parts.
+	//Points inside the hull of the extremes along 26 directions are dropped first, in parallel on tp; large inputs
+	//are then cut into fixed blocks whose hulls are built in parallel, and the hull of their vertices is the result.
+	//Blocks do not depend on tp.
+	FLOATING(T)
+	TessModel<T> ConvexHull(std::type_identity_t<std::span<const Point<T>>> pts, ThreadPool* tp = nullptr, T eps = Epsilon::Eps())
+	{
+		const int block = 65536, grain = 4096;
+		int n = pts.size();
+		auto parallel = [tp](int from, int to, auto body, int grain) {
+			if (tp)
+				tp->ParallelFor(from, to, body, grain);
+			else
+				body(from, to);
+		};
+		TessModel<T> res;
+		if (n < 4)
+			return res;
+
+		std::vector<Vector<T>> dirs;
+		for (int x = -1; x <= 1; x++)
+			for (int y = -1; y <= 1; y++)
+				for (int z = -1; z <= 1; z++)
+					if (x || y || z)
+						dirs.push_back(Vector<T>(x, y, z));
+		//the first point of the largest dot product along every direction, so the extremes do not depend on tp
+		int parts = (n + grain - 1) / grain;
+		std::vector<std::array<int, 26>> best(parts);
+		parallel(0, parts, [&](int from, int to) {
+			for (int c = from; c < to; c++)
+			{
+				best[c].fill(c * grain);
+				for (int i = c * grain; i < std::min(n, (c + 1) * grain); i++)
+					for (int d = 0; d < 26; d++)
+						if (dirs[d].DotProduct(pts[i] - pts[best[c][d]]) > 0)
+							best[c][d] = i;
+			}
+		}, 1);
+		std::vector<int> extremes;
+		for (int d = 0; d < 26; d++)
+		{
+			int e = best[0][d];
+			for (int c = 1; c < parts; c++)
+				if (dirs[d].DotProduct(pts[best[c][d]] - pts[e]) > 0)
+					e = best[c][d];
+			extremes.push_back(e);
+		}
+		std::sort(extremes.begin(), extremes.end());
+		extremes.erase(std::unique(extremes.begin(), extremes.end()), extremes.end());
+
+		std::vector<int> candidates;
+		hull::Quickhull<T> filter(pts, eps);
+		if (filter.Build(extremes))
+		{
+			std::vector<char> keep(n, 0);
+			parallel(0, n, [&](int from, int to) {
+				for (int i = from; i < to; i++)
+					for (const auto& f : filter.Faces())
+						if (f.alive && f.normal.DotProduct(pts[i] - Point<T>(0, 0, 0)) - f.offset > -eps)
+						{
+							keep[i] = 1;
+							break;
+						}
+			}, grain);
+			for (int i = 0; i < n; i++)
+				if (keep[i])
+					candidates.push_back(i);
+		}
+		else
+		{
+			candidates.resize(n);
+			for (int i = 0; i < n; i++)
+				candidates[i] = i;
+		}
+
+		//a point inside the hull of a block is inside the whole hull, only block vertices go on
+		int blocks = (candidates.size() + block - 1) / block;
+		if (blocks > 1)
+		{
+			std::vector<std::vector<int>> kept(blocks);
+			parallel(0, blocks, [&](int from, int to) {
+				for (int b = from; b < to; b++)
+				{
+					std::vector<int> subset(candidates.begin() + b * block, candidates.begin() + std::min((int)candidates.size(), (b + 1) * block));
+					hull::Quickhull<T> part(pts, eps);
+					kept[b] = part.Build(subset) ? part.Vertices() : subset;
+				}
+			}, 1);
+			candidates.clear();
+			for (auto& k : kept)
+				candidates.insert(candidates.end(), k.begin(), k.end());
+		}
+
+		hull::Quickhull<T> qh(pts, eps);
+		if (!qh.Build(candidates))
+			return res;
+		std::vector<int> verts = qh.Vertices();
+		std::vector<Point<T>> hullPts(verts.size());
+		for (int i = 0; i < (int)verts.size(); i++)
+			hullPts[i] = pts[verts[i]];
+		std::vector<Triangle> tris;
+		for (const auto& f : qh.Faces())
+			if (f.alive)
+			{
+				Triangle t;
+				for (int k = 0; k < 3; k++)
+					t.ind[k] = std::lower_bound(verts.begin(), verts.end(), f.v[k]) - verts.begin();
+				tris.push_back(t);
+			}
+		res.AddSurface(hullPts, {}, tris);
+		return res;
+	}
+}
\ No newline at end of file
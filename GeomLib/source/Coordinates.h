@@ -15,14 +15,9 @@ namespace geomlib
 	protected:
 		T m_dblX, m_dblY, m_dblZ;
 	public:
-		Coordinates()
-		{
-			m_dblX = 0;
-			m_dblY = 0;
-			m_dblZ = 0;
-		};
-		Coordinates(T xx, T yy, T zz = 0) : m_dblX(xx), m_dblY(yy), m_dblZ(zz) {};
-		Coordinates(T* begin)
+		constexpr Coordinates() : m_dblX(0), m_dblY(0), m_dblZ(0) {};
+		constexpr Coordinates(T xx, T yy, T zz = 0) : m_dblX(xx), m_dblY(yy), m_dblZ(zz) {};
+		constexpr Coordinates(T* begin)
 		{
 			T* tmp = begin;
 			m_dblX = *tmp;
@@ -31,17 +26,17 @@ namespace geomlib
 			tmp = std::next(tmp);
 			m_dblZ = *tmp;
 		}
-		inline T X() const { return m_dblX; }
-		inline T Y() const { return m_dblY; }
-		inline T Z() const { return m_dblZ; }
-		inline void SetX(T xx) { m_dblX = xx; }
-		inline void SetY(T yy) { m_dblY = yy; }
-		inline void SetZ(T zz) { m_dblZ = zz; }
+		constexpr T X() const { return m_dblX; }
+		constexpr T Y() const { return m_dblY; }
+		constexpr T Z() const { return m_dblZ; }
+		constexpr void SetX(T xx) { m_dblX = xx; }
+		constexpr void SetY(T yy) { m_dblY = yy; }
+		constexpr void SetZ(T zz) { m_dblZ = zz; }
 		bool operator== (const Coordinates& rhs) const
 		{
 			return IsEqual(*this, rhs);
 		}
-		~Coordinates() {};
+		constexpr ~Coordinates() {};
 
 		virtual std::string ToString() const
 		{
@@ -0,0 +1,231 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace geomlib
+{
+	enum class Counter
+	{
+		TrianglesTested,
+		//a triangle was hit, but not closer than the best hit so far
+		HitsRejected,
+		NodesVisited,
+		//queued tasks run by a thread that waits for its own group instead of sleeping
+		TasksStolen,
+		WaitNanoseconds,
+		Cycles,
+		CacheMisses,
+		Count
+	};
+
+	//Event counts of queries, kept per thread so that counting is a plain store to memory of the counting thread.
+	//Blocks of finished threads stay registered, totals include them until Reset.
+	class Counters final
+	{
+	private:
+		struct Block
+		{
+			std::thread::id thread;
+			std::atomic<uint64_t> values[(int)Counter::Count] = {};
+		};
+		std::mutex m_mtx;
+		std::vector<std::unique_ptr<Block>> m_vecBlocks;
+		//calls, cycles and cache misses of named hardware scopes
+		std::map<std::string, std::array<uint64_t, 3>> m_mapScopes;
+
+		Block* Register()
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_vecBlocks.push_back(std::make_unique<Block>());
+			m_vecBlocks.back()->thread = std::this_thread::get_id();
+			return m_vecBlocks.back().get();
+		}
+
+		//constant initialized, so the hot path reads the pointer without the guard of a dynamic thread_local
+		static Block& Local()
+		{
+			thread_local Block* block = nullptr;
+			if (!block)
+				block = GetCounters().Register();
+			return *block;
+		}
+
+	public:
+		static Counters& GetCounters()
+		{
+			static Counters cnt;
+			return cnt;
+		}
+
+		static void Add(Counter counter, uint64_t num)
+		{
+			//only the owner writes, so no read-modify-write instruction is needed
+			std::atomic<uint64_t>& val = Local().values[(int)counter];
+			val.store(val.load(std::memory_order_relaxed) + num, std::memory_order_relaxed);
+		}
+
+		static uint64_t Total(Counter counter)
+		{
+			std::lock_guard<std::mutex> lock(GetCounters().m_mtx);
+			uint64_t res = 0;
+			for (auto& block : GetCounters().m_vecBlocks)
+				res += block->values[(int)counter].load(std::memory_order_relaxed);
+			return res;
+		}
+
+		static void AddScope(const std::string& name, uint64_t cycles, uint64_t misses)
+		{
+			std::lock_guard<std::mutex> lock(GetCounters().m_mtx);
+			std::array<uint64_t, 3>& scope = GetCounters().m_mapScopes[name];
+			scope[0]++;
+			scope[1] += cycles;
+			scope[2] += misses;
+		}
+
+		static void Reset()
+		{
+			std::lock_guard<std::mutex> lock(GetCounters().m_mtx);
+			for (auto& block : GetCounters().m_vecBlocks)
+				for (auto& val : block->values)
+					val.store(0, std::memory_order_relaxed);
+			GetCounters().m_mapScopes.clear();
+		}
+
+		static const char* Name(Counter counter)
+		{
+			static const char* names[] = { "triangles tested", "hits rejected", "nodes visited", "tasks stolen", "wait ns", "cycles", "cache misses" };
+			return names[(int)counter];
+		}
+
+		static void PrintCounters()
+		{
+			std::lock_guard<std::mutex> lock(GetCounters().m_mtx);
+			uint64_t totals[(int)Counter::Count] = {};
+			for (auto& block : GetCounters().m_vecBlocks)
+			{
+				bool any = false;
+				for (int i = 0; i < (int)Counter::Count; i++)
+				{
+					uint64_t val = block->values[i].load(std::memory_order_relaxed);
+					totals[i] += val;
+					any = any || val;
+				}
+				if (!any)
+					continue;
+				std::cout << "Counters of thread " << block->thread << ":" << std::endl;
+				for (int i = 0; i < (int)Counter::Count; i++)
+					if (block->values[i].load(std::memory_order_relaxed))
+						std::cout << "    " << Name((Counter)i) << ": " << block->values[i].load(std::memory_order_relaxed) << std::endl;
+			}
+			std::cout << "Counters of all threads:" << std::endl;
+			for (int i = 0; i < (int)Counter::Count; i++)
+				std::cout << "    " << Name((Counter)i) << ": " << totals[i] << std::endl;
+			for (auto& p : GetCounters().m_mapScopes)
+			{
+				std::cout << "Scope " << p.first << " was entered " << p.second[0] << " times." << std::endl;
+				std::cout << "    Cycles:         " << p.second[1] << std::endl;
+				std::cout << "    Cache misses:   " << p.second[2] << std::endl;
+			}
+		}
+	};
+
+	//adds the time until destruction to the wait counter of the thread
+	class WaitScope
+	{
+	public:
+		WaitScope() : m_start(std::chrono::steady_clock::now()) {}
+		~WaitScope() { Counters::Add(Counter::WaitNanoseconds, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count()); }
+
+	private:
+		std::chrono::steady_clock::time_point m_start;
+	};
+
+	//Cycles and last level cache misses of the calling thread until destruction, added to the thread counters
+	//and to the totals of the scope name. Reads perf_event_open on Linux when perf_event_paranoid allows it,
+	//counts nothing elsewhere.
+	class HardwareScope
+	{
+	public:
+		HardwareScope(const std::string& name) : m_sName(name)
+		{
+#ifdef __linux__
+			m_iCycles = Open(PERF_COUNT_HW_CPU_CYCLES);
+			m_iMisses = Open(PERF_COUNT_HW_CACHE_MISSES);
+#endif
+		}
+		HardwareScope(const HardwareScope&) = delete;
+		HardwareScope& operator= (const HardwareScope&) = delete;
+
+		~HardwareScope()
+		{
+			uint64_t cycles = Close(m_iCycles), misses = Close(m_iMisses);
+			Counters::Add(Counter::Cycles, cycles);
+			Counters::Add(Counter::CacheMisses, misses);
+			Counters::AddScope(m_sName, cycles, misses);
+		}
+
+	private:
+		std::string m_sName;
+		int m_iCycles = -1, m_iMisses = -1;
+
+#ifdef __linux__
+		static int Open(uint64_t config)
+		{
+			perf_event_attr attr = {};
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.size = sizeof(attr);
+			attr.config = config;
+			attr.disabled = 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			int fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+			if (fd >= 0)
+			{
+				ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+				ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+			}
+			return fd;
+		}
+#endif
+
+		static uint64_t Close(int fd)
+		{
+			uint64_t res = 0;
+#ifdef __linux__
+			if (fd < 0)
+				return 0;
+			ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+			if (read(fd, &res, sizeof(res)) != sizeof(res))
+				res = 0;
+			close(fd);
+#endif
+			return res;
+		}
+	};
+}
+
+//counting compiles to nothing unless GEOMLIB_COUNTERS is defined before the headers
+#ifdef GEOMLIB_COUNTERS
+#define COUNT_EVENT(counter, num) geomlib::Counters::Add(geomlib::Counter::counter, num);
+#define COUNT_WAIT_SCOPE geomlib::WaitScope _waitScope;
+#define COUNT_HARDWARE_SCOPE(name) geomlib::HardwareScope _hwScope##name (#name);
+#else
+#define COUNT_EVENT(counter, num)
+#define COUNT_WAIT_SCOPE
+#define COUNT_HARDWARE_SCOPE(name)
+#endif
\ No newline at end of file
@@ -1,6 +1,10 @@
 #pragma once
 #include "Surface.h"
 #include "Plane.h"
+#include "OBB.h"
+#include <algorithm>
+#include <limits>
+#include <span>
 #include <utility>
 
 namespace geomlib
@@ -10,23 +14,51 @@ namespace geomlib
 	protected:
 		Vector<T> m_vecDirection;
 		T m_dblRadius;
-		static std::vector<Point<T>> FindPointsOfIntersection(const Cylinder<T>& cyl, const Line<T>& lin) {
-			Point<T> tmp = cyl.ProjectionOf(lin.Start());
-			Vector<T> norm = tmp - lin.Start();
-			//check if start point of line is inside of cylinder
-			bool inside = (Line<T>(cyl.Start(), cyl.Direction()).DistanceToLine(lin.Start()) < cyl.Radius());
-			//angle between normal vector and direction of line
-			T angle = std::min(norm.Angle(lin.Direction()), acos(-1) - norm.Angle(lin.Direction()));
-			//discriminant for cos formula
-			T D = cyl.Radius() * cyl.Radius() - ((inside ? -1 : 1) * norm.Length() + cyl.Radius()) * ((inside ? -1 : 1) * norm.Length() + cyl.Radius()) * sin(angle) * sin(angle);
-			if (D < 0) return std::vector<Point<T>>();
-			D = sqrt(D);
-			T len1 = ((inside ? -1 : 1) * norm.Length() + cyl.Radius()) * cos(angle);
-			T len2 = len1 + D;
-			len1 -= D;
-			Point<T> ans1 = lin.Start() + lin.Direction().NormalizedCopy() * len1;
-			Point<T> ans2 = lin.Start() + lin.Direction().NormalizedCopy() * len2;
-			return { ans1, ans2 };
+		//unit vectors orthogonal to the axis, angle parameter is counted from base1 towards base2
+		Vector<T> m_vecBase1;
+		Vector<T> m_vecBase2;
+
+		void UpdateFrame()
+		{
+			if (m_vecDirection.LengthPow2() == 0)
+				return;
+			m_vecBase1 = m_vecDirection.GetOrthogonal();
+			m_vecBase2 = m_vecDirection.CrossProduct(m_vecBase1);
+		}
+
+		//an endless cylinder is bounded only across coordinate axes orthogonal to its own axis
+		void UpdateBounds() override
+		{
+			T inf = std::numeric_limits<T>::infinity();
+			T d[3] = { m_vecDirection.X(), m_vecDirection.Y(), m_vecDirection.Z() };
+			T s[3] = { this->m_ptStart.X(), this->m_ptStart.Y(), this->m_ptStart.Z() };
+			T mn[3], mx[3];
+			for (int i = 0; i < 3; i++)
+			{
+				mn[i] = d[i] == 0 ? s[i] - m_dblRadius : -inf;
+				mx[i] = d[i] == 0 ? s[i] + m_dblRadius : inf;
+			}
+			this->m_boxBounds = AABB<T>(Point<T>(mn[0], mn[1], mn[2]), Point<T>(mx[0], mx[1], mx[2]));
+		}
+
+		//coefficients of a * t^2 + b * t + c = 0 for points start + t * direction of lin that lie on the cylinder:
+		//parts of the direction and of the offset from the axis orthogonal to the axis give |v + t * u| = radius
+		DERIVED_FROM_LINE(S)
+		void Quadratic(const S<T>& lin, T& a, T& b, T& c) const
+		{
+			Vector<T> dir = lin.Direction();
+			Vector<T> offset = lin.Start() - this->Start();
+			Vector<T> u = dir - m_vecDirection * dir.DotProduct(m_vecDirection);
+			Vector<T> v = offset - m_vecDirection * offset.DotProduct(m_vecDirection);
+			a = u.LengthPow2();
+			b = 2 * u.DotProduct(v);
+			c = v.LengthPow2() - m_dblRadius * m_dblRadius;
+		}
+
+		//distance between the axis and lin for coefficients of Quadratic
+		T AxisDistance(T a, T b, T c) const
+		{
+			return sqrt(std::max<T>(c + m_dblRadius * m_dblRadius - b * b / (4 * a), 0));
 		}
 	public:
 		Cylinder() : Surface<T>() {};
@@ -35,12 +67,36 @@ namespace geomlib
 			this->m_ptStart = pt;
 			m_vecDirection = dir.NormalizedCopy();
 			m_dblRadius = radius;
+			UpdateFrame();
+			UpdateBounds();
 		}
 
 		inline Vector<T> Direction() const { return m_vecDirection; }
 		inline T Radius() const { return m_dblRadius; }
-		inline void SetDirection(const Vector<T>& dir) { m_vecDirection = dir; m_vecDirection.Normalize(); }
-		inline void SetRadius(T radius) { m_dblRadius = radius; }
+		inline void SetDirection(const Vector<T>& dir) { m_vecDirection = dir; m_vecDirection.Normalize(); UpdateFrame(); UpdateBounds(); }
+		inline void SetRadius(T radius) { m_dblRadius = radius; UpdateBounds(); }
+
+		using Surface<T>::Bounds;
+
+		//Tight box of the part between the axial parameters from and to (param1 of GetParameters): the box of its
+		//two end circles, each of which spans radius * sin of the angle between the axis and a coordinate axis.
+		AABB<T> Bounds(T from, T to) const
+		{
+			Point<T> a = this->Start() + m_vecDirection * from, b = this->Start() + m_vecDirection * to;
+			T d[3] = { m_vecDirection.X(), m_vecDirection.Y(), m_vecDirection.Z() };
+			T ext[3];
+			for (int i = 0; i < 3; i++)
+				ext[i] = m_dblRadius * sqrt(std::max<T>(1 - d[i] * d[i], 0));
+			Vector<T> half(ext[0], ext[1], ext[2]);
+			AABB<T> box(a - half, a + half);
+			return box.Expand(AABB<T>(b - half, b + half));
+		}
+
+		//box along the axis of the part between the axial parameters from and to
+		OBB<T> OrientedBounds(T from, T to) const
+		{
+			return OBB<T>(this->Start() + m_vecDirection * ((from + to) / 2), m_vecBase1, m_vecBase2, m_vecDirection, m_dblRadius, m_dblRadius, std::abs(to - from) / 2);
+		}
 
 		//Projects on the nearest point, returns pt if pt is on axis
 		Point<T> ProjectionOf(const Point<T>& pt) const
@@ -56,33 +112,53 @@ namespace geomlib
 		DERIVED_FROM_LINE(S)
 		bool IsTangent(const S<T>& lin, T eps = Epsilon::Eps()) const
 		{
-			//ort is orthogonal to lin & passes through start point of cylinder
-			Plane<T> ort(this->Start, lin.Direction());
-			//finding distance between the cylinder axis and the point of intersection of ort and lin
-			return (abs(Line<T>(this->Start(), Direction()).DistanceToLine(ort.FindIntersections(lin)) - Radius()) <= eps);
+			if (Direction().IsParallel(lin.Direction(), eps * eps)) return false;
+			T a, b, c;
+			Quadratic(lin, a, b, c);
+			return abs(AxisDistance(a, b, c) - Radius()) <= eps;
 		}
 
+		//parameters in res are taken along lin
 		DERIVED_FROM_LINE(S)
-		std::vector<Point<T>> FindIntersections(const S<T>& lin, T eps = Epsilon::Eps()) const
+		bool FindIntersections(const S<T>& lin, IntersectionResult<T>& res, T eps = Epsilon::Eps()) const
 		{
+			res.Clear();
 			//if cylinder axis and lin are parallel, returns 0 points
-			if (Direction().IsParallel(lin.Direction(), eps * eps)) return std::vector<Point<T>>();
+			if (Direction().IsParallel(lin.Direction(), eps * eps)) return false;
+			T a, b, c;
+			Quadratic(lin, a, b, c);
+			auto add = [&](T t) {
+				Point<T> pt = lin.Start() + t * lin.Direction();
+				if (lin.Belongs(pt)) res.Add(pt, t);
+			};
 			//if lin is tangent to cylinder, returns 1 point
-			if (IsTangent(lin)) return { FindTangentIntersection(lin, eps) };
-			//elsewise lin either don't cross cylinder or crosses in 2 points
-			auto ans = FindPointsOfIntersection(*this, Line<T>(lin.Start(), lin.Direction()));
-			std::vector<Point<T>> res;
-			for (auto p : ans) if (lin.Belongs(p)) res.push_back(p);
-			return res;
+			if (abs(AxisDistance(a, b, c) - Radius()) <= eps)
+				add(-b / (2 * a));
+			else
+			{
+				//elsewise lin either don't cross cylinder or crosses in 2 points
+				T D = b * b - 4 * a * c;
+				if (D < 0) return false;
+				D = sqrt(D);
+				add((-b - D) / (2 * a));
+				add((-b + D) / (2 * a));
+			}
+			return !res.IsEmpty();
+		}
+
+		DERIVED_FROM_LINE(S)
+		std::vector<Point<T>> FindIntersections(const S<T>& lin, T eps = Epsilon::Eps()) const
+		{
+			IntersectionResult<T> res;
+			FindIntersections(lin, res, eps);
+			return res.ToVector();
 		}
 
 		DERIVED_FROM_LINE(S)
 		std::vector<Point<T>> FindTangentIntersection(const S<T>& lin, T eps = Epsilon::Eps()) const
 		{
 			if (!IsTangent(lin, eps)) return std::vector<Point<T>>();
-			//ort is orthogonal to lin & passes through start point of cylinder
-			Plane<T> ort(this->Start, lin.Direction());	
-			return ort.FindIntersections(lin);
+			return FindIntersections(lin, eps);
 		}
 
 
@@ -91,23 +167,40 @@ namespace geomlib
 			return (abs(Line<T>(this->Start(), Direction()).DistanceToLine(pt) - Radius()) <= eps);
 		}
 
+		//param1 is the signed distance along the axis from the start point, param2 is the angle in [0, 2pi)
 		bool GetParameters(const Point<T>& pt, T& param1, T& param2, T eps = Epsilon::Eps()) const {
-			if (!Belongs(pt)) return false;
-			//vector with angle parameter = 0
-			Vector<T> zeroAngle = Direction().GetOrthogonal() * Radius();
-			//ort is orthogonal to cylinder axis & passes through pt
-			Plane<T> ort(pt, Direction());
-			Point<T> tmp = ort.ProjectionOf(this->Start());
-			param1 = tmp.Distance(this->Start()) / Direction().Length();
-			//angle with respect to direction of axis
-			param2 = zeroAngle.FullAngle(pt - tmp, Direction());
+			Vector<T> offset = pt - this->Start();
+			param1 = offset.DotProduct(m_vecDirection);
+			Vector<T> radial = offset - m_vecDirection * param1;
+			if (abs(radial.Length() - Radius()) > eps) return false;
+			param2 = atan2(radial.DotProduct(m_vecBase2), radial.DotProduct(m_vecBase1));
+			if (param2 < 0) param2 += 2 * acos(-1);
 			return true;
 		}
 
+		//parameters of many points with one frame, points off the cylinder get NaN; returns the number of points on it
+		int GetParameters(std::span<const Point<T>> pts, std::span<T> params1, std::span<T> params2, T eps = Epsilon::Eps()) const
+		{
+			int count = 0;
+			for (size_t i = 0; i < pts.size(); i++)
+			{
+				if (GetParameters(pts[i], params1[i], params2[i], eps))
+					count++;
+				else
+					params1[i] = params2[i] = std::numeric_limits<T>::quiet_NaN();
+			}
+			return count;
+		}
+
 		Point<T> GetPointByParameters(T param1, T param2) const
 		{
-			Vector<T> vec = Direction().GetOrthogonal() * Radius();
-			return this->Start() + vec.Rotate(Direction(), param2) + Direction() * param1;
+			return this->Start() + (m_vecBase1 * cos(param2) + m_vecBase2 * sin(param2)) * Radius() + m_vecDirection * param1;
+		}
+
+		void GetPointByParameters(std::span<const T> params1, std::span<const T> params2, std::span<Point<T>> pts) const
+		{
+			for (size_t i = 0; i < pts.size(); i++)
+				pts[i] = GetPointByParameters(params1[i], params2[i]);
 		}
 
 		bool GetNormalIn(const Point<T>& pt, Vector<T>& norm) const
@@ -141,6 +234,8 @@ namespace geomlib
 			this->m_ptStart.Deserialize(in);
 			m_vecDirection.Deserialize(in);
 			in.read((char*)&m_dblRadius, sizeof(T));
+			UpdateFrame();
+			UpdateBounds();
 		}
 
 	};
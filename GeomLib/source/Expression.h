@@ -0,0 +1,176 @@
+#pragma once
+#include "Generic.h"
+#include "Vector.h"
+#include "Point.h"
+#include <type_traits>
+
+namespace geomlib
+{
+	//Lazy arithmetic on coordinates. Lazy(v) starts an expression, then +, -, unary -, and * or / by a number
+	//build nodes instead of Points and Vectors. Nothing is computed until the expression is converted to a Point
+	//or a Vector, which evaluates each component of the whole tree in one pass without temporaries.
+	//Nodes refer to the Points and Vectors they start from, so an expression has to be converted within
+	//the statement that builds it and should not be stored in an auto variable.
+
+	template <class E>
+	struct IsExpression : std::false_type {};
+
+	//conversions and products shared by all nodes, E is the node type
+	template <class E, typename T>
+	class Expression
+	{
+	public:
+		using Scalar = T;
+
+		constexpr const E& Self() const { return static_cast<const E&>(*this); }
+
+		constexpr Point<T> ToPoint() const { return Point<T>(Self().X(), Self().Y(), Self().Z()); }
+		constexpr Vector<T> ToVector() const { return Vector<T>(Self().X(), Self().Y(), Self().Z()); }
+		constexpr operator Point<T>() const { return ToPoint(); }
+		constexpr operator Vector<T>() const { return ToVector(); }
+
+		template <class R, typename std::enable_if<(IsExpression<R>::value), int>::type = 0>
+		constexpr T DotProduct(const R& rhs) const
+		{
+			return Self().X() * rhs.X() + Self().Y() * rhs.Y() + Self().Z() * rhs.Z();
+		}
+
+		constexpr T DotProduct(const Coordinates<T>& rhs) const
+		{
+			return Self().X() * rhs.X() + Self().Y() * rhs.Y() + Self().Z() * rhs.Z();
+		}
+
+		constexpr T LengthPow2() const
+		{
+			return DotProduct(Self());
+		}
+	};
+
+	FLOATING(T)
+	class LeafExpression : public Expression<LeafExpression<T>, T>
+	{
+	protected:
+		const Coordinates<T>& m_coords;
+	public:
+		constexpr LeafExpression(const Coordinates<T>& coords) : m_coords(coords) {};
+		constexpr T X() const { return m_coords.X(); }
+		constexpr T Y() const { return m_coords.Y(); }
+		constexpr T Z() const { return m_coords.Z(); }
+	};
+
+	template <class L, class R>
+	class SumExpression : public Expression<SumExpression<L, R>, typename L::Scalar>
+	{
+	protected:
+		L m_lhs;
+		R m_rhs;
+	public:
+		constexpr SumExpression(const L& lhs, const R& rhs) : m_lhs(lhs), m_rhs(rhs) {};
+		constexpr typename L::Scalar X() const { return m_lhs.X() + m_rhs.X(); }
+		constexpr typename L::Scalar Y() const { return m_lhs.Y() + m_rhs.Y(); }
+		constexpr typename L::Scalar Z() const { return m_lhs.Z() + m_rhs.Z(); }
+	};
+
+	template <class L, class R>
+	class DifferenceExpression : public Expression<DifferenceExpression<L, R>, typename L::Scalar>
+	{
+	protected:
+		L m_lhs;
+		R m_rhs;
+	public:
+		constexpr DifferenceExpression(const L& lhs, const R& rhs) : m_lhs(lhs), m_rhs(rhs) {};
+		constexpr typename L::Scalar X() const { return m_lhs.X() - m_rhs.X(); }
+		constexpr typename L::Scalar Y() const { return m_lhs.Y() - m_rhs.Y(); }
+		constexpr typename L::Scalar Z() const { return m_lhs.Z() - m_rhs.Z(); }
+	};
+
+	template <class L>
+	class ScaledExpression : public Expression<ScaledExpression<L>, typename L::Scalar>
+	{
+	protected:
+		L m_lhs;
+		typename L::Scalar m_dblMul;
+	public:
+		constexpr ScaledExpression(const L& lhs, typename L::Scalar mul) : m_lhs(lhs), m_dblMul(mul) {};
+		constexpr typename L::Scalar X() const { return m_lhs.X() * m_dblMul; }
+		constexpr typename L::Scalar Y() const { return m_lhs.Y() * m_dblMul; }
+		constexpr typename L::Scalar Z() const { return m_lhs.Z() * m_dblMul; }
+	};
+
+	template <typename T> struct IsExpression<LeafExpression<T>> : std::true_type {};
+	template <class L, class R> struct IsExpression<SumExpression<L, R>> : std::true_type {};
+	template <class L, class R> struct IsExpression<DifferenceExpression<L, R>> : std::true_type {};
+	template <class L> struct IsExpression<ScaledExpression<L>> : std::true_type {};
+
+#define EXPRESSION(E) typename E, typename std::enable_if<(IsExpression<E>::value), int>::type = 0
+#define EXPRESSIONS(L, R) typename L, typename R, typename std::enable_if<(IsExpression<L>::value && IsExpression<R>::value), int>::type = 0
+
+	FLOATING(T)
+	constexpr LeafExpression<T> Lazy(const Coordinates<T>& coords)
+	{
+		return LeafExpression<T>(coords);
+	}
+
+	template <EXPRESSIONS(L, R)>
+	constexpr SumExpression<L, R> operator+ (const L& lhs, const R& rhs)
+	{
+		return SumExpression<L, R>(lhs, rhs);
+	}
+
+	template <EXPRESSION(L)>
+	constexpr SumExpression<L, LeafExpression<typename L::Scalar>> operator+ (const L& lhs, const Coordinates<typename L::Scalar>& rhs)
+	{
+		return lhs + Lazy(rhs);
+	}
+
+	template <EXPRESSION(R)>
+	constexpr SumExpression<LeafExpression<typename R::Scalar>, R> operator+ (const Coordinates<typename R::Scalar>& lhs, const R& rhs)
+	{
+		return Lazy(lhs) + rhs;
+	}
+
+	template <EXPRESSIONS(L, R)>
+	constexpr DifferenceExpression<L, R> operator- (const L& lhs, const R& rhs)
+	{
+		return DifferenceExpression<L, R>(lhs, rhs);
+	}
+
+	template <EXPRESSION(L)>
+	constexpr DifferenceExpression<L, LeafExpression<typename L::Scalar>> operator- (const L& lhs, const Coordinates<typename L::Scalar>& rhs)
+	{
+		return lhs - Lazy(rhs);
+	}
+
+	template <EXPRESSION(R)>
+	constexpr DifferenceExpression<LeafExpression<typename R::Scalar>, R> operator- (const Coordinates<typename R::Scalar>& lhs, const R& rhs)
+	{
+		return Lazy(lhs) - rhs;
+	}
+
+	template <EXPRESSION(L)>
+	constexpr ScaledExpression<L> operator- (const L& lhs)
+	{
+		return ScaledExpression<L>(lhs, -1);
+	}
+
+	template <EXPRESSION(L), typename N, typename std::enable_if<(std::is_arithmetic<N>()), int>::type = 0>
+	constexpr ScaledExpression<L> operator* (const L& lhs, N mul)
+	{
+		return ScaledExpression<L>(lhs, mul);
+	}
+
+	template <EXPRESSION(L), typename N, typename std::enable_if<(std::is_arithmetic<N>()), int>::type = 0>
+	constexpr ScaledExpression<L> operator* (N mul, const L& lhs)
+	{
+		return ScaledExpression<L>(lhs, mul);
+	}
+
+	template <EXPRESSION(L), typename N, typename std::enable_if<(std::is_arithmetic<N>()), int>::type = 0>
+	constexpr ScaledExpression<L> operator/ (const L& lhs, N div)
+	{
+		return ScaledExpression<L>(lhs, 1 / (typename L::Scalar)div);
+	}
+
+#undef EXPRESSION
+#undef EXPRESSIONS
+}
\ No newline at end of file
@@ -12,19 +12,19 @@
 namespace geomlib
 {
 	DERIVED_FROM_COORDINATES(S, T)
-	S<T> operator+ (const S<T>& lhs, const Vector<T>& rhs)
+	constexpr S<T> operator+ (const S<T>& lhs, const Vector<T>& rhs)
 	{
 		return S<T>(lhs.X() + rhs.X(), lhs.Y() + rhs.Y(), lhs.Z() + rhs.Z());
 	}
 
 	DERIVED_FROM_COORDINATES(S, T)
-	S<T> operator- (const S<T>& lhs, const Vector<T>& rhs)
+	constexpr S<T> operator- (const S<T>& lhs, const Vector<T>& rhs)
 	{
 		return S<T>(lhs.X() - rhs.X(), lhs.Y() - rhs.Y(), lhs.Z() - rhs.Z());
 	}
 
 	DERIVED_FROM_COORDINATES(S, T)
-	S<T>& operator+= (S<T>& lhs, const Vector<T>& rhs)
+	constexpr S<T>& operator+= (S<T>& lhs, const Vector<T>& rhs)
 	{
 		lhs.SetX(lhs.X() + rhs.X());
 		lhs.SetY(lhs.Y() + rhs.Y());
@@ -33,7 +33,7 @@ namespace geomlib
 	}
 
 	DERIVED_FROM_COORDINATES(S, T)
-	S<T>& operator-= (S<T>& lhs, const Vector<T>& rhs)
+	constexpr S<T>& operator-= (S<T>& lhs, const Vector<T>& rhs)
 	{
 		lhs.SetX(lhs.X() - rhs.X());
 		lhs.SetY(lhs.Y() - rhs.Y());
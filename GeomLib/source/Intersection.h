@@ -0,0 +1,62 @@
+#pragma once
+#include "Generic.h"
+#include <vector>
+
+namespace geomlib
+{
+	//Points where a line, ray or segment meets a primitive, with their parameters along it
+	//(point = start + parameter * direction). Every primitive gives at most two points,
+	//so they are stored inline and a query never allocates.
+	FLOATING(T)
+	class IntersectionResult
+	{
+	public:
+		static const int s_iCapacity = 2;
+	protected:
+		Point<T> m_ptPoints[s_iCapacity];
+		T m_dblParams[s_iCapacity] = {};
+		int m_iCount = 0;
+	public:
+		IntersectionResult() = default;
+
+		inline int Count() const { return m_iCount; }
+		inline bool IsEmpty() const { return m_iCount == 0; }
+		inline const Point<T>& PointAt(int i) const { return m_ptPoints[i]; }
+		inline T Parameter(int i) const { return m_dblParams[i]; }
+		inline const Point<T>& operator[] (int i) const { return m_ptPoints[i]; }
+		inline const Point<T>* begin() const { return m_ptPoints; }
+		inline const Point<T>* end() const { return m_ptPoints + m_iCount; }
+
+		inline void Clear() { m_iCount = 0; }
+
+		void Add(const Point<T>& pt, T param)
+		{
+			if (m_iCount < s_iCapacity)
+			{
+				m_ptPoints[m_iCount] = pt;
+				m_dblParams[m_iCount] = param;
+				m_iCount++;
+			}
+		}
+
+		//keeps only the points for which pred(point, parameter) holds
+		template <class F>
+		void Filter(F pred)
+		{
+			int kept = 0;
+			for (int i = 0; i < m_iCount; i++)
+				if (pred(m_ptPoints[i], m_dblParams[i]))
+				{
+					m_ptPoints[kept] = m_ptPoints[i];
+					m_dblParams[kept] = m_dblParams[i];
+					kept++;
+				}
+			m_iCount = kept;
+		}
+
+		std::vector<Point<T>> ToVector() const
+		{
+			return std::vector<Point<T>>(begin(), end());
+		}
+	};
+}
\ No newline at end of file
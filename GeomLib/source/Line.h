@@ -1,5 +1,8 @@
 #pragma once
+#include "Intersection.h"
 #include "Generic.h"
+#include "AABB.h"
+#include <limits>
 #include <vector>
 
 namespace geomlib
@@ -10,27 +13,92 @@ namespace geomlib
 	protected:
 		Point<T> m_ptStart;
 		Vector<T> m_vecDirection;
-		T GetParameter(const Point<T>& pt) const
+		//box of the points of this, recomputed whenever start or direction change
+		AABB<T> m_boxBounds;
+
+		//coordinates the direction does not move stay at the start, the others go to the ends of the parameter range
+		//[lo, hi] or to infinity
+		void UpdateBounds(T lo, T hi)
 		{
-			return (pt - m_ptStart).DotProduct(m_vecDirection) / m_vecDirection.LengthPow2();
-		}
-		static Point<T> FindPointOfIntersection(const Line<T>& lin1, const Line<T>& lin2) {
-			T m = (lin1.Direction().X() * (lin1.Start().Y() - lin2.Start().Y()) +
-				   lin1.Direction().Y() * (lin2.Start().X() - lin1.Start().X())) /
-				  (lin1.Direction().X() * lin2.Direction().Y() - lin2.Direction().X() * lin1.Direction().Y());
-			return Point<T>(lin2.Start() + m * lin2.Direction());
+			T inf = std::numeric_limits<T>::infinity();
+			T s[3] = { m_ptStart.X(), m_ptStart.Y(), m_ptStart.Z() };
+			T d[3] = { m_vecDirection.X(), m_vecDirection.Y(), m_vecDirection.Z() };
+			T mn[3], mx[3];
+			for (int i = 0; i < 3; i++)
+			{
+				T a = s[i], b = s[i];
+				if (d[i] != 0)
+				{
+					a = lo <= -std::numeric_limits<T>::max() ? (d[i] > 0 ? -inf : inf) : s[i] + lo * d[i];
+					b = hi >= std::numeric_limits<T>::max() ? (d[i] > 0 ? inf : -inf) : s[i] + hi * d[i];
+				}
+				mn[i] = std::min(a, b);
+				mx[i] = std::max(a, b);
+			}
+			m_boxBounds = AABB<T>(Point<T>(mn[0], mn[1], mn[2]), Point<T>(mx[0], mx[1], mx[2]));
 		}
+
+		void UpdateBounds() { UpdateBounds(MinParameter(), MaxParameter()); }
+
+		//for rays and segments, which know their range before their own MinParameter and MaxParameter are callable
+		Line(const Point<T>& pt, const Vector<T>& vec, T lo, T hi) : m_ptStart(pt), m_vecDirection(vec) { UpdateBounds(lo, hi); };
 	public:
-		Line() = default;
-		Line(const Point<T>& pt, const Vector<T>& vec) : m_ptStart(pt), m_vecDirection(vec) {};
+		Line() { UpdateBounds(-std::numeric_limits<T>::max(), std::numeric_limits<T>::max()); };
+		Line(const Point<T>& pt, const Vector<T>& vec) : m_ptStart(pt), m_vecDirection(vec) { UpdateBounds(-std::numeric_limits<T>::max(), std::numeric_limits<T>::max()); };
 		bool operator== (const Line<T>& rhs) const
 		{
 			return Start().IsEqual(rhs.Start()) && Direction().IsEqual(rhs.Direction());
 		}
 		inline Point<T> Start() const { return m_ptStart; }
 		inline Vector<T> Direction() const { return m_vecDirection; }
-		inline void SetStart(const Point<T>& pt) { m_ptStart = pt; }
-		inline void SetDirection(const Vector<T>& vec) { m_vecDirection = vec; }
+		inline void SetStart(const Point<T>& pt) { m_ptStart = pt; UpdateBounds(); }
+		inline void SetDirection(const Vector<T>& vec) { m_vecDirection = vec; UpdateBounds(); }
+		inline const AABB<T>& Bounds() const { return m_boxBounds; }
+
+		//parameter of the projection of pt, start + parameter * direction
+		T GetParameter(const Point<T>& pt) const
+		{
+			return (pt - m_ptStart).DotProduct(m_vecDirection) / m_vecDirection.LengthPow2();
+		}
+
+		//parameters of points that belong to this, ray and segment narrow the range
+		virtual T MinParameter() const { return -std::numeric_limits<T>::max(); }
+		virtual T MaxParameter() const { return std::numeric_limits<T>::max(); }
+
+		//Intersection of start1 + s * dir1, s in [lo1, hi1] and start2 + t * dir2, t in [lo2, hi2].
+		//Parameters of the closest approach are found once from dot products, the case is classified
+		//by them without transcendental functions. res gets the point of the second line with its t;
+		//overlapping collinear lines give one common point: start2 if it is on the first line, else start1.
+		static bool IntersectParametric(const Point<T>& start1, const Vector<T>& dir1, T lo1, T hi1,
+										const Point<T>& start2, const Vector<T>& dir2, T lo2, T hi2,
+										IntersectionResult<T>& res, T eps = Epsilon::Eps())
+		{
+			res.Clear();
+			Vector<T> w = start1 - start2;
+			T a = dir1.DotProduct(dir1), b = dir1.DotProduct(dir2), c = dir2.DotProduct(dir2);
+			T d = dir1.DotProduct(w), e = dir2.DotProduct(w);
+			//squared length of the cross product of directions
+			T denom = a * c - b * b;
+			T tol1 = eps / sqrt(a), tol2 = eps / sqrt(c);
+			auto inside = [](T v, T lo, T hi, T tol) { return v >= lo - tol && v <= hi + tol; };
+			if (denom <= eps * eps * a * c)
+			{
+				T s = -d / a;
+				if ((w + dir1 * s).LengthPow2() > eps * eps)
+					return false;
+				if (inside(s, lo1, hi1, tol1) && inside(0, lo2, hi2, tol2))
+					res.Add(start2, 0);
+				else if (inside(0, lo1, hi1, tol1) && inside(e / c, lo2, hi2, tol2))
+					res.Add(start1, e / c);
+				return !res.IsEmpty();
+			}
+			T s = (b * e - c * d) / denom, t = (a * e - b * d) / denom;
+			Point<T> pt = start2 + dir2 * t;
+			if ((start1 + dir1 * s - pt).LengthPow2() > eps * eps || !inside(s, lo1, hi1, tol1) || !inside(t, lo2, hi2, tol2))
+				return false;
+			res.Add(pt, t);
+			return true;
+		}
 
 		virtual Point<T> FindNearestPointToLine(const Point<T>& pt) const {
 			T param = this->GetParameter(pt);
@@ -59,8 +127,8 @@ namespace geomlib
 		bool IsCollinear(const S<T>& lin, T eps = Epsilon::Eps()) const
 		{
 			T dist = DistanceToLinePow2(lin.Start());
-			T ang = this->m_vecDirection.Angle(lin.Direction());
-			return (dist <= eps * eps && (abs(ang) <= eps || abs(ang - acos(-1)) <= eps));
+			T sinPow2 = m_vecDirection.CrossProduct(lin.Direction()).LengthPow2();
+			return dist <= eps * eps && sinPow2 <= eps * eps * m_vecDirection.LengthPow2() * lin.Direction().LengthPow2();
 		}
 
 		DERIVED_FROM_LINE(S)
@@ -78,30 +146,24 @@ namespace geomlib
 		DERIVED_FROM_LINE(S)
 		bool Intersects(const S<T>& lin, T eps = Epsilon::Eps()) const
 		{
-			Vector<T> tmp = m_ptStart - lin.Start();
-			//check if lin lies in one plane with this
-			if (abs(tmp.DotProduct(lin.Direction().CrossProduct(m_vecDirection))) <= eps)
-			{
-				if (IsCollinear(lin)) {
-					if (Belongs(lin.Start()) || lin.Belongs(m_ptStart)) return true;
-					return false;
-				}
-				Point<T> ans = FindPointOfIntersection(AsLine(), lin.AsLine());
-				return (Belongs(ans) && lin.Belongs(ans));
-			}
-			return false;
+			IntersectionResult<T> res;
+			return FindIntersections(lin, res, eps);
+		}
+
+		//parameters in res are taken along lin
+		DERIVED_FROM_LINE(S)
+		bool FindIntersections(const S<T>& lin, IntersectionResult<T>& res, T eps = Epsilon::Eps()) const
+		{
+			return IntersectParametric(m_ptStart, m_vecDirection, MinParameter(), MaxParameter(),
+									   lin.Start(), lin.Direction(), lin.MinParameter(), lin.MaxParameter(), res, eps);
 		}
 
 		DERIVED_FROM_LINE(S)
 		std::vector<Point<T>> FindIntersections(const S<T>& lin, T eps = Epsilon::Eps()) const
 		{
-			if (IsCollinear(lin)) {
-				if (Belongs(lin.Start())) return { lin.Start() };
-				else if (lin.Belongs(m_ptStart)) return { m_ptStart };
-				return std::vector<Point<T>>();
-			}
-			if (Intersects(lin)) return { FindPointOfIntersection(AsLine(), lin.AsLine()) };
-			return std::vector<Point<T>>();
+			IntersectionResult<T> res;
+			FindIntersections(lin, res, eps);
+			return res.ToVector();
 		}
 
 		bool Belongs(const Point<T>& pt) const
@@ -132,6 +194,7 @@ namespace geomlib
 		{
 			m_ptStart.Deserialize(in);
 			m_vecDirection.Deserialize(in);
+			UpdateBounds();
 		}
 	};
 }
\ No newline at end of file
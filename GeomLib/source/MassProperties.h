@@ -0,0 +1,146 @@
+#pragma once
+#include "TessModel.h"
+#include "ThreadPool.h"
+#include <array>
+#include <cmath>
+#include <type_traits>
+#include <vector>
+
+namespace geomlib
+{
+	//Neumaier summation: the rounding error of every addition is kept aside, so long sums of terms
+	//with different magnitudes lose no more than a single rounding
+	FLOATING(T)
+	class CompensatedSum
+	{
+	protected:
+		T m_dblSum = 0;
+		T m_dblError = 0;
+	public:
+		void Add(T val)
+		{
+			T sum = m_dblSum + val;
+			if (std::abs(m_dblSum) >= std::abs(val))
+				m_dblError += (m_dblSum - sum) + val;
+			else
+				m_dblError += (val - sum) + m_dblSum;
+			m_dblSum = sum;
+		}
+
+		void Add(const CompensatedSum<T>& other)
+		{
+			Add(other.m_dblSum);
+			Add(other.m_dblError);
+		}
+
+		inline T Value() const { return m_dblSum + m_dblError; }
+	};
+
+	//Area, volume, centroid and inertia tensor of triangles at unit density. Volume and inertia come from
+	//the divergence theorem, so they describe a solid only when the triangles close it with outer normals;
+	//for a part of a surface they are its share of the solid it bounds. Inertia is about the centroid.
+	FLOATING(T)
+	struct MassProperties
+	{
+		T m_dblArea = 0;
+		T m_dblVolume = 0;
+		Point<T> m_ptCentroid = Point<T>(0, 0, 0);
+		T m_dblInertia[3][3] = {};
+	};
+
+	//Mass properties of the model and of each of its surfaces in one pass over the triangles. Triangles are summed
+	//in fixed blocks with compensated sums, then blocks in their order, so the results do not depend on tp.
+	FLOATING(T)
+	void ComputeMassProperties(const TessModel<T>& model, MassProperties<T>& total, std::type_identity_t<std::vector<MassProperties<T>>*> surfaces = nullptr, ThreadPool* tp = nullptr)
+	{
+		//area, 6 * volume, first moments and second moments xx, yy, zz, xy, yz, zx of the tetrahedra to the reference
+		const int count = 11, block = 4096;
+		using Sums = std::array<CompensatedSum<T>, count>;
+		std::vector<std::pair<int, int>> ranges = model.SurfaceRanges();
+		//integrals about a point inside the model, far from origin products of coordinates would cancel
+		Point<T> ref = model.TrianglesCount() ? model.Bounds().Center() : Point<T>(0, 0, 0);
+
+		//blocks never cross surfaces, so a surface is the sum of its own blocks
+		std::vector<std::pair<int, int>> blocks;
+		std::vector<int> firstBlock;
+		for (auto& r : ranges)
+		{
+			firstBlock.push_back(blocks.size());
+			for (int i = r.first; i <= r.second; i += block)
+				blocks.push_back({ i, std::min(r.second + 1, i + block) });
+		}
+		firstBlock.push_back(blocks.size());
+
+		std::vector<Sums> partial(blocks.size());
+		auto integrate = [&](int from, int to) {
+			for (int b = from; b < to; b++)
+			{
+				Sums& sums = partial[b];
+				for (int t = blocks[b].first; t < blocks[b].second; t++)
+				{
+					const Triangle& tri = model.GetTriangle(t);
+					Vector<T> p[3] = { model.GetPoint(tri.ind[0]) - ref, model.GetPoint(tri.ind[1]) - ref, model.GetPoint(tri.ind[2]) - ref };
+					Vector<T> cross = (p[1] - p[0]).CrossProduct(p[2] - p[0]);
+					T det = p[0].DotProduct(p[1].CrossProduct(p[2]));
+					T v[3][3] = { { p[0].X(), p[0].Y(), p[0].Z() }, { p[1].X(), p[1].Y(), p[1].Z() }, { p[2].X(), p[2].Y(), p[2].Z() } };
+					T s[3] = { v[0][0] + v[1][0] + v[2][0], v[0][1] + v[1][1] + v[2][1], v[0][2] + v[1][2] + v[2][2] };
+					//sum over the vertices of a_i * a_j, the origin vertex of the tetrahedron adds nothing
+					auto prod = [&v](int i, int j) { return v[0][i] * v[0][j] + v[1][i] * v[1][j] + v[2][i] * v[2][j]; };
+					sums[0].Add(cross.Length() / 2);
+					sums[1].Add(det);
+					for (int i = 0; i < 3; i++)
+						sums[2 + i].Add(det * s[i] / 24);
+					for (int i = 0; i < 3; i++)
+						sums[5 + i].Add(det * (prod(i, i) + s[i] * s[i]) / 120);
+					for (int i = 0; i < 3; i++)
+						sums[8 + i].Add(det * (prod(i, (i + 1) % 3) + s[i] * s[(i + 1) % 3]) / 120);
+				}
+			}
+		};
+		if (tp)
+			tp->ParallelFor(0, blocks.size(), integrate);
+		else
+			integrate(0, blocks.size());
+
+		auto finish = [&ref](const Sums& sums) {
+			MassProperties<T> res;
+			res.m_dblArea = sums[0].Value();
+			res.m_dblVolume = sums[1].Value() / 6;
+			T vol = res.m_dblVolume;
+			T c[3] = { 0, 0, 0 };
+			if (vol != 0)
+				for (int i = 0; i < 3; i++)
+					c[i] = sums[2 + i].Value() / vol;
+			res.m_ptCentroid = ref + Vector<T>(c[0], c[1], c[2]);
+			//second moments moved from the reference to the centroid
+			T m[3][3];
+			for (int i = 0; i < 3; i++)
+			{
+				m[i][i] = sums[5 + i].Value() - vol * c[i] * c[i];
+				int j = (i + 1) % 3;
+				m[i][j] = m[j][i] = sums[8 + i].Value() - vol * c[i] * c[j];
+			}
+			T trace = m[0][0] + m[1][1] + m[2][2];
+			for (int i = 0; i < 3; i++)
+				for (int j = 0; j < 3; j++)
+					res.m_dblInertia[i][j] = (i == j ? trace : 0) - m[i][j];
+			return res;
+		};
+
+		Sums all;
+		if (surfaces)
+			surfaces->resize(ranges.size());
+		for (int s = 0; s < (int)ranges.size(); s++)
+		{
+			Sums surf;
+			for (int b = firstBlock[s]; b < firstBlock[s + 1]; b++)
+				for (int k = 0; k < count; k++)
+					surf[k].Add(partial[b][k]);
+			for (int k = 0; k < count; k++)
+				all[k].Add(surf[k]);
+			if (surfaces)
+				(*surfaces)[s] = finish(surf);
+		}
+		total = finish(all);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,702 @@
+#pragma once
+#include "TessModel.h"
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace geomlib
+{
+	//read-only view of a whole file, pages are loaded by the system on access
+	class MappedFile final
+	{
+	private:
+		const char* m_pData = nullptr;
+		size_t m_iSize = 0;
+		bool m_bOpen = false;
+#ifdef _WIN32
+		HANDLE m_hFile = INVALID_HANDLE_VALUE;
+		HANDLE m_hMapping = nullptr;
+#else
+		int m_iFile = -1;
+#endif
+	public:
+		MappedFile(const std::string& path)
+		{
+#ifdef _WIN32
+			m_hFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (m_hFile == INVALID_HANDLE_VALUE)
+				return;
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(m_hFile, &size))
+				return;
+			m_iSize = (size_t)size.QuadPart;
+			m_bOpen = true;
+			if (m_iSize == 0)
+				return;
+			m_hMapping = CreateFileMappingA(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (m_hMapping)
+				m_pData = (const char*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+#else
+			m_iFile = open(path.c_str(), O_RDONLY);
+			if (m_iFile < 0)
+				return;
+			struct stat st;
+			if (fstat(m_iFile, &st) != 0)
+				return;
+			m_iSize = (size_t)st.st_size;
+			m_bOpen = true;
+			if (m_iSize == 0)
+				return;
+			void* data = mmap(nullptr, m_iSize, PROT_READ, MAP_PRIVATE, m_iFile, 0);
+			if (data != MAP_FAILED)
+			{
+				madvise(data, m_iSize, MADV_SEQUENTIAL);
+				m_pData = (const char*)data;
+			}
+#endif
+			if (!m_pData)
+				m_bOpen = false;
+		}
+
+		~MappedFile()
+		{
+#ifdef _WIN32
+			if (m_pData)
+				UnmapViewOfFile(m_pData);
+			if (m_hMapping)
+				CloseHandle(m_hMapping);
+			if (m_hFile != INVALID_HANDLE_VALUE)
+				CloseHandle(m_hFile);
+#else
+			if (m_pData)
+				munmap((void*)m_pData, m_iSize);
+			if (m_iFile >= 0)
+				close(m_iFile);
+#endif
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator= (const MappedFile&) = delete;
+
+		inline bool IsOpen() const { return m_bOpen; }
+		inline const char* Data() const { return m_pData; }
+		inline size_t Size() const { return m_iSize; }
+	};
+
+	//collects output in a large buffer and passes it to the stream in big writes
+	class BufferedWriter final
+	{
+	private:
+		std::ofstream m_out;
+		std::vector<char> m_vecBuffer;
+		size_t m_iUsed = 0;
+	public:
+		BufferedWriter(const std::string& path, size_t capacity = 1 << 22) : m_out(path, std::ios::binary), m_vecBuffer(capacity) {};
+		~BufferedWriter() { Flush(); }
+
+		inline bool Good() const { return m_out.good(); }
+
+		void Write(const char* data, size_t size)
+		{
+			if (size > m_vecBuffer.size() - m_iUsed)
+				Flush();
+			if (size >= m_vecBuffer.size())
+				m_out.write(data, size);
+			else
+			{
+				memcpy(m_vecBuffer.data() + m_iUsed, data, size);
+				m_iUsed += size;
+			}
+		}
+
+		template <class V>
+		void WriteValue(const V& val)
+		{
+			Write((const char*)&val, sizeof(V));
+		}
+
+		void Flush()
+		{
+			if (m_iUsed)
+				m_out.write(m_vecBuffer.data(), m_iUsed);
+			m_iUsed = 0;
+			m_out.flush();
+		}
+	};
+
+	namespace meshio
+	{
+		//shortest representation that reads back to the same value
+		template <class N>
+		inline void AppendNumber(std::vector<char>& out, N val)
+		{
+			char tmp[32];
+			auto res = std::to_chars(tmp, tmp + sizeof(tmp), val);
+			out.insert(out.end(), tmp, res.ptr);
+		}
+
+		inline void AppendText(std::vector<char>& out, const char* text)
+		{
+			out.insert(out.end(), text, text + strlen(text));
+		}
+
+		inline void SkipSpaces(const char*& p, const char* end)
+		{
+			while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+				p++;
+		}
+
+		inline const char* LineEnd(const char* p, const char* end)
+		{
+			const char* res = (const char*)memchr(p, '\n', end - p);
+			return res ? res : end;
+		}
+
+		//token at p is compared with word and skipped if it matches
+		inline bool Keyword(const char*& p, const char* end, const char* word)
+		{
+			size_t len = strlen(word);
+			if ((size_t)(end - p) < len || memcmp(p, word, len) != 0)
+				return false;
+			if (p + len < end && !(p[len] == ' ' || p[len] == '\t' || p[len] == '\r' || p[len] == '\n'))
+				return false;
+			p += len;
+			return true;
+		}
+
+		template <class N>
+		inline bool ParseNumber(const char*& p, const char* end, N& val)
+		{
+			SkipSpaces(p, end);
+			if (p < end && *p == '+')
+				p++;
+			auto res = std::from_chars(p, end, val);
+			if (res.ec != std::errc())
+				return false;
+			p = res.ptr;
+			return true;
+		}
+
+		//splits [begin, end) into at most parts pieces of at least minSize bytes,
+		//every piece but the first starts right after the line that contains the nearest marker
+		inline std::vector<const char*> SplitText(const char* begin, const char* end, int parts, size_t minSize, const char* marker = nullptr)
+		{
+			std::vector<const char*> res = { begin };
+			size_t size = end - begin;
+			parts = (int)std::max<size_t>(1, std::min<size_t>(parts, size / std::max<size_t>(1, minSize)));
+			for (int k = 1; k < parts; k++)
+			{
+				const char* p = std::max(begin + size * k / parts, res.back());
+				if (marker)
+					p = std::search(p, end, marker, marker + strlen(marker));
+				p = LineEnd(p, end);
+				if (p < end)
+					p++;
+				res.push_back(p);
+			}
+			res.push_back(end);
+			return res;
+		}
+
+		//formats count items in blocks, blocks of one batch are formatted in parallel and written in order
+		template <class F>
+		void WriteBlocks(BufferedWriter& out, int count, ThreadPool* tp, F format)
+		{
+			const int blockSize = 1 << 14;
+			int blocks = (count + blockSize - 1) / blockSize;
+			int batch = tp ? 4 * std::max(1, tp->ThreadCount()) : 1;
+			std::vector<std::vector<char>> buffers(batch);
+			for (int first = 0; first < blocks; first += batch)
+			{
+				int last = std::min(blocks, first + batch);
+				auto body = [&](int from, int to) {
+					for (int b = from; b < to; b++)
+					{
+						std::vector<char>& buf = buffers[b - first];
+						buf.clear();
+						format(b * blockSize, std::min(count, (b + 1) * blockSize), buf);
+					}
+				};
+				if (tp)
+					tp->ParallelFor(first, last, body);
+				else
+					body(first, last);
+				for (int b = first; b < last; b++)
+					out.Write(buffers[b - first].data(), buffers[b - first].size());
+			}
+		}
+
+		FLOATING(T)
+		struct PointKey
+		{
+			T c[3];
+			bool operator== (const PointKey& rhs) const { return c[0] == rhs.c[0] && c[1] == rhs.c[1] && c[2] == rhs.c[2]; }
+		};
+
+		FLOATING(T)
+		struct PointKeyHash
+		{
+			size_t operator() (const PointKey<T>& key) const
+			{
+				std::hash<T> h;
+				return h(key.c[0]) * 73856093u ^ h(key.c[1]) * 19349663u ^ h(key.c[2]) * 83492791u;
+			}
+		};
+
+		//corners of STL facets come as separate points, equal ones are merged into one vertex
+		FLOATING(T)
+		void WeldCorners(const std::vector<PointKey<T>>& corners, std::vector<Point<T>>& pts, std::vector<Triangle>& tris)
+		{
+			std::unordered_map<PointKey<T>, int, PointKeyHash<T>> index;
+			index.reserve(corners.size() / 2);
+			pts.clear();
+			pts.reserve(corners.size() / 2);
+			tris.resize(corners.size() / 3);
+			for (size_t i = 0; i < corners.size(); i++)
+			{
+				auto res = index.emplace(corners[i], (int)pts.size());
+				if (res.second)
+					pts.push_back(Point<T>(corners[i].c[0], corners[i].c[1], corners[i].c[2]));
+				tris[i / 3].ind[i % 3] = res.first->second;
+			}
+		}
+
+		//surfaces start at the given triangles, empty ones are dropped
+		inline std::vector<int> SurfaceEnds(std::vector<int> starts, int triangles)
+		{
+			std::vector<int> res;
+			starts.push_back(triangles);
+			for (int i = 0; i + 1 < (int)starts.size(); i++)
+				if (starts[i + 1] > starts[i])
+					res.push_back(starts[i + 1] - 1);
+			return res;
+		}
+
+		//Surfaces of a model do not share vertices, TransformSurface moves every vertex of its surface. Files share
+		//them between groups and solids, so a vertex already used by an earlier surface is copied for the later one.
+		FLOATING(T)
+		void SeparateSurfaces(std::vector<Point<T>>& pts, std::vector<Vector<T>>& norms, std::vector<Triangle>& tris, const std::vector<int>& ends)
+		{
+			int count = pts.size();
+			std::vector<int> owner(count, -1), copy(count, -1), copyOwner(count, -1);
+			int first = 0;
+			for (int s = 0; s < (int)ends.size(); first = ends[s++] + 1)
+				for (int t = first; t <= ends[s]; t++)
+					for (int j = 0; j < 3; j++)
+					{
+						int& v = tris[t].ind[j];
+						if (owner[v] < 0)
+							owner[v] = s;
+						if (owner[v] == s)
+							continue;
+						if (copyOwner[v] != s)
+						{
+							copy[v] = pts.size();
+							copyOwner[v] = s;
+							Point<T> pt = pts[v];
+							pts.push_back(pt);
+							if (!norms.empty())
+							{
+								Vector<T> norm = norms[v];
+								norms.push_back(norm);
+							}
+						}
+						v = copy[v];
+					}
+		}
+
+		inline int ChunksFor(ThreadPool* tp)
+		{
+			return tp ? 4 * std::max(1, tp->ThreadCount()) : 1;
+		}
+	}
+
+	//reads binary or ASCII STL, every solid of an ASCII file becomes a surface
+	FLOATING(T)
+	bool LoadSTL(TessModel<T>& model, const std::string& path, ThreadPool* tp = nullptr)
+	{
+		using namespace meshio;
+		MappedFile file(path);
+		if (!file.IsOpen())
+			return false;
+		const char* data = file.Data();
+		size_t size = file.Size();
+		std::vector<PointKey<T>> corners;
+		std::vector<int> starts = { 0 };
+
+		uint32_t count = 0;
+		if (size >= 84)
+			memcpy(&count, data + 80, sizeof(uint32_t));
+		if (size >= 84 && size == 84 + 50 * (size_t)count)
+		{
+			corners.resize(3 * (size_t)count);
+			auto body = [&](int from, int to) {
+				for (int t = from; t < to; t++)
+				{
+					float v[9];
+					memcpy(v, data + 84 + 50 * (size_t)t + 12, sizeof(v));
+					for (int j = 0; j < 3; j++)
+						corners[3 * t + j] = { { (T)v[3 * j], (T)v[3 * j + 1], (T)v[3 * j + 2] } };
+				}
+			};
+			if (tp)
+				tp->ParallelFor(0, count, body, 1 << 14);
+			else
+				body(0, count);
+		}
+		else
+		{
+			const char* begin = data;
+			const char* end = data + size;
+			SkipSpaces(begin, end);
+			if (!Keyword(begin, end, "solid"))
+				return false;
+			begin = data;
+			std::vector<const char*> bounds = SplitText(begin, end, ChunksFor(tp), 1 << 20, "endfacet");
+			int chunks = bounds.size() - 1;
+			std::vector<std::vector<PointKey<T>>> parts(chunks);
+			std::vector<std::vector<int>> solids(chunks);
+			std::vector<char> failed(chunks, 0);
+			auto body = [&](int from, int to) {
+				for (int k = from; k < to; k++)
+				{
+					const char* p = bounds[k];
+					const char* stop = bounds[k + 1];
+					while (p < stop)
+					{
+						const char* eol = LineEnd(p, stop);
+						SkipSpaces(p, eol);
+						if (Keyword(p, eol, "vertex"))
+						{
+							PointKey<T> key;
+							if (!ParseNumber(p, eol, key.c[0]) || !ParseNumber(p, eol, key.c[1]) || !ParseNumber(p, eol, key.c[2]))
+							{
+								failed[k] = 1;
+								return;
+							}
+							parts[k].push_back(key);
+						}
+						else if (Keyword(p, eol, "solid"))
+							solids[k].push_back(parts[k].size() / 3);
+						p = eol + 1;
+					}
+				}
+			};
+			if (tp)
+				tp->ParallelFor(0, chunks, body);
+			else
+				body(0, chunks);
+			size_t total = 0;
+			for (int k = 0; k < chunks; k++)
+			{
+				if (failed[k] || parts[k].size() % 3)
+					return false;
+				total += parts[k].size();
+			}
+			corners.reserve(total);
+			for (int k = 0; k < chunks; k++)
+			{
+				for (int s : solids[k])
+					starts.push_back(corners.size() / 3 + s);
+				corners.insert(corners.end(), parts[k].begin(), parts[k].end());
+			}
+		}
+
+		std::vector<Point<T>> pts;
+		std::vector<Triangle> tris;
+		WeldCorners(corners, pts, tris);
+		std::vector<int> ends = SurfaceEnds(starts, tris.size());
+		std::vector<Vector<T>> norms;
+		SeparateSurfaces(pts, norms, tris, ends);
+		model.Assign(std::move(pts), std::move(norms), std::move(tris), std::move(ends), tp);
+		return true;
+	}
+
+	FLOATING(T)
+	bool SaveSTL(const TessModel<T>& model, const std::string& path, bool binary = true, ThreadPool* tp = nullptr)
+	{
+		using namespace meshio;
+		BufferedWriter out(path);
+		if (!out.Good())
+			return false;
+		if (binary)
+		{
+			char header[80] = "GeomLib TessModel";
+			out.Write(header, sizeof(header));
+			out.WriteValue((uint32_t)model.TrianglesCount());
+			WriteBlocks(out, model.TrianglesCount(), tp, [&model](int from, int to, std::vector<char>& buf) {
+				buf.resize(50 * (size_t)(to - from));
+				for (int i = from; i < to; i++)
+				{
+					const Triangle& t = model.GetTriangle(i);
+					const Vector<T>& n = model.NormalToTriangle(i);
+					float v[12] = { (float)n.X(), (float)n.Y(), (float)n.Z() };
+					for (int j = 0; j < 3; j++)
+					{
+						const Point<T>& p = model.GetPoint(t.ind[j]);
+						v[3 + 3 * j] = (float)p.X();
+						v[4 + 3 * j] = (float)p.Y();
+						v[5 + 3 * j] = (float)p.Z();
+					}
+					char* dst = buf.data() + 50 * (size_t)(i - from);
+					memcpy(dst, v, sizeof(v));
+					dst[48] = dst[49] = 0;
+				}
+			});
+		}
+		else
+		{
+			auto ranges = model.SurfaceRanges();
+			for (int s = 0; s < (int)ranges.size(); s++)
+			{
+				std::string name = "solid surface" + std::to_string(s) + "\n";
+				out.Write(name.data(), name.size());
+				int first = ranges[s].first;
+				WriteBlocks(out, ranges[s].second - first + 1, tp, [&model, first](int from, int to, std::vector<char>& buf) {
+					for (int i = first + from; i < first + to; i++)
+					{
+						const Vector<T>& n = model.NormalToTriangle(i);
+						AppendText(buf, "facet normal ");
+						AppendNumber(buf, n.X()); buf.push_back(' ');
+						AppendNumber(buf, n.Y()); buf.push_back(' ');
+						AppendNumber(buf, n.Z());
+						AppendText(buf, "\n outer loop\n");
+						for (int j = 0; j < 3; j++)
+						{
+							const Point<T>& p = model.GetPoint(model.GetTriangle(i).ind[j]);
+							AppendText(buf, "  vertex ");
+							AppendNumber(buf, p.X()); buf.push_back(' ');
+							AppendNumber(buf, p.Y()); buf.push_back(' ');
+							AppendNumber(buf, p.Z()); buf.push_back('\n');
+						}
+						AppendText(buf, " endloop\nendfacet\n");
+					}
+				});
+				name = "endsolid surface" + std::to_string(s) + "\n";
+				out.Write(name.data(), name.size());
+			}
+		}
+		out.Flush();
+		return out.Good();
+	}
+
+	//reads vertices, normals and faces of OBJ, polygons are split into fans, every group or object becomes a surface
+	FLOATING(T)
+	bool LoadOBJ(TessModel<T>& model, const std::string& path, ThreadPool* tp = nullptr)
+	{
+		using namespace meshio;
+		MappedFile file(path);
+		if (!file.IsOpen())
+			return false;
+		std::vector<const char*> bounds = SplitText(file.Data(), file.Data() + file.Size(), ChunksFor(tp), 1 << 20);
+		int chunks = bounds.size() - 1;
+		auto run = [tp, chunks](auto body) {
+			if (tp)
+				tp->ParallelFor(0, chunks, body);
+			else
+				body(0, chunks);
+		};
+
+		//first pass counts vertices and normals so that every chunk knows where its own ones go,
+		//lines are recognized by the same keywords as in the second pass
+		std::vector<int> vBase(chunks + 1, 0), nBase(chunks + 1, 0);
+		run([&](int from, int to) {
+			for (int k = from; k < to; k++)
+				for (const char* p = bounds[k]; p < bounds[k + 1]; p = LineEnd(p, bounds[k + 1]) + 1)
+				{
+					const char* eol = LineEnd(p, bounds[k + 1]);
+					SkipSpaces(p, eol);
+					if (Keyword(p, eol, "v"))
+						vBase[k + 1]++;
+					else if (Keyword(p, eol, "vn"))
+						nBase[k + 1]++;
+				}
+		});
+		for (int k = 0; k < chunks; k++)
+		{
+			vBase[k + 1] += vBase[k];
+			nBase[k + 1] += nBase[k];
+		}
+
+		struct Corner
+		{
+			int v, n;
+		};
+		std::vector<Point<T>> pts(vBase[chunks]);
+		std::vector<Vector<T>> fileNormals(nBase[chunks]);
+		std::vector<std::vector<Corner>> faces(chunks);
+		std::vector<std::vector<int>> groups(chunks);
+		std::vector<char> failed(chunks, 0);
+		run([&](int from, int to) {
+			for (int k = from; k < to; k++)
+			{
+				int v = vBase[k], n = nBase[k];
+				std::vector<Corner> poly;
+				const char* stop = bounds[k + 1];
+				for (const char* p = bounds[k]; p < stop; p = LineEnd(p, stop) + 1)
+				{
+					const char* eol = LineEnd(p, stop);
+					SkipSpaces(p, eol);
+					if (Keyword(p, eol, "v"))
+					{
+						T c[3];
+						if (!ParseNumber(p, eol, c[0]) || !ParseNumber(p, eol, c[1]) || !ParseNumber(p, eol, c[2]))
+							failed[k] = 1;
+						else
+							pts[v++] = Point<T>(c[0], c[1], c[2]);
+					}
+					else if (Keyword(p, eol, "vn"))
+					{
+						T c[3];
+						if (!ParseNumber(p, eol, c[0]) || !ParseNumber(p, eol, c[1]) || !ParseNumber(p, eol, c[2]))
+							failed[k] = 1;
+						else
+							fileNormals[n++] = Vector<T>(c[0], c[1], c[2]);
+					}
+					else if (Keyword(p, eol, "f"))
+					{
+						poly.clear();
+						for (SkipSpaces(p, eol); p < eol; SkipSpaces(p, eol))
+						{
+							int ids[3] = { 0, 0, 0 };
+							for (int j = 0; j < 3 && p < eol && *p != ' ' && *p != '\t' && *p != '\r'; j++)
+							{
+								if (*p != '/' && !ParseNumber(p, eol, ids[j]))
+								{
+									failed[k] = 1;
+									break;
+								}
+								if (p < eol && *p == '/')
+									p++;
+							}
+							if (failed[k])
+								break;
+							//negative indices count back from the last vertex read so far
+							Corner c = { ids[0] < 0 ? v + ids[0] : ids[0] - 1, ids[2] < 0 ? n + ids[2] : ids[2] - 1 };
+							if (c.v < 0 || c.v >= (int)pts.size() || c.n >= (int)fileNormals.size())
+								failed[k] = 1;
+							poly.push_back(c);
+						}
+						for (int j = 2; j < (int)poly.size(); j++)
+						{
+							faces[k].push_back(poly[0]);
+							faces[k].push_back(poly[j - 1]);
+							faces[k].push_back(poly[j]);
+						}
+					}
+					else if (Keyword(p, eol, "g") || Keyword(p, eol, "o"))
+						groups[k].push_back(faces[k].size() / 3);
+					if (failed[k])
+						return;
+				}
+			}
+		});
+
+		size_t total = 0;
+		for (int k = 0; k < chunks; k++)
+		{
+			if (failed[k])
+				return false;
+			total += faces[k].size() / 3;
+		}
+		std::vector<Triangle> tris(total);
+		std::vector<Vector<T>> norms;
+		if (!fileNormals.empty())
+			norms.resize(pts.size(), Vector<T>(0, 0, 0));
+		std::vector<int> starts = { 0 };
+		size_t base = 0;
+		for (int k = 0; k < chunks; k++)
+		{
+			for (int g : groups[k])
+				starts.push_back(base + g);
+			for (size_t i = 0; i < faces[k].size(); i++)
+			{
+				const Corner& c = faces[k][i];
+				tris[base + i / 3].ind[i % 3] = c.v;
+				if (c.n >= 0 && !norms.empty())
+					norms[c.v] = fileNormals[c.n];
+			}
+			base += faces[k].size() / 3;
+		}
+		std::vector<int> ends = SurfaceEnds(starts, tris.size());
+		SeparateSurfaces(pts, norms, tris, ends);
+		model.Assign(std::move(pts), std::move(norms), std::move(tris), std::move(ends), tp);
+		return true;
+	}
+
+	FLOATING(T)
+	bool SaveOBJ(const TessModel<T>& model, const std::string& path, ThreadPool* tp = nullptr)
+	{
+		using namespace meshio;
+		BufferedWriter out(path);
+		if (!out.Good())
+			return false;
+		bool normals = model.HasNormals();
+		WriteBlocks(out, model.PointsCount(), tp, [&model](int from, int to, std::vector<char>& buf) {
+			for (int i = from; i < to; i++)
+			{
+				const Point<T>& p = model.GetPoint(i);
+				AppendText(buf, "v ");
+				AppendNumber(buf, p.X()); buf.push_back(' ');
+				AppendNumber(buf, p.Y()); buf.push_back(' ');
+				AppendNumber(buf, p.Z()); buf.push_back('\n');
+			}
+		});
+		if (normals)
+			WriteBlocks(out, model.PointsCount(), tp, [&model](int from, int to, std::vector<char>& buf) {
+				for (int i = from; i < to; i++)
+				{
+					const Vector<T>& n = model.GetNormal(i);
+					AppendText(buf, "vn ");
+					AppendNumber(buf, n.X()); buf.push_back(' ');
+					AppendNumber(buf, n.Y()); buf.push_back(' ');
+					AppendNumber(buf, n.Z()); buf.push_back('\n');
+				}
+			});
+		auto ranges = model.SurfaceRanges();
+		for (int s = 0; s < (int)ranges.size(); s++)
+		{
+			std::string name = "g surface" + std::to_string(s) + "\n";
+			out.Write(name.data(), name.size());
+			int first = ranges[s].first;
+			WriteBlocks(out, ranges[s].second - first + 1, tp, [&model, first, normals](int from, int to, std::vector<char>& buf) {
+				for (int i = first + from; i < first + to; i++)
+				{
+					buf.push_back('f');
+					for (int j = 0; j < 3; j++)
+					{
+						int ind = model.GetTriangle(i).ind[j] + 1;
+						buf.push_back(' ');
+						AppendNumber(buf, ind);
+						if (normals)
+						{
+							AppendText(buf, "//");
+							AppendNumber(buf, ind);
+						}
+					}
+					buf.push_back('\n');
+				}
+			});
+		}
+		out.Flush();
+		return out.Good();
+	}
+}
\ No newline at end of file
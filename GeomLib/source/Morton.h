@@ -0,0 +1,189 @@
+#pragma once
+#include "ThreadPool.h"
+#include "AABB.h"
+#include "Ray.h"
+#include <cstdint>
+#include <numeric>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace geomlib
+{
+	//spreads the lower 10 bits of v so that two zero bits follow each of them
+	inline uint32_t MortonSpread10(uint32_t v)
+	{
+		v &= 0x3FF;
+		v = (v | (v << 16)) & 0x030000FF;
+		v = (v | (v << 8)) & 0x0300F00F;
+		v = (v | (v << 4)) & 0x030C30C3;
+		v = (v | (v << 2)) & 0x09249249;
+		return v;
+	}
+
+	//spreads the lower 21 bits of v so that two zero bits follow each of them
+	inline uint64_t MortonSpread21(uint64_t v)
+	{
+		v &= 0x1FFFFF;
+		v = (v | (v << 32)) & 0x001F00000000FFFFull;
+		v = (v | (v << 16)) & 0x001F0000FF0000FFull;
+		v = (v | (v << 8)) & 0x100F00F00F00F00Full;
+		v = (v | (v << 4)) & 0x10C30C30C30C30C3ull;
+		v = (v | (v << 2)) & 0x1249249249249249ull;
+		return v;
+	}
+
+	inline uint32_t Morton30(uint32_t x, uint32_t y, uint32_t z)
+	{
+		return (MortonSpread10(x) << 2) | (MortonSpread10(y) << 1) | MortonSpread10(z);
+	}
+
+	inline uint64_t Morton63(uint64_t x, uint64_t y, uint64_t z)
+	{
+		return (MortonSpread21(x) << 2) | (MortonSpread21(y) << 1) | MortonSpread21(z);
+	}
+
+	//position of pt inside box quantized to [0, levels - 1] along every axis
+	FLOATING(T)
+	void MortonQuantize(const Point<T>& pt, const AABB<T>& box, uint32_t levels, uint32_t res[3])
+	{
+		Vector<T> ext = box.Extent();
+		T c[3] = { pt.X() - box.Min().X(), pt.Y() - box.Min().Y(), pt.Z() - box.Min().Z() };
+		T e[3] = { ext.X(), ext.Y(), ext.Z() };
+		for (int k = 0; k < 3; k++)
+		{
+			T rel = e[k] > 0 ? c[k] / e[k] : 0;
+			res[k] = (uint32_t)std::min<T>(std::max<T>(rel * levels, 0), (T)(levels - 1));
+		}
+	}
+
+	FLOATING(T)
+	uint32_t MortonCode30(const Point<T>& pt, const AABB<T>& box)
+	{
+		uint32_t q[3];
+		MortonQuantize(pt, box, 1u << 10, q);
+		return Morton30(q[0], q[1], q[2]);
+	}
+
+	FLOATING(T)
+	uint64_t MortonCode63(const Point<T>& pt, const AABB<T>& box)
+	{
+		uint32_t q[3];
+		MortonQuantize(pt, box, 1u << 21, q);
+		return Morton63(q[0], q[1], q[2]);
+	}
+
+	//stable LSD radix sort of the lower bits of keys, values are moved along with their keys;
+	//chunks count digits and scatter in parallel, passes where all keys share the digit are skipped
+	template <class V>
+	void RadixSort(std::vector<uint64_t>& keys, std::vector<V>& values, int bits, ThreadPool* tp = nullptr)
+	{
+		const int radix = 256;
+		int n = keys.size();
+		int chunks = tp ? std::max(1, std::min(4 * std::max(1, tp->ThreadCount()), n / 65536)) : 1;
+		auto run = [tp, chunks](auto body) {
+			if (tp && chunks > 1)
+				tp->ParallelFor(0, chunks, body);
+			else
+				body(0, chunks);
+		};
+		std::vector<uint64_t> tmpKeys(n);
+		std::vector<V> tmpValues(n);
+		std::vector<int> hist(chunks * radix);
+		for (int shift = 0; shift < bits; shift += 8)
+		{
+			run([&](int from, int to) {
+				for (int c = from; c < to; c++)
+				{
+					int* h = hist.data() + c * radix;
+					std::fill(h, h + radix, 0);
+					for (int i = (long long)n * c / chunks; i < (long long)n * (c + 1) / chunks; i++)
+						h[(keys[i] >> shift) & (radix - 1)]++;
+				}
+			});
+			//digit-major prefix sums give every chunk its own slots, which keeps the sort stable
+			int sum = 0;
+			bool trivial = false;
+			for (int d = 0; d < radix; d++)
+			{
+				int start = sum;
+				for (int c = 0; c < chunks; c++)
+				{
+					int cnt = hist[c * radix + d];
+					hist[c * radix + d] = sum;
+					sum += cnt;
+				}
+				trivial = trivial || sum - start == n;
+			}
+			if (trivial)
+				continue;
+			run([&](int from, int to) {
+				for (int c = from; c < to; c++)
+				{
+					int* h = hist.data() + c * radix;
+					for (int i = (long long)n * c / chunks; i < (long long)n * (c + 1) / chunks; i++)
+					{
+						int pos = h[(keys[i] >> shift) & (radix - 1)]++;
+						tmpKeys[pos] = keys[i];
+						tmpValues[pos] = values[i];
+					}
+				}
+			});
+			keys.swap(tmpKeys);
+			values.swap(tmpValues);
+		}
+	}
+
+	//order of points along the Morton curve inside their bounding box, nearby points get nearby positions
+	FLOATING(T)
+	std::vector<int> MortonPointOrder(std::type_identity_t<std::span<const Point<T>>> pts, ThreadPool* tp = nullptr)
+	{
+		int n = pts.size();
+		AABB<T> box;
+		for (const Point<T>& pt : pts)
+			box.Expand(pt);
+		std::vector<uint64_t> keys(n);
+		std::vector<int> order(n);
+		std::iota(order.begin(), order.end(), 0);
+		auto fill = [&](int from, int to) {
+			for (int i = from; i < to; i++)
+				keys[i] = MortonCode30(pts[i], box);
+		};
+		if (tp && n > 65536)
+			tp->ParallelFor(0, n, fill, 4096);
+		else
+			fill(0, n);
+		RadixSort(keys, order, 30, tp);
+		return order;
+	}
+
+	//Processing order of a batch of rays that keeps similar rays together: rays are binned by the octant
+	//of their direction, and inside a bin sorted along the Morton curve of their starts, so that
+	//consecutive queries traverse mostly the same nodes and triangles while they are still in cache.
+	FLOATING(T)
+	std::vector<int> CoherentRayOrder(std::type_identity_t<std::span<const Ray<T>>> rays, ThreadPool* tp = nullptr)
+	{
+		int n = rays.size();
+		AABB<T> box;
+		for (const Ray<T>& ray : rays)
+			box.Expand(ray.Start());
+		std::vector<uint64_t> keys(n);
+		std::vector<int> order(n);
+		std::iota(order.begin(), order.end(), 0);
+		auto fill = [&](int from, int to) {
+			for (int i = from; i < to; i++)
+			{
+				const Vector<T>& dir = rays[i].Direction();
+				uint64_t octant = (dir.X() < 0 ? 4 : 0) | (dir.Y() < 0 ? 2 : 0) | (dir.Z() < 0 ? 1 : 0);
+				//a thousand cells per axis are enough for locality and keep the sort at five passes
+				keys[i] = (octant << 30) | MortonCode30(rays[i].Start(), box);
+			}
+		};
+		if (tp && n > 65536)
+			tp->ParallelFor(0, n, fill, 4096);
+		else
+			fill(0, n);
+		RadixSort(keys, order, 33, tp);
+		return order;
+	}
+}
\ No newline at end of file
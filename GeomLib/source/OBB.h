@@ -0,0 +1,160 @@
+#pragma once
+#include "Generic.h"
+#include "AABB.h"
+#include "Matrix.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+
+namespace geomlib
+{
+	//Box with its own orthonormal axes: the center, unit axes and half of the size along each of them
+	FLOATING(T)
+	class OBB
+	{
+	protected:
+		Point<T> m_ptCenter;
+		Vector<T> m_vecAxes[3];
+		T m_dblHalf[3];
+	public:
+		OBB() : m_ptCenter(0, 0, 0), m_vecAxes{ Vector<T>(1, 0, 0), Vector<T>(0, 1, 0), Vector<T>(0, 0, 1) }, m_dblHalf{ 0, 0, 0 } {};
+		//axes have to be orthogonal, they are normalized here
+		OBB(const Point<T>& center, const Vector<T>& axis0, const Vector<T>& axis1, const Vector<T>& axis2, T half0, T half1, T half2)
+			: m_ptCenter(center), m_vecAxes{ axis0.NormalizedCopy(), axis1.NormalizedCopy(), axis2.NormalizedCopy() }, m_dblHalf{ half0, half1, half2 } {};
+		explicit OBB(const AABB<T>& box)
+			: m_ptCenter(box.Center()), m_vecAxes{ Vector<T>(1, 0, 0), Vector<T>(0, 1, 0), Vector<T>(0, 0, 1) },
+			  m_dblHalf{ box.Extent().X() / 2, box.Extent().Y() / 2, box.Extent().Z() / 2 } {};
+
+		inline const Point<T>& Center() const { return m_ptCenter; }
+		inline const Vector<T>& Axis(int ind) const { return m_vecAxes[ind]; }
+		inline T HalfSize(int ind) const { return m_dblHalf[ind]; }
+
+		//bit k of ind chooses the side along axis k
+		Point<T> Corner(int ind) const
+		{
+			Point<T> res = m_ptCenter;
+			for (int k = 0; k < 3; k++)
+				res += m_vecAxes[k] * (ind >> k & 1 ? m_dblHalf[k] : -m_dblHalf[k]);
+			return res;
+		}
+
+		//the box moved by a rotation with translation, row vectors as in Matrix; a uniform scale goes to the size
+		OBB<T> Transformed(const Matrix<T>& mtx) const
+		{
+			OBB<T> res;
+			res.m_ptCenter = m_ptCenter * mtx;
+			for (int k = 0; k < 3; k++)
+			{
+				Vector<T> axis = m_vecAxes[k] * mtx;
+				T len = axis.Length();
+				res.m_vecAxes[k] = axis * (1 / len);
+				res.m_dblHalf[k] = m_dblHalf[k] * len;
+			}
+			return res;
+		}
+
+		//along every coordinate axis the box reaches as far as the projections of its half sizes add up
+		AABB<T> Bounds() const
+		{
+			T ext[3];
+			for (int i = 0; i < 3; i++)
+			{
+				ext[i] = 0;
+				for (int k = 0; k < 3; k++)
+				{
+					const Vector<T>& a = m_vecAxes[k];
+					ext[i] += std::abs(i == 0 ? a.X() : (i == 1 ? a.Y() : a.Z())) * m_dblHalf[k];
+				}
+			}
+			Vector<T> half(ext[0], ext[1], ext[2]);
+			return AABB<T>(m_ptCenter - half, m_ptCenter + half);
+		}
+
+		bool Contains(const Point<T>& pt, T eps = Epsilon::Eps()) const
+		{
+			Vector<T> offset = pt - m_ptCenter;
+			for (int k = 0; k < 3; k++)
+				if (std::abs(offset.DotProduct(m_vecAxes[k])) > m_dblHalf[k] + eps)
+					return false;
+			return true;
+		}
+
+		//slab test in the frame of the box for start + t * dir, t in [0, tmax]; tnear is where the ray enters
+		bool IntersectsRay(const Point<T>& start, const Vector<T>& dir, T tmax, T& tnear, T eps = Epsilon::Eps()) const
+		{
+			Vector<T> offset = start - m_ptCenter;
+			T tmin = 0, tfar = tmax;
+			for (int k = 0; k < 3; k++)
+			{
+				T pos = offset.DotProduct(m_vecAxes[k]), speed = dir.DotProduct(m_vecAxes[k]);
+				T lo = -m_dblHalf[k] - eps - pos, hi = m_dblHalf[k] + eps - pos;
+				if (speed == 0)
+				{
+					if (lo > 0 || hi < 0)
+						return false;
+					continue;
+				}
+				T t1 = lo / speed, t2 = hi / speed;
+				tmin = std::max(tmin, std::min(t1, t2));
+				tfar = std::min(tfar, std::max(t1, t2));
+			}
+			tnear = tmin;
+			return tmin <= tfar;
+		}
+
+		//Separating axis test: the boxes are apart if their projections on some axis are more than eps apart.
+		//The axes are the face normals of both boxes and the cross products of their edges; projections use
+		//cosines between the axes of the boxes, Epsilon::Eps() is added to them so that cross products of
+		//nearly parallel edges do not separate the boxes by rounding.
+		bool Intersects(const OBB<T>& box, T eps = 0) const
+		{
+			T rot[3][3], absRot[3][3];
+			for (int i = 0; i < 3; i++)
+				for (int j = 0; j < 3; j++)
+				{
+					rot[i][j] = m_vecAxes[i].DotProduct(box.m_vecAxes[j]);
+					absRot[i][j] = std::abs(rot[i][j]) + Epsilon::Eps();
+				}
+			Vector<T> offset = box.m_ptCenter - m_ptCenter;
+			T t[3] = { offset.DotProduct(m_vecAxes[0]), offset.DotProduct(m_vecAxes[1]), offset.DotProduct(m_vecAxes[2]) };
+			const T* a = m_dblHalf;
+			const T* b = box.m_dblHalf;
+
+			for (int i = 0; i < 3; i++)
+				if (std::abs(t[i]) > a[i] + b[0] * absRot[i][0] + b[1] * absRot[i][1] + b[2] * absRot[i][2] + eps)
+					return false;
+			for (int j = 0; j < 3; j++)
+				if (std::abs(t[0] * rot[0][j] + t[1] * rot[1][j] + t[2] * rot[2][j]) > a[0] * absRot[0][j] + a[1] * absRot[1][j] + a[2] * absRot[2][j] + b[j] + eps)
+					return false;
+			for (int i = 0; i < 3; i++)
+				for (int j = 0; j < 3; j++)
+				{
+					int i1 = (i + 1) % 3, i2 = (i + 2) % 3, j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+					T ra = a[i1] * absRot[i2][j] + a[i2] * absRot[i1][j];
+					T rb = b[j1] * absRot[i][j2] + b[j2] * absRot[i][j1];
+					if (std::abs(t[i2] * rot[i1][j] - t[i1] * rot[i2][j]) > ra + rb + eps)
+						return false;
+				}
+			return true;
+		}
+
+		bool Intersects(const AABB<T>& box, T eps = 0) const
+		{
+			return Intersects(OBB<T>(box), eps);
+		}
+
+		std::string ToString() const
+		{
+			std::stringstream out;
+			out << "OBB with center: ";
+			out << m_ptCenter.ToString();
+			out << "    Axes: ";
+			for (int k = 0; k < 3; k++)
+				out << m_vecAxes[k].ToString() << ' ';
+			out << "    Half sizes: ";
+			out << m_dblHalf[0] << ' ' << m_dblHalf[1] << ' ' << m_dblHalf[2];
+			return out.str();
+		}
+	};
+}
\ No newline at end of file
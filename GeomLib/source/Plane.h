@@ -1,5 +1,7 @@
 #pragma once
 #include "Surface.h"
+#include <limits>
+#include <span>
 #include <utility>
 
 namespace geomlib
@@ -8,12 +10,38 @@ namespace geomlib
 	class Plane : public Surface<T> {
 	protected:
 		Vector<T> m_vecNormal;
-		static Point<T> FindPointOfIntersection(const Plane<T>& pl, const Line<T>& lin) {
-			if (pl.Belongs(lin.Start())) return lin.Start();
-			Point<T> tmp = pl.ProjectionOf(lin.Start());
-			Vector<T> norm = tmp - lin.Start();
-			T param = norm.LengthPow2() / lin.Direction().DotProduct(norm);
-			return lin.Start() + param * lin.Direction();
+		//frame of parameters: base1 is a unit vector, base2 = normal x base1; the duals give coordinates
+		//by one dot product each, since base1, base2 and normal are orthogonal
+		Vector<T> m_vecBase1;
+		Vector<T> m_vecBase2;
+		Vector<T> m_vecDual2;
+		Vector<T> m_vecDualNormal;
+
+		void UpdateFrame()
+		{
+			if (m_vecNormal.LengthPow2() == 0)
+				return;
+			m_vecBase1 = m_vecNormal.GetOrthogonal();
+			m_vecBase2 = m_vecNormal.CrossProduct(m_vecBase1);
+			m_vecDual2 = m_vecBase2 * (1 / m_vecBase2.LengthPow2());
+			m_vecDualNormal = m_vecNormal * (1 / m_vecNormal.LengthPow2());
+		}
+
+		//only a plane with its normal along a coordinate axis has an end, the box is flat across it
+		void UpdateBounds() override
+		{
+			T inf = std::numeric_limits<T>::infinity();
+			T n[3] = { m_vecNormal.X(), m_vecNormal.Y(), m_vecNormal.Z() };
+			T s[3] = { this->m_ptStart.X(), this->m_ptStart.Y(), this->m_ptStart.Z() };
+			bool axial = (n[0] != 0) + (n[1] != 0) + (n[2] != 0) == 1;
+			T mn[3], mx[3];
+			for (int i = 0; i < 3; i++)
+			{
+				bool flat = axial && n[i] != 0;
+				mn[i] = flat ? s[i] : -inf;
+				mx[i] = flat ? s[i] : inf;
+			}
+			this->m_boxBounds = AABB<T>(Point<T>(mn[0], mn[1], mn[2]), Point<T>(mx[0], mx[1], mx[2]));
 		}
 
 	public:
@@ -22,10 +50,12 @@ namespace geomlib
 		{
 			this->m_ptStart = pt;
 			m_vecNormal = norm;
+			UpdateFrame();
+			UpdateBounds();
 		};
 
 		inline const Vector<T>& Normal() const { return m_vecNormal; }
-		inline void SetNormal(const Vector<T>& norm) { m_vecNormal = norm; }
+		inline void SetNormal(const Vector<T>& norm) { m_vecNormal = norm; UpdateFrame(); UpdateBounds(); }
 
 		Point<T> ProjectionOf(const Point<T>& pt) const 
 		{
@@ -48,14 +78,24 @@ namespace geomlib
 		}
 
 		DERIVED_FROM_LINE(S)
-		std::vector<Point<T>> FindIntersections(const S<T>& lin, T eps = Epsilon::Eps()) const
+		bool FindIntersections(const S<T>& lin, IntersectionResult<T>& res, T eps = Epsilon::Eps()) const
 		{
+			res.Clear();
 			if (Normal().IsOrthogonal(lin.Direction())) 
-				return std::vector<Point<T>>();
-			Point<T> pt = FindPointOfIntersection(*this, lin.AsLine());
+				return false;
+			T param = (this->Start() - lin.Start()).DotProduct(Normal()) / lin.Direction().DotProduct(Normal());
+			Point<T> pt = lin.Start() + param * lin.Direction();
 			if (lin.Belongs(pt)) 
-				return { pt };
-			return std::vector<Point<T>>();
+				res.Add(pt, param);
+			return !res.IsEmpty();
+		}
+
+		DERIVED_FROM_LINE(S)
+		std::vector<Point<T>> FindIntersections(const S<T>& lin, T eps = Epsilon::Eps()) const
+		{
+			IntersectionResult<T> res;
+			FindIntersections(lin, res, eps);
+			return res.ToVector();
 		}
 
 		bool Belongs(const Point<T>& pt, T eps = Epsilon::Eps()) const
@@ -64,23 +104,39 @@ namespace geomlib
 			return (abs(tmp.DotProduct(this->Normal())) <= eps);
 		}
 
+		//parameters are taken from the start point of the plane
 		bool GetParameters(const Point<T>& pt, T& param1, T& param2, T eps = Epsilon::Eps()) const {
-			Vector<T> base1 = Normal().GetOrthogonal();
-			Vector<T> base2 = Normal().CrossProduct(base1);
-			Matrix<double> tmp = Matrix<double>::ToCoordinatesInit(base1, base2, Normal());
-			Point<T> ans = pt * tmp;
-			if (abs(ans.Z()) > eps) 
+			Vector<T> offset = pt - this->Start();
+			if (abs(offset.DotProduct(m_vecDualNormal)) > eps) 
 				return false;
-			param1 = ans.X();
-			param2 = ans.Y();
+			param1 = offset.DotProduct(m_vecBase1);
+			param2 = offset.DotProduct(m_vecDual2);
 			return true;
 		}
 
+		//parameters of many points with one frame, points off the plane get NaN; returns the number of points on it
+		int GetParameters(std::span<const Point<T>> pts, std::span<T> params1, std::span<T> params2, T eps = Epsilon::Eps()) const
+		{
+			int count = 0;
+			for (size_t i = 0; i < pts.size(); i++)
+			{
+				if (GetParameters(pts[i], params1[i], params2[i], eps))
+					count++;
+				else
+					params1[i] = params2[i] = std::numeric_limits<T>::quiet_NaN();
+			}
+			return count;
+		}
+
 		Point<T> GetPointByParameters(T param1, T param2) const
 		{
-			Vector<T> base1 = Normal().GetOrthogonal();
-			Vector<T> base2 = Normal().CrossProduct(base1);
-			return this->Start() + base1 * param1 + base2 * param2;
+			return this->Start() + m_vecBase1 * param1 + m_vecBase2 * param2;
+		}
+
+		void GetPointByParameters(std::span<const T> params1, std::span<const T> params2, std::span<Point<T>> pts) const
+		{
+			for (size_t i = 0; i < pts.size(); i++)
+				pts[i] = GetPointByParameters(params1[i], params2[i]);
 		}
 
 		bool GetNormalIn(const Point<T>& pt, Vector<T>& norm) const
@@ -109,6 +165,8 @@ namespace geomlib
 		{
 			this->m_ptStart.Deserialize(in);
 			m_vecNormal.Deserialize(in);
+			UpdateFrame();
+			UpdateBounds();
 		}
 
 	};
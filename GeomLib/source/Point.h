@@ -9,9 +9,9 @@ namespace geomlib
 	class Point : public Coordinates<T>
 	{
 	public:
-		Point() : Coordinates<T>() {};
-		Point(T xx, T yy, T zz = 0) : Coordinates<T>(xx, yy, zz) {};
-		Point(T* begin) : Coordinates<T>(begin) {};
+		constexpr Point() : Coordinates<T>() {};
+		constexpr Point(T xx, T yy, T zz = 0) : Coordinates<T>(xx, yy, zz) {};
+		constexpr Point(T* begin) : Coordinates<T>(begin) {};
 		bool operator== (const Point<T>& rhs) const
 		{
 			return IsEqual(rhs);
@@ -28,11 +28,11 @@ namespace geomlib
 		{
 			return std::sqrt(DistancePow2(vec));
 		}
-		T DistancePow2(const Point<T>& vec) const
+		constexpr T DistancePow2(const Point<T>& vec) const
 		{
 			return (this->X() - vec.X()) * (this->X() - vec.X()) + (this->Y() - vec.Y()) * (this->Y() - vec.Y()) + (this->Z() - vec.Z()) * (this->Z() - vec.Z());
 		}
-		~Point() {};
+		constexpr ~Point() {};
 
 		std::string ToString() const override
 		{
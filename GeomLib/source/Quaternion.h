@@ -0,0 +1,236 @@
+#pragma once
+#include "Generic.h"
+#include "Matrix.h"
+#include "ThreadPool.h"
+#include <cmath>
+#include <span>
+#include <type_traits>
+
+namespace geomlib
+{
+	//Rotation as a quaternion w + xi + yj + zk. Rotations follow the right-hand rule around the axis,
+	//as Vector::Rotate and Matrix::RotationInit do; (a * b) rotates by b first, then by a.
+	FLOATING(T)
+	class Quaternion
+	{
+	protected:
+		T m_dblW, m_dblX, m_dblY, m_dblZ;
+	public:
+		Quaternion() : m_dblW(1), m_dblX(0), m_dblY(0), m_dblZ(0) {};
+		Quaternion(T w, T x, T y, T z) : m_dblW(w), m_dblX(x), m_dblY(y), m_dblZ(z) {};
+
+		static Quaternion<T> RotationInit(const Vector<T>& axis, T angle)
+		{
+			Vector<T> rot = axis.NormalizedCopy() * sin(angle / 2);
+			return Quaternion<T>(cos(angle / 2), rot.X(), rot.Y(), rot.Z());
+		}
+
+		//mtx has to be a rotation, translation is ignored
+		static Quaternion<T> FromMatrix(const Matrix<T>& mtx)
+		{
+			const T* m = mtx.Matr();
+			T trace = m[0 * 4 + 0] + m[1 * 4 + 1] + m[2 * 4 + 2];
+			//the largest of the four components is found first, dividing by it keeps the rest accurate
+			if (trace > 0)
+			{
+				T s = sqrt(trace + 1) * 2;
+				return Quaternion<T>(s / 4, (m[1 * 4 + 2] - m[2 * 4 + 1]) / s, (m[2 * 4 + 0] - m[0 * 4 + 2]) / s, (m[0 * 4 + 1] - m[1 * 4 + 0]) / s);
+			}
+			if (m[0 * 4 + 0] >= m[1 * 4 + 1] && m[0 * 4 + 0] >= m[2 * 4 + 2])
+			{
+				T s = sqrt(1 + m[0 * 4 + 0] - m[1 * 4 + 1] - m[2 * 4 + 2]) * 2;
+				return Quaternion<T>((m[1 * 4 + 2] - m[2 * 4 + 1]) / s, s / 4, (m[0 * 4 + 1] + m[1 * 4 + 0]) / s, (m[0 * 4 + 2] + m[2 * 4 + 0]) / s);
+			}
+			if (m[1 * 4 + 1] >= m[2 * 4 + 2])
+			{
+				T s = sqrt(1 + m[1 * 4 + 1] - m[0 * 4 + 0] - m[2 * 4 + 2]) * 2;
+				return Quaternion<T>((m[2 * 4 + 0] - m[0 * 4 + 2]) / s, (m[0 * 4 + 1] + m[1 * 4 + 0]) / s, s / 4, (m[1 * 4 + 2] + m[2 * 4 + 1]) / s);
+			}
+			T s = sqrt(1 + m[2 * 4 + 2] - m[0 * 4 + 0] - m[1 * 4 + 1]) * 2;
+			return Quaternion<T>((m[0 * 4 + 1] - m[1 * 4 + 0]) / s, (m[0 * 4 + 2] + m[2 * 4 + 0]) / s, (m[1 * 4 + 2] + m[2 * 4 + 1]) / s, s / 4);
+		}
+
+		inline T W() const { return m_dblW; }
+		inline T X() const { return m_dblX; }
+		inline T Y() const { return m_dblY; }
+		inline T Z() const { return m_dblZ; }
+
+		T Norm() const
+		{
+			return sqrt(m_dblW * m_dblW + m_dblX * m_dblX + m_dblY * m_dblY + m_dblZ * m_dblZ);
+		}
+
+		T DotProduct(const Quaternion<T>& q) const
+		{
+			return m_dblW * q.m_dblW + m_dblX * q.m_dblX + m_dblY * q.m_dblY + m_dblZ * q.m_dblZ;
+		}
+
+		Quaternion<T>& Normalize()
+		{
+			T len = Norm();
+			if (len) {
+				m_dblW /= len;
+				m_dblX /= len;
+				m_dblY /= len;
+				m_dblZ /= len;
+			}
+			return *this;
+		}
+
+		Quaternion<T> NormalizedCopy() const
+		{
+			return Quaternion<T>(*this).Normalize();
+		}
+
+		//inverse rotation for unit quaternions
+		Quaternion<T> Conjugate() const
+		{
+			return Quaternion<T>(m_dblW, -m_dblX, -m_dblY, -m_dblZ);
+		}
+
+		Quaternion<T> operator* (const Quaternion<T>& rhs) const
+		{
+			return Quaternion<T>(
+				m_dblW * rhs.m_dblW - m_dblX * rhs.m_dblX - m_dblY * rhs.m_dblY - m_dblZ * rhs.m_dblZ,
+				m_dblW * rhs.m_dblX + m_dblX * rhs.m_dblW + m_dblY * rhs.m_dblZ - m_dblZ * rhs.m_dblY,
+				m_dblW * rhs.m_dblY - m_dblX * rhs.m_dblZ + m_dblY * rhs.m_dblW + m_dblZ * rhs.m_dblX,
+				m_dblW * rhs.m_dblZ + m_dblX * rhs.m_dblY - m_dblY * rhs.m_dblX + m_dblZ * rhs.m_dblW
+				);
+		}
+
+		Quaternion<T>& operator*= (const Quaternion<T>& rhs)
+		{
+			*this = *this * rhs;
+			return *this;
+		}
+
+		//q and -q are the same rotation
+		bool IsSameRotation(const Quaternion<T>& q, T eps = Epsilon::Eps()) const
+		{
+			return abs(abs(NormalizedCopy().DotProduct(q.NormalizedCopy())) - 1) <= eps;
+		}
+
+		//rotation of vec for a unit quaternion: t = 2 * (q x vec), vec + w * t + q x t
+		Vector<T> Rotate(const Vector<T>& vec) const
+		{
+			T tx = 2 * (m_dblY * vec.Z() - m_dblZ * vec.Y());
+			T ty = 2 * (m_dblZ * vec.X() - m_dblX * vec.Z());
+			T tz = 2 * (m_dblX * vec.Y() - m_dblY * vec.X());
+			return Vector<T>(
+				vec.X() + m_dblW * tx + m_dblY * tz - m_dblZ * ty,
+				vec.Y() + m_dblW * ty + m_dblZ * tx - m_dblX * tz,
+				vec.Z() + m_dblW * tz + m_dblX * ty - m_dblY * tx
+				);
+		}
+
+		//rotation matrix for row vectors, the same as Matrix::RotationInit gives for the axis and angle
+		Matrix<T> ToMatrix() const
+		{
+			Quaternion<T> q = NormalizedCopy();
+			T xx = q.m_dblX * q.m_dblX, yy = q.m_dblY * q.m_dblY, zz = q.m_dblZ * q.m_dblZ;
+			T xy = q.m_dblX * q.m_dblY, xz = q.m_dblX * q.m_dblZ, yz = q.m_dblY * q.m_dblZ;
+			T wx = q.m_dblW * q.m_dblX, wy = q.m_dblW * q.m_dblY, wz = q.m_dblW * q.m_dblZ;
+			T data[16] = {
+				1 - 2 * (yy + zz), 2 * (xy + wz), 2 * (xz - wy), 0,
+				2 * (xy - wz), 1 - 2 * (xx + zz), 2 * (yz + wx), 0,
+				2 * (xz + wy), 2 * (yz - wx), 1 - 2 * (xx + yy), 0,
+				0, 0, 0, 1
+			};
+			return Matrix<T>(data);
+		}
+
+		//spherical interpolation along the shorter arc, t = 0 gives from and t = 1 gives to
+		static Quaternion<T> Slerp(const Quaternion<T>& from, const Quaternion<T>& to, T t)
+		{
+			Quaternion<T> end = to;
+			T cosine = from.DotProduct(to);
+			if (cosine < 0)
+			{
+				end = Quaternion<T>(-to.m_dblW, -to.m_dblX, -to.m_dblY, -to.m_dblZ);
+				cosine = -cosine;
+			}
+			T a = 1 - t, b = t;
+			//nearly equal rotations: sin of the angle vanishes, linear interpolation is as good
+			if (cosine < 1 - Epsilon::Eps())
+			{
+				T angle = acos(cosine);
+				T inv = 1 / sin(angle);
+				a = sin((1 - t) * angle) * inv;
+				b = sin(t * angle) * inv;
+			}
+			return Quaternion<T>(
+				a * from.m_dblW + b * end.m_dblW,
+				a * from.m_dblX + b * end.m_dblX,
+				a * from.m_dblY + b * end.m_dblY,
+				a * from.m_dblZ + b * end.m_dblZ
+				).Normalize();
+		}
+
+		std::string ToString() const
+		{
+			std::stringstream out;
+			out << "Quaternion (" << typeid(T).name() << ") with:" << std::endl;
+			out << "        W = " << m_dblW << std::endl;
+			out << "        X = " << m_dblX << std::endl;
+			out << "        Y = " << m_dblY << std::endl;
+			out << "        Z = " << m_dblZ << std::endl;
+			return out.str();
+		}
+
+		void Serialize(std::ostream& out) const
+		{
+			out.write((char*)&m_dblW, 4 * sizeof(T));
+		}
+
+		void Deserialize(std::istream& in)
+		{
+			in.read((char*)&m_dblW, 4 * sizeof(T));
+		}
+	};
+
+	//Rotates every vector of vecs by rot. The quaternion is expanded to a 3x3 matrix once,
+	//so every vector costs nine multiply-adds in a loop the compiler can vectorize.
+	FLOATING(T)
+	void RotateAll(std::type_identity_t<std::span<Vector<T>>> vecs, const Quaternion<T>& rot, ThreadPool* tp = nullptr)
+	{
+		Matrix<T> mtx = rot.ToMatrix();
+		const T* m = mtx.Matr();
+		T m00 = m[0], m01 = m[1], m02 = m[2], m10 = m[4], m11 = m[5], m12 = m[6], m20 = m[8], m21 = m[9], m22 = m[10];
+		auto body = [&](int from, int to) {
+			for (int i = from; i < to; i++)
+			{
+				T x = vecs[i].X(), y = vecs[i].Y(), z = vecs[i].Z();
+				vecs[i].SetX(x * m00 + y * m10 + z * m20);
+				vecs[i].SetY(x * m01 + y * m11 + z * m21);
+				vecs[i].SetZ(x * m02 + y * m12 + z * m22);
+			}
+		};
+		if (tp)
+			tp->ParallelFor(0, vecs.size(), body, 1 << 14);
+		else
+			body(0, vecs.size());
+	}
+
+	//rotates every point of pts by rot around center
+	FLOATING(T)
+	void RotateAll(std::type_identity_t<std::span<Point<T>>> pts, const Quaternion<T>& rot, const Point<T>& center, ThreadPool* tp = nullptr)
+	{
+		Matrix<T> mtx = rot.ToMatrix();
+		const T* m = mtx.Matr();
+		T m00 = m[0], m01 = m[1], m02 = m[2], m10 = m[4], m11 = m[5], m12 = m[6], m20 = m[8], m21 = m[9], m22 = m[10];
+		T cx = center.X(), cy = center.Y(), cz = center.Z();
+		auto body = [&](int from, int to) {
+			for (int i = from; i < to; i++)
+			{
+				T x = pts[i].X() - cx, y = pts[i].Y() - cy, z = pts[i].Z() - cz;
+				pts[i].SetX(cx + x * m00 + y * m10 + z * m20);
+				pts[i].SetY(cy + x * m01 + y * m11 + z * m21);
+				pts[i].SetZ(cz + x * m02 + y * m12 + z * m22);
+			}
+		};
+		if (tp)
+			tp->ParallelFor(0, pts.size(), body, 1 << 14);
+		else
+			body(0, pts.size());
+	}
+}
\ No newline at end of file
@@ -7,12 +7,14 @@ namespace geomlib
 	class Ray : public Line<T>
 	{
 	public:
-		Ray() : Line<T>() {};
-		Ray(Point<T> pt, Vector<T> vec) : Line<T>(pt, vec) {};
+		Ray() : Line<T>(Point<T>(), Vector<T>(), 0, std::numeric_limits<T>::max()) {};
+		Ray(Point<T> pt, Vector<T> vec) : Line<T>(pt, vec, 0, std::numeric_limits<T>::max()) {};
 		bool operator== (const Ray<T>& rhs) const
 		{
 			return this->Start().IsEqual(rhs.Start()) && this->Direction().IsEqual(rhs.Direction());
 		}
+		T MinParameter() const override { return 0; }
+
 		Point<T> FindNearestPointToThis(const Point<T>& pt) const override
 		{
 			T param = this->GetParameter(pt);
@@ -38,6 +40,7 @@ namespace geomlib
 		{
 			this->m_ptStart.Deserialize(in);
 			this->m_vecDirection.Deserialize(in);
+			this->UpdateBounds();
 		}
 	};
 }
\ No newline at end of file
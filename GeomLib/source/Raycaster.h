@@ -0,0 +1,196 @@
+#pragma once
+#include "TessModel.h"
+#include "Matrix.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace geomlib
+{
+	//Pinhole camera. In camera space it looks along +z with x to the right and y up, the rotation part of view
+	//maps camera directions to the model (row vectors, as everywhere in Matrix). fov is the vertical angle.
+	FLOATING(T)
+	class Camera
+	{
+	protected:
+		Point<T> m_ptOrigin;
+		Matrix<T> m_matrView;
+		T m_dblFov;
+	public:
+		Camera(const Point<T>& origin, const Matrix<T>& view, T fov) : m_ptOrigin(origin), m_matrView(view), m_dblFov(fov) {};
+
+		static Camera<T> LookAt(const Point<T>& origin, const Point<T>& target, const Vector<T>& up, T fov)
+		{
+			Vector<T> forward = (target - origin).Normalize();
+			Vector<T> right = forward.CrossProduct(up).Normalize();
+			Vector<T> camUp = right.CrossProduct(forward);
+			T data[16] = { right.X(), right.Y(), right.Z(), 0,
+						   camUp.X(), camUp.Y(), camUp.Z(), 0,
+						   forward.X(), forward.Y(), forward.Z(), 0,
+						   0, 0, 0, 1 };
+			return Camera<T>(origin, Matrix<T>(data), fov);
+		}
+
+		inline const Point<T>& Origin() const { return m_ptOrigin; }
+		inline const Matrix<T>& View() const { return m_matrView; }
+		inline T Fov() const { return m_dblFov; }
+
+		//ray through the center of pixel (x, y), row 0 is the top of the image; the direction is a unit vector
+		Ray<T> GetRay(int x, int y, int width, int height) const
+		{
+			T scale = std::tan(m_dblFov / 2) * 2 / height;
+			Vector<T> dir((x + (T)0.5 - (T)width / 2) * scale, ((T)height / 2 - y - (T)0.5) * scale, 1);
+			return Ray<T>(m_ptOrigin, (dir * m_matrView).Normalize());
+		}
+	};
+
+	//Per pixel results of a raycast, row by row from the top left corner. Misses have infinite depth,
+	//a zero normal and surface -1.
+	FLOATING(T)
+	class RaycastImage
+	{
+	public:
+		int m_iWidth = 0;
+		int m_iHeight = 0;
+		std::vector<T> m_vecDepth;
+		std::vector<Vector<T>> m_vecNormals;
+		std::vector<int> m_vecSurfaces;
+
+		void Resize(int width, int height)
+		{
+			m_iWidth = width;
+			m_iHeight = height;
+			m_vecDepth.assign(width * height, std::numeric_limits<T>::infinity());
+			m_vecNormals.assign(width * height, Vector<T>(0, 0, 0));
+			m_vecSurfaces.assign(width * height, -1);
+		}
+
+		int HitsCount() const
+		{
+			int res = 0;
+			for (int surf : m_vecSurfaces)
+				res += surf >= 0;
+			return res;
+		}
+
+		//16-bit grey, near hits are bright and misses black
+		bool SaveDepthPGM(const std::string& path) const
+		{
+			T mn = std::numeric_limits<T>::max(), mx = 0;
+			for (T d : m_vecDepth)
+				if (std::isfinite(d))
+				{
+					mn = std::min(mn, d);
+					mx = std::max(mx, d);
+				}
+			std::vector<int> vals(m_vecDepth.size(), 0);
+			for (int i = 0; i < (int)vals.size(); i++)
+				if (std::isfinite(m_vecDepth[i]))
+					vals[i] = 65535 - (int)(mx > mn ? (m_vecDepth[i] - mn) / (mx - mn) * 65534 : 0);
+			return SavePGM(path, vals);
+		}
+
+		//surface + 1 as 16-bit grey, 0 for misses
+		bool SaveSurfacesPGM(const std::string& path) const
+		{
+			std::vector<int> vals(m_vecSurfaces.size());
+			for (int i = 0; i < (int)vals.size(); i++)
+				vals[i] = std::min(m_vecSurfaces[i] + 1, 65535);
+			return SavePGM(path, vals);
+		}
+
+		//exact distances along the rays, misses stay infinite
+		bool SaveDepthPFM(const std::string& path) const
+		{
+			std::vector<float> vals(m_vecDepth.begin(), m_vecDepth.end());
+			return SavePFM(path, vals, 1);
+		}
+
+		//normals as the three color channels
+		bool SaveNormalsPFM(const std::string& path) const
+		{
+			std::vector<float> vals(3 * m_vecNormals.size());
+			for (int i = 0; i < (int)m_vecNormals.size(); i++)
+			{
+				vals[3 * i] = (float)m_vecNormals[i].X();
+				vals[3 * i + 1] = (float)m_vecNormals[i].Y();
+				vals[3 * i + 2] = (float)m_vecNormals[i].Z();
+			}
+			return SavePFM(path, vals, 3);
+		}
+
+	protected:
+		bool SavePGM(const std::string& path, const std::vector<int>& vals) const
+		{
+			std::ofstream out(path, std::ios::binary);
+			if (!out)
+				return false;
+			out << "P5\n" << m_iWidth << ' ' << m_iHeight << "\n65535\n";
+			std::vector<unsigned char> bytes(2 * vals.size());
+			for (int i = 0; i < (int)vals.size(); i++)
+			{
+				bytes[2 * i] = (unsigned char)(vals[i] >> 8);
+				bytes[2 * i + 1] = (unsigned char)(vals[i] & 0xFF);
+			}
+			out.write((const char*)bytes.data(), bytes.size());
+			return (bool)out;
+		}
+
+		//PFM stores rows from the bottom up, a negative scale marks little-endian floats
+		bool SavePFM(const std::string& path, const std::vector<float>& vals, int channels) const
+		{
+			std::ofstream out(path, std::ios::binary);
+			if (!out)
+				return false;
+			out << (channels == 3 ? "PF" : "Pf") << '\n' << m_iWidth << ' ' << m_iHeight << "\n-1.0\n";
+			for (int y = m_iHeight - 1; y >= 0; y--)
+				for (int i = channels * y * m_iWidth; i < channels * (y + 1) * m_iWidth; i++)
+				{
+					uint32_t bits;
+					std::memcpy(&bits, &vals[i], 4);
+					unsigned char le[4] = { (unsigned char)bits, (unsigned char)(bits >> 8), (unsigned char)(bits >> 16), (unsigned char)(bits >> 24) };
+					out.write((const char*)le, 4);
+				}
+			return (bool)out;
+		}
+	};
+
+	//Casts a ray through every pixel. The image is split into tile x tile squares that workers of tp take one by one,
+	//so tiles of empty background do not leave threads idle; pixels of a tile are close rays and share the nodes they visit.
+	FLOATING(T)
+	void Raycast(const TessModel<T>& model, const Camera<T>& camera, RaycastImage<T>& image, int width, int height, ThreadPool* tp = nullptr, int tile = 16)
+	{
+		image.Resize(width, height);
+		int tilesX = (width + tile - 1) / tile, tilesY = (height + tile - 1) / tile;
+		std::atomic<int> next{ 0 };
+		auto work = [&](int, int) {
+			Point<T> pt;
+			int ind;
+			for (int t = next++; t < tilesX * tilesY; t = next++)
+			{
+				int x0 = (t % tilesX) * tile, y0 = (t / tilesX) * tile;
+				for (int y = y0; y < std::min(height, y0 + tile); y++)
+					for (int x = x0; x < std::min(width, x0 + tile); x++)
+					{
+						Ray<T> ray = camera.GetRay(x, y, width, height);
+						if (!model.FindIntersection(ray, pt, ind))
+							continue;
+						int pix = y * width + x;
+						image.m_vecDepth[pix] = (pt - ray.Start()).Length();
+						image.m_vecNormals[pix] = model.NormalToTriangle(ind);
+						image.m_vecSurfaces[pix] = model.GetSurfaceByTriangle(ind);
+					}
+			}
+		};
+		if (tp)
+			tp->ParallelFor(0, std::max(1, tp->ThreadCount()), work);
+		else
+			work(0, 1);
+	}
+}
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include "Line.h"
+#include <span>
 
 namespace geomlib
 {
@@ -7,13 +8,9 @@ namespace geomlib
 	class Segment : public Line<T>
 	{
 	public:
-		Segment() : Line<T>() {};
-		Segment(Point<T> pt, Vector<T> vec) : Line<T>(pt, vec) {};
-		Segment(Point<T> pt1, Point<T> pt2)
-		{
-			this->m_ptStart = pt1;
-			this->m_vecDirection = pt2 - pt1;
-		}
+		Segment() : Line<T>(Point<T>(), Vector<T>(), 0, 1) {};
+		Segment(Point<T> pt, Vector<T> vec) : Line<T>(pt, vec, 0, 1) {};
+		Segment(Point<T> pt1, Point<T> pt2) : Line<T>(pt1, pt2 - pt1, 0, 1) {};
 		bool operator== (const Segment<T>& rhs) const
 		{
 			return this->Start().IsEqual(rhs.Start()) && this->Direction().IsEqual(rhs.Direction());
@@ -21,6 +18,9 @@ namespace geomlib
 		inline Point<T> End() {
 			return this->Start() + this->Direction();
 		}
+		T MinParameter() const override { return 0; }
+		T MaxParameter() const override { return 1; }
+
 		Point<T> FindNearestPointToThis(const Point<T>& pt) const override
 		{
 			T param = this->GetParameter(pt);
@@ -28,6 +28,28 @@ namespace geomlib
 			else if (param > 1) param = 1;
 			return this->m_ptStart + param * this->m_vecDirection;
 		}
+		//intersections of pairs a[i], b[i] go to res[i], parameters are taken along b[i];
+		//returns the number of intersecting pairs
+		static int IntersectPairs(std::span<const Segment<T>> a, std::span<const Segment<T>> b, std::span<IntersectionResult<T>> res, T eps = Epsilon::Eps())
+		{
+			int count = 0;
+			for (size_t i = 0; i < a.size(); i++)
+				count += Line<T>::IntersectParametric(a[i].m_ptStart, a[i].m_vecDirection, 0, 1, b[i].m_ptStart, b[i].m_vecDirection, 0, 1, res[i], eps);
+			return count;
+		}
+
+		//intersections of lin with every segment of segs go to res, parameters are taken along the segments
+		static int IntersectAll(const Line<T>& lin, std::span<const Segment<T>> segs, std::span<IntersectionResult<T>> res, T eps = Epsilon::Eps())
+		{
+			Point<T> start = lin.Start();
+			Vector<T> dir = lin.Direction();
+			T lo = lin.MinParameter(), hi = lin.MaxParameter();
+			int count = 0;
+			for (size_t i = 0; i < segs.size(); i++)
+				count += Line<T>::IntersectParametric(start, dir, lo, hi, segs[i].m_ptStart, segs[i].m_vecDirection, 0, 1, res[i], eps);
+			return count;
+		}
+
 		std::string ToString() const
 		{
 			std::stringstream out;
@@ -48,6 +70,7 @@ namespace geomlib
 			Point<T> end;
 			end.Deserialize(in);
 			this->m_vecDirection = end - this->m_ptStart;
+			this->UpdateBounds();
 		}
 	};
 }
\ No newline at end of file
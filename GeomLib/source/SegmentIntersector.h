@@ -0,0 +1,208 @@
+#pragma once
+#include "ThreadPool.h"
+#include "Segment.h"
+#include "AABB.h"
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <span>
+#include <vector>
+
+namespace geomlib
+{
+	//All intersecting pairs in large sets of segments. Broad phase is a uniform grid: every segment is registered
+	//in the cells its box overlaps, cells are tested independently (in parallel if a pool is given) and a pair is
+	//reported only by the cell that holds the minimum corner of the overlap of the two boxes, so it comes once.
+	//Narrow phase is Line::IntersectParametric.
+	FLOATING(T)
+	class SegmentIntersector
+	{
+	public:
+		struct Hit
+		{
+			//first < second, parameters of points are taken along the second segment
+			int first, second;
+			IntersectionResult<T> points;
+		};
+
+	protected:
+		struct Grid
+		{
+			Point<T> origin;
+			T cell = 1;
+			int dims[3] = { 1, 1, 1 };
+			//segments of cell c are refs[offsets[c], offsets[c + 1])
+			std::vector<int> offsets, refs;
+
+			int Coord(T val, T lo, int axis) const
+			{
+				int c = (int)std::floor((val - lo) / cell);
+				return std::min(std::max(c, 0), dims[axis] - 1);
+			}
+
+			void CellOf(const Point<T>& pt, int res[3]) const
+			{
+				res[0] = Coord(pt.X(), origin.X(), 0);
+				res[1] = Coord(pt.Y(), origin.Y(), 1);
+				res[2] = Coord(pt.Z(), origin.Z(), 2);
+			}
+
+			inline int Index(int x, int y, int z) const { return (z * dims[1] + y) * dims[0] + x; }
+		};
+
+		static Grid BuildGrid(const std::vector<AABB<T>>& boxes)
+		{
+			Grid grid;
+			int n = boxes.size();
+			AABB<T> all;
+			T avg = 0;
+			for (const AABB<T>& box : boxes)
+			{
+				all.Expand(box);
+				Vector<T> ext = box.Extent();
+				avg += std::max(std::max(ext.X(), ext.Y()), ext.Z());
+			}
+			avg /= std::max(1, n);
+			grid.origin = all.Min();
+
+			//cells about as large as segments, about two segments per cell on the non-degenerate axes
+			Vector<T> ext = all.Extent();
+			T e[3] = { ext.X(), ext.Y(), ext.Z() };
+			T volume = 1;
+			int axes = 0;
+			for (int k = 0; k < 3; k++)
+				if (e[k] > 0)
+				{
+					volume *= e[k];
+					axes++;
+				}
+			T cell = axes ? std::pow(volume / std::max(1, n / 2), (T)1 / axes) : 1;
+			cell = std::max(cell, avg);
+			const long long maxCells = 1 << 24;
+			long long total;
+			do
+			{
+				total = 1;
+				for (int k = 0; k < 3; k++)
+				{
+					grid.dims[k] = e[k] > 0 ? (int)std::min<T>(std::ceil(e[k] / cell), 1 << 20) : 1;
+					grid.dims[k] = std::max(grid.dims[k], 1);
+					total *= grid.dims[k];
+				}
+				if (total > maxCells)
+					cell *= 2;
+			} while (total > maxCells);
+			grid.cell = cell > 0 ? cell : 1;
+
+			//counting sort of (cell, segment) references
+			grid.offsets.assign(total + 1, 0);
+			std::vector<int> lo(3 * n), hi(3 * n);
+			for (int i = 0; i < n; i++)
+			{
+				grid.CellOf(boxes[i].Min(), &lo[3 * i]);
+				grid.CellOf(boxes[i].Max(), &hi[3 * i]);
+				for (int z = lo[3 * i + 2]; z <= hi[3 * i + 2]; z++)
+					for (int y = lo[3 * i + 1]; y <= hi[3 * i + 1]; y++)
+						for (int x = lo[3 * i]; x <= hi[3 * i]; x++)
+							grid.offsets[grid.Index(x, y, z) + 1]++;
+			}
+			for (long long c = 0; c < total; c++)
+				grid.offsets[c + 1] += grid.offsets[c];
+			grid.refs.resize(grid.offsets[total]);
+			std::vector<int> cursor(grid.offsets.begin(), grid.offsets.end() - 1);
+			for (int i = 0; i < n; i++)
+				for (int z = lo[3 * i + 2]; z <= hi[3 * i + 2]; z++)
+					for (int y = lo[3 * i + 1]; y <= hi[3 * i + 1]; y++)
+						for (int x = lo[3 * i]; x <= hi[3 * i]; x++)
+							grid.refs[cursor[grid.Index(x, y, z)]++] = i;
+			return grid;
+		}
+
+		static bool Overlap(const AABB<T>& a, const AABB<T>& b)
+		{
+			return a.Min().X() <= b.Max().X() && b.Min().X() <= a.Max().X() &&
+				   a.Min().Y() <= b.Max().Y() && b.Min().Y() <= a.Max().Y() &&
+				   a.Min().Z() <= b.Max().Z() && b.Min().Z() <= a.Max().Z();
+		}
+
+		//accept(i, j) filters pairs before the narrow phase
+		template <class F>
+		static std::vector<Hit> Run(std::span<const Segment<T>> segs, ThreadPool* tp, T eps, F accept)
+		{
+			int n = segs.size();
+			std::vector<AABB<T>> boxes(n);
+			Vector<T> pad(eps, eps, eps);
+			for (int i = 0; i < n; i++)
+			{
+				AABB<T> box;
+				box.Expand(segs[i].Start());
+				box.Expand(segs[i].Start() + segs[i].Direction());
+				boxes[i] = AABB<T>(box.Min() - pad, box.Max() + pad);
+			}
+			Grid grid = BuildGrid(boxes);
+			std::vector<int> cells;
+			for (int c = 0; c + 1 < (int)grid.offsets.size(); c++)
+				if (grid.offsets[c + 1] - grid.offsets[c] > 1)
+					cells.push_back(c);
+
+			std::vector<Hit> res;
+			std::mutex mtx;
+			auto body = [&](int from, int to) {
+				std::vector<Hit> local;
+				Hit hit;
+				for (int k = from; k < to; k++)
+				{
+					int c = cells[k];
+					for (int p = grid.offsets[c]; p < grid.offsets[c + 1]; p++)
+						for (int q = p + 1; q < grid.offsets[c + 1]; q++)
+						{
+							int i = std::min(grid.refs[p], grid.refs[q]), j = std::max(grid.refs[p], grid.refs[q]);
+							if (!Overlap(boxes[i], boxes[j]) || !accept(i, j))
+								continue;
+							//the pair belongs to the cell of the minimum corner of the overlap
+							Point<T> corner(std::max(boxes[i].Min().X(), boxes[j].Min().X()),
+											std::max(boxes[i].Min().Y(), boxes[j].Min().Y()),
+											std::max(boxes[i].Min().Z(), boxes[j].Min().Z()));
+							int cc[3];
+							grid.CellOf(corner, cc);
+							if (grid.Index(cc[0], cc[1], cc[2]) != c)
+								continue;
+							if (Line<T>::IntersectParametric(segs[i].Start(), segs[i].Direction(), 0, 1, segs[j].Start(), segs[j].Direction(), 0, 1, hit.points, eps))
+							{
+								hit.first = i;
+								hit.second = j;
+								local.push_back(hit);
+							}
+						}
+				}
+				std::lock_guard<std::mutex> lock(mtx);
+				res.insert(res.end(), local.begin(), local.end());
+			};
+			if (tp)
+				tp->ParallelFor(0, cells.size(), body, 64);
+			else
+				body(0, cells.size());
+			std::sort(res.begin(), res.end(), [](const Hit& a, const Hit& b) { return a.first < b.first || (a.first == b.first && a.second < b.second); });
+			return res;
+		}
+
+	public:
+		//every intersecting pair of segs
+		static std::vector<Hit> FindAll(std::span<const Segment<T>> segs, ThreadPool* tp = nullptr, T eps = Epsilon::Eps())
+		{
+			return Run(segs, tp, eps, [](int, int) { return true; });
+		}
+
+		//pairs of a segment of a and a segment of b; first indexes a, second indexes b
+		static std::vector<Hit> FindBetween(std::span<const Segment<T>> a, std::span<const Segment<T>> b, ThreadPool* tp = nullptr, T eps = Epsilon::Eps())
+		{
+			std::vector<Segment<T>> all(a.begin(), a.end());
+			all.insert(all.end(), b.begin(), b.end());
+			int na = a.size();
+			std::vector<Hit> res = Run(all, tp, eps, [na](int i, int j) { return i < na && j >= na; });
+			for (Hit& hit : res)
+				hit.second -= na;
+			return res;
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,508 @@
+#pragma once
+#include "Morton.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <numeric>
+#include <queue>
+#include <tuple>
+#include <vector>
+
+namespace geomlib
+{
+	namespace simplification
+	{
+		//sum of squared distances to planes as a symmetric 4x4 matrix: xx xy xz xw yy yz yw zz zw ww
+		FLOATING(T)
+		struct Quadric
+		{
+			T a[10] = {};
+
+			void AddPlane(const Vector<T>& norm, T d)
+			{
+				T p[4] = { norm.X(), norm.Y(), norm.Z(), d };
+				int k = 0;
+				for (int i = 0; i < 4; i++)
+					for (int j = i; j < 4; j++)
+						a[k++] += p[i] * p[j];
+			}
+
+			Quadric<T>& operator+= (const Quadric<T>& rhs)
+			{
+				for (int k = 0; k < 10; k++)
+					a[k] += rhs.a[k];
+				return *this;
+			}
+
+			T Error(const Point<T>& pt) const
+			{
+				T x = pt.X(), y = pt.Y(), z = pt.Z();
+				return a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z + 2 * a[3] * x + a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y +
+					a[7] * z * z + 2 * a[8] * z + a[9];
+			}
+		};
+
+		//Half-edge collapses ordered by quadric error on a mesh whose equal points are welded into one vertex.
+		//A vertex is only moved onto a neighbour, so no new positions appear. Edges between triangles of different
+		//surfaces and edges of one triangle are seams: a vertex on a seam can only slide along it, into the next
+		//seam vertex, and only if it has exactly two seam edges, so corners and junctions of surfaces stay.
+		FLOATING(T)
+		class Decimator
+		{
+		public:
+			struct Face
+			{
+				int v[3];
+				int surface;
+				bool alive;
+			};
+
+			std::vector<Point<T>> m_vecPoints;
+			std::vector<Face> m_vecFaces;
+			//surface and vertex before welding of every copy of a vertex, as the model keeps surfaces apart
+			std::vector<std::vector<std::pair<int, int>>> m_vecCopies;
+			std::vector<std::vector<int>> m_vecAround;
+			std::vector<Quadric<T>> m_vecQuadrics;
+			std::vector<int> m_vecVersion;
+			//seam edges at every vertex, more than two lock it
+			std::vector<int> m_vecSeams;
+			//region of the vertex while regions are simplified in parallel, -1 for vertices on region borders
+			//and for their neighbours
+			std::vector<int> m_vecRegion;
+
+			//welds equal points, corners holds three vertices per triangle and triangle t belongs to surfaces[t]
+			Decimator(const std::vector<Point<T>>& pts, const std::vector<int>& corners, const std::vector<int>& surfaces)
+			{
+				int np = pts.size(), nt = surfaces.size();
+				std::vector<int> order(np), weld(np);
+				std::iota(order.begin(), order.end(), 0);
+				auto key = [&pts](int i) { return std::make_tuple(pts[i].X(), pts[i].Y(), pts[i].Z()); };
+				std::sort(order.begin(), order.end(), [&key](int a, int b) { return key(a) < key(b); });
+				for (int i = 0; i < np; i++)
+				{
+					if (i == 0 || key(order[i]) != key(order[i - 1]))
+						m_vecPoints.push_back(pts[order[i]]);
+					weld[order[i]] = m_vecPoints.size() - 1;
+				}
+				m_vecAround.resize(m_vecPoints.size());
+				m_vecQuadrics.resize(m_vecPoints.size());
+				m_vecVersion.assign(m_vecPoints.size(), 0);
+				m_vecSeams.assign(m_vecPoints.size(), 0);
+				m_vecRegion.assign(m_vecPoints.size(), -1);
+				m_vecCopies.resize(m_vecPoints.size());
+				for (int t = 0; t < nt; t++)
+				{
+					Face f = { { weld[corners[3 * t]], weld[corners[3 * t + 1]], weld[corners[3 * t + 2]] }, surfaces[t], true };
+					f.alive = f.v[0] != f.v[1] && f.v[1] != f.v[2] && f.v[2] != f.v[0];
+					m_vecFaces.push_back(f);
+					for (int k = 0; k < 3; k++)
+					{
+						std::pair<int, int> copy = { surfaces[t], corners[3 * t + k] };
+						std::vector<std::pair<int, int>>& copies = m_vecCopies[f.v[k]];
+						if (std::find(copies.begin(), copies.end(), copy) == copies.end())
+							copies.push_back(copy);
+						if (f.alive)
+							m_vecAround[f.v[k]].push_back(t);
+					}
+				}
+				InitQuadrics();
+			}
+
+			int AliveCount() const
+			{
+				int res = 0;
+				for (const Face& f : m_vecFaces)
+					res += f.alive;
+				return res;
+			}
+
+			//vertex before welding that stands for v in surface, v moved only inside surfaces it belonged to
+			int CopyOf(int v, int surface) const
+			{
+				for (const std::pair<int, int>& copy : m_vecCopies[v])
+					if (copy.first == surface)
+						return copy.second;
+				return m_vecCopies[v].front().second;
+			}
+
+			//Collapses edges until target triangles are left or the next collapse would move a vertex farther than
+			//maxError from a plane of an original triangle around it; target 0 leaves only maxError. Large meshes are
+			//first cut into regions along the Morton curve, small enough for their queues to stay in cache, that are
+			//simplified in parallel on tp; vertices on region borders and next to them wait for a last pass over the whole mesh.
+			//Regions depend only on the mesh, so the result does not depend on tp.
+			int Simplify(int target, T maxError, ThreadPool* tp = nullptr)
+			{
+				const int regionSize = 16384;
+				int alive = AliveCount();
+				int regions = alive / regionSize;
+				if (regions > 1 && alive > target)
+				{
+					std::vector<int> faceRegion;
+					Partition(regions, faceRegion);
+					std::vector<std::vector<int>> verts(regions);
+					for (int v = 0; v < (int)m_vecPoints.size(); v++)
+						if (m_vecRegion[v] >= 0)
+							verts[m_vecRegion[v]].push_back(v);
+					std::vector<int> before(regions, 0), after(regions, 0);
+					for (int t = 0; t < (int)m_vecFaces.size(); t++)
+						before[faceRegion[t]] += m_vecFaces[t].alive;
+					//a collapse takes about two triangles, regions remove the share of their inner vertices that the
+					//whole mesh loses and leave the rest to the last pass, or meshes with most vertices on borders
+					//would be thinned out wherever a region has inner vertices
+					auto work = [&](int from, int to) {
+						for (int r = from; r < to; r++)
+						{
+							int removable = (int)(2 * (1 - (T)target / alive) * verts[r].size());
+							after[r] = Pass(std::max((int)((long long)before[r] * target / alive), before[r] - removable), maxError, r, before[r], verts[r]);
+						}
+					};
+					if (tp)
+						tp->ParallelFor(0, regions, work, 1);
+					else
+						work(0, regions);
+					alive = std::accumulate(after.begin(), after.end(), 0);
+					std::fill(m_vecRegion.begin(), m_vecRegion.end(), -1);
+				}
+				std::vector<int> all(m_vecPoints.size());
+				std::iota(all.begin(), all.end(), 0);
+				return Pass(target, maxError, -1, alive, all);
+			}
+
+		protected:
+			//a vertex with the edge it would collapse along, stale once the vertex has a newer version
+			struct Candidate
+			{
+				T cost;
+				int u, v;
+				int version;
+				//the smallest cost on top
+				bool operator< (const Candidate& rhs) const { return cost > rhs.cost; }
+			};
+
+			//Morton order of triangle centroids cut into regions equal in triangles. A region only moves vertices whose
+			//neighbours all belong to it: a collapse rewrites the triangles around both ends and the seam counts of their
+			//neighbours, so nothing it touches is read by another region, and vertices used by more than one region and
+			//their neighbours are left out of the parallel pass.
+			void Partition(int regions, std::vector<int>& faceRegion)
+			{
+				int nt = m_vecFaces.size();
+				AABB<T> box;
+				for (const Point<T>& p : m_vecPoints)
+					box.Expand(p);
+				std::vector<uint64_t> keys(nt);
+				std::vector<int> order(nt);
+				std::iota(order.begin(), order.end(), 0);
+				for (int t = 0; t < nt; t++)
+				{
+					const Face& f = m_vecFaces[t];
+					const Point<T>& a = m_vecPoints[f.v[0]];
+					const Point<T>& b = m_vecPoints[f.v[1]];
+					const Point<T>& c = m_vecPoints[f.v[2]];
+					keys[t] = MortonCode30(Point<T>((a.X() + b.X() + c.X()) / 3, (a.Y() + b.Y() + c.Y()) / 3, (a.Z() + b.Z() + c.Z()) / 3), box);
+				}
+				RadixSort(keys, order, 30);
+				faceRegion.assign(nt, 0);
+				for (int i = 0; i < nt; i++)
+					faceRegion[order[i]] = (int)((long long)i * regions / std::max(1, nt));
+				std::vector<int> first(m_vecPoints.size(), -2);
+				for (int t = 0; t < nt; t++)
+				{
+					if (!m_vecFaces[t].alive)
+						continue;
+					for (int v : m_vecFaces[t].v)
+						first[v] = first[v] == -2 || first[v] == faceRegion[t] ? faceRegion[t] : -1;
+				}
+				std::vector<char> inner(m_vecPoints.size(), 1);
+				for (int t = 0; t < nt; t++)
+				{
+					const Face& f = m_vecFaces[t];
+					if (f.alive && (first[f.v[0]] < 0 || first[f.v[0]] != first[f.v[1]] || first[f.v[0]] != first[f.v[2]]))
+						inner[f.v[0]] = inner[f.v[1]] = inner[f.v[2]] = 0;
+				}
+				for (int v = 0; v < (int)m_vecPoints.size(); v++)
+					m_vecRegion[v] = first[v] < 0 || !inner[v] ? -1 : first[v];
+			}
+
+			//collapses edges of verts while more than target triangles are alive and the error stays within maxError;
+			//with region >= 0 only vertices of that region are touched, alive is the count to start from
+			int Pass(int target, T maxError, int region, int alive, const std::vector<int>& verts)
+			{
+				std::priority_queue<Candidate> heap;
+				std::vector<int> nb;
+				for (int u : verts)
+					PushBest(heap, u, region, false, nb);
+				T maxQuadric = maxError * maxError;
+				while (alive > target && !heap.empty())
+				{
+					Candidate c = heap.top();
+					heap.pop();
+					if (c.version != m_vecVersion[c.u])
+						continue;
+					if (c.cost > maxQuadric)
+						break;
+					//quadrics only grow as vertices merge, so a queued cost is a lower bound and is checked now
+					T cost = Cost(c.u, c.v);
+					if (cost > c.cost)
+					{
+						heap.push({ cost, c.u, c.v, c.version });
+						continue;
+					}
+					//so is whether the edge may collapse, if not the next allowed one waits its turn
+					if (!CanCollapse(c.u, c.v))
+					{
+						PushBest(heap, c.u, region, !m_vecAround[c.v].empty(), nb);
+						continue;
+					}
+					std::vector<int> before;
+					Neighbours(c.u, before);
+					alive -= Collapse(c.u, c.v);
+					//the edges that moved from u to v
+					PushBest(heap, c.v, region, false, nb);
+					for (int w : before)
+						if (w != c.v && (region < 0 || m_vecRegion[w] == region))
+							heap.push({ Cost(w, c.v), w, c.v, m_vecVersion[w] });
+				}
+				return alive;
+			}
+
+			//planes of triangles, and for seams also the plane through the seam across the triangle,
+			//so that sliding along a curved seam costs as much as moving across a curved surface
+			void InitQuadrics()
+			{
+				//seams from all edges sorted once, vertices in the middle of a fan have too many edges to ask one by one
+				std::vector<std::tuple<int, int, int>> edges;
+				for (const Face& f : m_vecFaces)
+					if (f.alive)
+						for (int k = 0; k < 3; k++)
+							edges.push_back({ std::min(f.v[k], f.v[(k + 1) % 3]), std::max(f.v[k], f.v[(k + 1) % 3]), f.surface });
+				std::sort(edges.begin(), edges.end());
+				std::vector<std::pair<int, int>> seams;
+				for (int i = 0, j; i < (int)edges.size(); i = j)
+				{
+					bool mixed = false;
+					for (j = i; j < (int)edges.size() && std::get<0>(edges[j]) == std::get<0>(edges[i]) && std::get<1>(edges[j]) == std::get<1>(edges[i]); j++)
+						mixed = mixed || std::get<2>(edges[j]) != std::get<2>(edges[i]);
+					if (mixed || j - i != 2)
+					{
+						seams.push_back({ std::get<0>(edges[i]), std::get<1>(edges[i]) });
+						m_vecSeams[std::get<0>(edges[i])]++;
+						m_vecSeams[std::get<1>(edges[i])]++;
+					}
+				}
+				for (int t = 0; t < (int)m_vecFaces.size(); t++)
+				{
+					const Face& f = m_vecFaces[t];
+					if (!f.alive)
+						continue;
+					Vector<T> n = (m_vecPoints[f.v[1]] - m_vecPoints[f.v[0]]).CrossProduct(m_vecPoints[f.v[2]] - m_vecPoints[f.v[0]]);
+					if (n.LengthPow2() == 0)
+						continue;
+					n.Normalize();
+					Quadric<T> q;
+					q.AddPlane(n, -n.DotProduct(m_vecPoints[f.v[0]] - Point<T>(0, 0, 0)));
+					for (int k = 0; k < 3; k++)
+						m_vecQuadrics[f.v[k]] += q;
+					for (int k = 0; k < 3; k++)
+					{
+						int a = f.v[k], b = f.v[(k + 1) % 3];
+						if (!std::binary_search(seams.begin(), seams.end(), std::make_pair(std::min(a, b), std::max(a, b))))
+							continue;
+						Vector<T> across = (m_vecPoints[b] - m_vecPoints[a]).CrossProduct(n);
+						if (across.LengthPow2() == 0)
+							continue;
+						across.Normalize();
+						Quadric<T> seam;
+						seam.AddPlane(across, -across.DotProduct(m_vecPoints[a] - Point<T>(0, 0, 0)));
+						m_vecQuadrics[a] += seam;
+						m_vecQuadrics[b] += seam;
+					}
+				}
+			}
+
+			//alive triangles of the edge (u, v), and whether they make a seam; walked from the end with fewer triangles
+			int EdgeFaces(int u, int v, bool& seam) const
+			{
+				if (m_vecAround[u].size() > m_vecAround[v].size())
+					std::swap(u, v);
+				int count = 0, surface = -1;
+				seam = false;
+				for (int t : m_vecAround[u])
+				{
+					const Face& f = m_vecFaces[t];
+					if (!f.alive || (f.v[0] != v && f.v[1] != v && f.v[2] != v))
+						continue;
+					count++;
+					seam = seam || (surface >= 0 && surface != f.surface);
+					surface = f.surface;
+				}
+				seam = seam || count != 2;
+				return count;
+			}
+
+			bool IsSeam(int u, int v) const
+			{
+				bool seam;
+				EdgeFaces(u, v, seam);
+				return seam;
+			}
+
+			//a vertex off seams moves anywhere, one on a seam only along it
+			bool MayMove(int u, int v) const
+			{
+				return m_vecSeams[u] == 0 || (m_vecSeams[u] == 2 && IsSeam(u, v));
+			}
+
+			//number of seam edges at u in one pass over its triangles
+			int SeamCount(int u) const
+			{
+				std::vector<std::pair<int, int>> ends;
+				for (int t : m_vecAround[u])
+				{
+					const Face& f = m_vecFaces[t];
+					if (f.alive)
+						for (int w : f.v)
+							if (w != u)
+								ends.push_back({ w, f.surface });
+				}
+				std::sort(ends.begin(), ends.end());
+				int res = 0;
+				for (int i = 0, j; i < (int)ends.size(); i = j)
+				{
+					for (j = i; j < (int)ends.size() && ends[j].first == ends[i].first; j++);
+					res += j - i != 2 || ends[i].second != ends[j - 1].second;
+				}
+				return res;
+			}
+
+			bool Adjacent(int u, int v) const
+			{
+				if (m_vecAround[u].size() > m_vecAround[v].size())
+					std::swap(u, v);
+				for (int t : m_vecAround[u])
+				{
+					const Face& f = m_vecFaces[t];
+					if (f.alive && (f.v[0] == v || f.v[1] == v || f.v[2] == v))
+						return true;
+				}
+				return false;
+			}
+
+			void Neighbours(int u, std::vector<int>& res) const
+			{
+				res.clear();
+				for (int t : m_vecAround[u])
+					if (m_vecFaces[t].alive)
+						for (int w : m_vecFaces[t].v)
+							if (w != u)
+								res.push_back(w);
+				std::sort(res.begin(), res.end());
+				res.erase(std::unique(res.begin(), res.end()), res.end());
+			}
+
+			T Cost(int u, int v) const
+			{
+				Quadric<T> q = m_vecQuadrics[u];
+				q += m_vecQuadrics[v];
+				return q.Error(m_vecPoints[v]);
+			}
+
+			//queues the cheapest collapse of u into a neighbour, with allowed only one that CanCollapse accepts
+			void PushBest(std::priority_queue<Candidate>& heap, int u, int region, bool allowed, std::vector<int>& nb) const
+			{
+				if (m_vecSeams[u] > 2)
+					return;
+				Neighbours(u, nb);
+				Candidate best = { 0, u, -1, m_vecVersion[u] };
+				for (int w : nb)
+				{
+					if ((region >= 0 && m_vecRegion[w] != region) || !MayMove(u, w))
+						continue;
+					T cost = Cost(u, w);
+					if ((best.v < 0 || cost < best.cost) && (!allowed || CanCollapse(u, w)))
+						best = { cost, u, w, m_vecVersion[u] };
+				}
+				if (best.v >= 0)
+					heap.push(best);
+			}
+
+			bool CanCollapse(int u, int v) const
+			{
+				bool seamEdge;
+				int shared = EdgeFaces(u, v, seamEdge);
+				if (shared == 0)
+					return false;
+				int seams = m_vecSeams[u];
+				if (seams > 0 && (seams != 2 || !seamEdge))
+					return false;
+				//link condition: the neighbours both ends share are exactly the opposite corners of the edge,
+				//walked from the end with fewer triangles
+				int a = m_vecAround[u].size() <= m_vecAround[v].size() ? u : v, b = a == u ? v : u;
+				std::vector<int> na;
+				Neighbours(a, na);
+				int common = 0;
+				for (int w : na)
+					common += w != b && Adjacent(w, b);
+				if (common != shared)
+					return false;
+				//no triangle that stays may turn over or collapse
+				for (int t : m_vecAround[u])
+				{
+					const Face& f = m_vecFaces[t];
+					if (!f.alive || f.v[0] == v || f.v[1] == v || f.v[2] == v)
+						continue;
+					Point<T> p[3], q[3];
+					for (int k = 0; k < 3; k++)
+					{
+						p[k] = m_vecPoints[f.v[k]];
+						q[k] = f.v[k] == u ? m_vecPoints[v] : p[k];
+					}
+					Vector<T> before = (p[1] - p[0]).CrossProduct(p[2] - p[0]);
+					Vector<T> after = (q[1] - q[0]).CrossProduct(q[2] - q[0]);
+					if (after.DotProduct(before) <= 0)
+						return false;
+				}
+				return true;
+			}
+
+			//moves u onto v, returns the number of triangles of the edge that disappear
+			int Collapse(int u, int v)
+			{
+				//edges from the opposite corners to u and v become one, seams elsewhere only move from u to v
+				std::vector<std::pair<int, int>> opposite;
+				for (int t : m_vecAround[u])
+				{
+					const Face& f = m_vecFaces[t];
+					if (f.alive && (f.v[0] == v || f.v[1] == v || f.v[2] == v))
+						for (int w : f.v)
+							if (w != u && w != v)
+								opposite.push_back({ w, IsSeam(u, w) + IsSeam(v, w) });
+				}
+				int removed = 0;
+				for (int t : m_vecAround[u])
+				{
+					Face& f = m_vecFaces[t];
+					if (!f.alive)
+						continue;
+					if (f.v[0] == v || f.v[1] == v || f.v[2] == v)
+					{
+						f.alive = false;
+						removed++;
+						continue;
+					}
+					for (int k = 0; k < 3; k++)
+						if (f.v[k] == u)
+							f.v[k] = v;
+					m_vecAround[v].push_back(t);
+				}
+				m_vecAround[u].clear();
+				std::vector<int>& around = m_vecAround[v];
+				around.erase(std::remove_if(around.begin(), around.end(), [this](int t) { return !m_vecFaces[t].alive; }), around.end());
+				m_vecQuadrics[v] += m_vecQuadrics[u];
+				m_vecVersion[u]++;
+				for (auto& w : opposite)
+					m_vecSeams[w.first] += IsSeam(v, w.first) - w.second;
+				m_vecSeams[v] = SeamCount(v);
+				return removed;
+			}
+		};
+	}
+}
\ No newline at end of file
@@ -0,0 +1,150 @@
+#pragma once
+#include "TessModel.h"
+#include "Plane.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace geomlib
+{
+	//a closed polyline does not repeat its first point at the end
+	FLOATING(T)
+	struct Polyline
+	{
+		std::vector<Point<T>> m_vecPoints;
+		bool m_bClosed = false;
+	};
+
+	namespace slicer
+	{
+		FLOATING(T)
+		struct Segment
+		{
+			std::array<T, 3> start, end;
+		};
+
+		//Joins segments that share end points into polylines. Segments of neighbouring triangles compute their
+		//common point from the same two vertices, so ends are matched exactly.
+		FLOATING(T)
+		void Chain(const std::vector<Segment<T>>& segs, std::vector<Polyline<T>>& res)
+		{
+			int n = segs.size();
+			std::vector<int> byStart(n), ends(n);
+			std::iota(byStart.begin(), byStart.end(), 0);
+			std::sort(byStart.begin(), byStart.end(), [&segs](int a, int b) { return segs[a].start < segs[b].start; });
+			std::vector<std::array<T, 3>> endPts(n);
+			for (int i = 0; i < n; i++)
+				endPts[i] = segs[i].end;
+			std::sort(endPts.begin(), endPts.end());
+			std::vector<char> used(n, 0);
+			//the first unused segment that starts at pt
+			auto next = [&](const std::array<T, 3>& pt) {
+				auto it = std::lower_bound(byStart.begin(), byStart.end(), pt, [&segs](int a, const std::array<T, 3>& p) { return segs[a].start < p; });
+				for (; it != byStart.end() && segs[*it].start == pt; it++)
+					if (!used[*it])
+						return *it;
+				return -1;
+			};
+			auto walk = [&](int first) {
+				Polyline<T> line;
+				const std::array<T, 3>& origin = segs[first].start;
+				line.m_vecPoints.push_back(Point<T>(origin[0], origin[1], origin[2]));
+				for (int cur = first; cur >= 0; cur = next(segs[cur].end))
+				{
+					used[cur] = 1;
+					if (segs[cur].end == origin)
+					{
+						line.m_bClosed = true;
+						break;
+					}
+					line.m_vecPoints.push_back(Point<T>(segs[cur].end[0], segs[cur].end[1], segs[cur].end[2]));
+				}
+				res.push_back(std::move(line));
+			};
+			//open chains begin where no segment ends, what is left are loops
+			for (int i : byStart)
+				if (!used[i] && !std::binary_search(endPts.begin(), endPts.end(), segs[i].start))
+					walk(i);
+			for (int i : byStart)
+				if (!used[i])
+					walk(i);
+		}
+	}
+
+	//Sections of the model by planes parallel to plane, plane i being moved by offsets[i] along the unit normal;
+	//offsets have to be ascending. Triangles are sorted by their lowest vertex along the normal once, then every
+	//range of planes sweeps upwards with a set of active triangles: triangles join it when the sweep reaches
+	//their lowest vertex and leave after it passes the highest one. Ranges of planes run in parallel on tp.
+	//Vertices exactly on a plane count as above it, so a section through vertices and edges has no gaps or
+	//doubled segments. For closed models with outward normals the outer loops turn counterclockwise seen from
+	//the normal and holes clockwise.
+	FLOATING(T)
+	std::vector<std::vector<Polyline<T>>> Slice(const TessModel<T>& model, const Plane<T>& plane, std::type_identity_t<std::span<const T>> offsets, ThreadPool* tp = nullptr)
+	{
+		Vector<T> norm = plane.Normal().NormalizedCopy();
+		T base = norm.DotProduct(plane.Start() - Point<T>(0, 0, 0));
+		int np = model.PointsCount(), nt = model.TrianglesCount(), planes = offsets.size();
+		std::vector<T> dist(np), lo(nt), hi(nt);
+		for (int i = 0; i < np; i++)
+			dist[i] = norm.DotProduct(model.GetPoint(i) - Point<T>(0, 0, 0)) - base;
+		std::vector<int> order(nt);
+		for (int t = 0; t < nt; t++)
+		{
+			const Triangle& tri = model.GetTriangle(t);
+			lo[t] = std::min({ dist[tri.ind[0]], dist[tri.ind[1]], dist[tri.ind[2]] });
+			hi[t] = std::max({ dist[tri.ind[0]], dist[tri.ind[1]], dist[tri.ind[2]] });
+			order[t] = t;
+		}
+		std::sort(order.begin(), order.end(), [&lo](int a, int b) { return lo[a] < lo[b]; });
+
+		std::vector<std::vector<Polyline<T>>> res(planes);
+		auto sweep = [&](int from, int to) {
+			std::vector<int> active;
+			std::vector<slicer::Segment<T>> segs;
+			int joined = 0;
+			for (int p = from; p < to; p++)
+			{
+				T h = offsets[p];
+				while (joined < nt && lo[order[joined]] <= h)
+					active.push_back(order[joined++]);
+				active.erase(std::remove_if(active.begin(), active.end(), [&hi, h](int t) { return hi[t] < h; }), active.end());
+				segs.clear();
+				for (int t : active)
+				{
+					const Triangle& tri = model.GetTriangle(t);
+					T s[3] = { dist[tri.ind[0]] - h, dist[tri.ind[1]] - h, dist[tri.ind[2]] - h };
+					std::array<T, 3> cross[2];
+					bool found[2] = { false, false };
+					//edges in the order of the triangle, 0 is where it goes below the plane and 1 where it comes back
+					for (int k = 0; k < 3; k++)
+					{
+						int a = k, b = (k + 1) % 3;
+						bool belowA = s[a] < 0, belowB = s[b] < 0;
+						if (belowA == belowB)
+							continue;
+						//always from the vertex below to the one above, as the neighbour across the edge does
+						int lower = belowA ? a : b, upper = belowA ? b : a;
+						const Point<T>& pl = model.GetPoint(tri.ind[lower]);
+						const Point<T>& pu = model.GetPoint(tri.ind[upper]);
+						Point<T> pt = s[upper] == 0 ? pu : pl + (pu - pl) * (s[lower] / (s[lower] - s[upper]));
+						int slot = belowA ? 1 : 0;
+						cross[slot] = { pt.X(), pt.Y(), pt.Z() };
+						found[slot] = true;
+					}
+					if (found[0] && found[1] && cross[0] != cross[1])
+						segs.push_back({ cross[0], cross[1] });
+				}
+				slicer::Chain(segs, res[p]);
+			}
+		};
+		if (tp)
+			tp->ParallelFor(0, planes, sweep, 16);
+		else
+			sweep(0, planes);
+		return res;
+	}
+}
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "Matrix.h"
 #include "Line.h"
 #include "Ray.h"
+#include "AABB.h"
 #include <vector>
 
 namespace geomlib
@@ -13,11 +14,16 @@ namespace geomlib
 	{
 	protected:
 		Point<T> m_ptStart;
+		//box of the surface, kept by every change of its parameters; infinite where the surface has no end
+		AABB<T> m_boxBounds;
+
+		virtual void UpdateBounds() = 0;
 	public:
 		Surface() = default;
 		Surface(const Point<T>& pt, const Vector<T>& a) : m_ptStart(pt) {};
 		inline Point<T> Start() const { return m_ptStart; }
-		inline void SetStart(const Point<T>& pt) { m_ptStart = pt; }
+		inline void SetStart(const Point<T>& pt) { m_ptStart = pt; UpdateBounds(); }
+		inline const AABB<T>& Bounds() const { return m_boxBounds; }
 		
 
 		bool Belongs(const Point<T>& pt, T epsPow2 = Epsilon::EpsPow2()) const
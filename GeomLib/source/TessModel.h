@@ -1,12 +1,20 @@
 #pragma once
+#include "Compression.h"
+#include "Async.h"
+#include "Morton.h"
 #include "ThreadPool.h"
 #include "Cylinder.h"
 #include "Segment.h"
 #include "Matrix.h"
 #include "Plane.h"
+#include "Quaternion.h"
+#include "BVH.h"
 #include "Ray.h"
+#include "Simplification.h"
+#include <algorithm>
 #include <climits>
 #include <vector>
+#include <span>
 #include <thread>
 #include <set>
 
@@ -28,17 +36,115 @@ namespace geomlib
 		std::vector<Vector<T>> m_vecAllNormals;
 		std::vector<Triangle> m_vecTriangles;
 		std::vector<int> m_vecLastOfSurface;
+		//unit normals of triangles, recomputed for every triangle that is added or moved
+		std::vector<Vector<T>> m_vecFaceNormals;
+		//boxes of surfaces, recomputed for every surface that is added or moved
+		std::vector<AABB<T>> m_vecSurfaceBounds;
+		BVH<T> m_bvh;
+		ThreadPool* m_pThreadPool = nullptr;
 
+		//appends a part, its triangle indices are shifted by the current number of points
 		void MergeHelper(const std::vector<Point<T>>& pts, const std::vector<Vector<T>>& norms, const std::vector<Triangle>& tr)
 		{
-			for (int i = 0; i < tr.size(); i++) {
-				for (int j = 0; j < 3; j++) {
-					tr[i].ind[j] += pts.size();
-				}
+			int base = m_vecAllPoints.size();
+			if (!norms.empty() || !m_vecAllNormals.empty())
+			{
+				//normals stay aligned with points even if some part comes without them
+				m_vecAllNormals.resize(base);
+				m_vecAllNormals.reserve(base + pts.size());
+				m_vecAllNormals.insert(m_vecAllNormals.end(), norms.begin(), norms.begin() + std::min(norms.size(), pts.size()));
+				m_vecAllNormals.resize(base + pts.size());
 			}
-			m_vecTriangles.insert(m_vecTriangles.end(), tr.begin(), tr.end());
 			m_vecAllPoints.insert(m_vecAllPoints.end(), pts.begin(), pts.end());
-			m_vecAllNormals.insert(m_vecAllNormals.end(), norms.begin(), norms.end());
+			int first = m_vecTriangles.size();
+			m_vecTriangles.reserve(m_vecTriangles.size() + tr.size());
+			for (const Triangle& t : tr)
+				m_vecTriangles.push_back({ t.ind[0] + base, t.ind[1] + base, t.ind[2] + base });
+			UpdateFaceNormals(first, m_vecTriangles.size());
+		}
+
+		//recomputes cached normals of triangles [first, last)
+		void UpdateFaceNormals(int first, int last, ThreadPool* tp = nullptr)
+		{
+			m_vecFaceNormals.resize(m_vecTriangles.size());
+			auto body = [this](int from, int to) {
+				for (int i = from; i < to; i++)
+				{
+					const Triangle& t = m_vecTriangles[i];
+					m_vecFaceNormals[i] = NormalToCoords(m_vecAllPoints[t.ind[0]], m_vecAllPoints[t.ind[1]], m_vecAllPoints[t.ind[2]]);
+				}
+			};
+			if (tp)
+				tp->ParallelFor(first, last, body, 4096);
+			else
+				body(first, last);
+		}
+
+		//recomputes cached boxes of surfaces [first, last)
+		void UpdateSurfaceBounds(int first, int last, ThreadPool* tp = nullptr)
+		{
+			m_vecSurfaceBounds.resize(m_vecLastOfSurface.size());
+			auto body = [this](int from, int to) {
+				for (int s = from; s < to; s++)
+				{
+					int firstTri, lastTri;
+					SurfaceRange(s, firstTri, lastTri);
+					AABB<T> box;
+					for (int i = firstTri; i <= lastTri; i++)
+						for (int j = 0; j < 3; j++)
+							box.Expand(m_vecAllPoints[m_vecTriangles[i].ind[j]]);
+					m_vecSurfaceBounds[s] = box;
+				}
+			};
+			if (tp)
+				tp->ParallelFor(first, last, body);
+			else
+				body(first, last);
+		}
+
+		//appends surfaces starting from firstSurface to the acceleration structure as new subtrees
+		void InsertSurfaces(int firstSurface)
+		{
+			auto boxOf = [this](int i) { return TriangleBox(i); };
+			for (int s = firstSurface; s < (int)m_vecLastOfSurface.size(); s++)
+			{
+				int first, last;
+				SurfaceRange(s, first, last);
+				m_bvh.Insert(first, last, boxOf);
+			}
+			UpdateAcceleration();
+		}
+
+		//takes a finished background rebuild and starts a new one if refits and insertions degraded the tree
+		void UpdateAcceleration()
+		{
+			auto boxOf = [this](int i) { return TriangleBox(i); };
+			m_bvh.AdoptRebuild(boxOf);
+			if (m_pThreadPool && m_bvh.NeedsRebuild())
+				m_bvh.ScheduleRebuild(*m_pThreadPool, SurfaceRanges(), (int)m_vecTriangles.size(), boxOf);
+		}
+
+		//vertices numbered in the order triangles use them, unused ones go last;
+		//newIndex maps old numbers to new ones, order is the inverse map
+		void NumberByFirstUse(const std::vector<Triangle>& tris, std::vector<int>& newIndex, std::vector<int>& order) const
+		{
+			int nv = m_vecAllPoints.size();
+			newIndex.assign(nv, -1);
+			order.clear();
+			order.reserve(nv);
+			for (const Triangle& t : tris)
+				for (int j = 0; j < 3; j++)
+					if (newIndex[t.ind[j]] < 0)
+					{
+						newIndex[t.ind[j]] = order.size();
+						order.push_back(t.ind[j]);
+					}
+			for (int v = 0; v < nv; v++)
+				if (newIndex[v] < 0)
+				{
+					newIndex[v] = order.size();
+					order.push_back(v);
+				}
 		}
 
 		Vector<T> NormalToCoords(const Point<T>& a, const Point<T>& b, const Point<T>& c) const
@@ -47,32 +153,445 @@ namespace geomlib
 		}
 
 	public:
-		Vector<T> NormalToTriangle(int ind) const
+		inline const Vector<T>& NormalToTriangle(int ind) const
 		{
-			return NormalToCoords(m_vecAllPoints[m_vecTriangles[ind].ind[0]], m_vecAllPoints[m_vecTriangles[ind].ind[1]], m_vecAllPoints[m_vecTriangles[ind].ind[2]]);
+			return m_vecFaceNormals[ind];
+		}
+
+		inline const Point<T>& GetPoint(int ind) const { return m_vecAllPoints[ind]; }
+		inline const Vector<T>& GetNormal(int ind) const { return m_vecAllNormals[ind]; }
+		inline const Triangle& GetTriangle(int ind) const { return m_vecTriangles[ind]; }
+
+		//sets unit vertex normals to the average of adjacent face normals, weighted by the corner angle
+		//or by the triangle area; vertices not used by any triangle keep their normals
+		void RecomputeVertexNormals(bool angleWeighted, ThreadPool* tp = nullptr)
+		{
+			int nv = m_vecAllPoints.size(), nt = m_vecTriangles.size();
+			auto parallel = [tp](int from, int to, auto body) {
+				if (tp)
+					tp->ParallelFor(from, to, body, 4096);
+				else
+					body(from, to);
+			};
+
+			//scatter: every corner gets its own slot, so triangles are processed independently
+			std::vector<Vector<T>> contrib(3 * nt);
+			parallel(0, nt, [&](int from, int to) {
+				for (int t = from; t < to; t++)
+				{
+					const Point<T>* p[3] = { &m_vecAllPoints[m_vecTriangles[t].ind[0]], &m_vecAllPoints[m_vecTriangles[t].ind[1]], &m_vecAllPoints[m_vecTriangles[t].ind[2]] };
+					Vector<T> cross = (*p[1] - *p[0]).CrossProduct(*p[2] - *p[0]);
+					for (int j = 0; j < 3; j++)
+					{
+						if (angleWeighted)
+							contrib[3 * t + j] = m_vecFaceNormals[t] * (*p[(j + 1) % 3] - *p[j]).Angle(*p[(j + 2) % 3] - *p[j]);
+						else
+							contrib[3 * t + j] = cross;
+					}
+				}
+			});
+
+			//corners sorted by vertex with a counting sort, corners of one vertex form a segment
+			std::vector<int> offsets(nv + 1, 0), corners(3 * nt);
+			for (const Triangle& t : m_vecTriangles)
+				for (int j = 0; j < 3; j++)
+					offsets[t.ind[j] + 1]++;
+			for (int v = 0; v < nv; v++)
+				offsets[v + 1] += offsets[v];
+			std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+			for (int c = 0; c < 3 * nt; c++)
+				corners[cursor[m_vecTriangles[c / 3].ind[c % 3]]++] = c;
+
+			//segmented reduce: each vertex sums its segment in a fixed order, the result does not depend on threads
+			m_vecAllNormals.resize(nv);
+			parallel(0, nv, [&](int from, int to) {
+				for (int v = from; v < to; v++)
+				{
+					if (offsets[v] == offsets[v + 1]) continue;
+					Vector<T> sum(0, 0, 0);
+					for (int k = offsets[v]; k < offsets[v + 1]; k++)
+						sum += contrib[corners[k]];
+					m_vecAllNormals[v] = sum.Normalize();
+				}
+			});
 		}
 
 		void MergeModels(const TessModel<T>& model) 
 		{
-			MergeHelper(model.m_vecAllPoints, model.m_vecAllNormals, model.m_vecTriangles);
-			int old = m_vecLastOfSurface.back();
-			for (int i = 0; i < model.m_vecLastOfSurface.size(); i++)
+			MergeAll(std::span<const TessModel<T>>(&model, 1));
+		}
+
+		//takes the buffers of model if this one is empty, model is left empty in any case
+		void MergeModels(TessModel<T>&& model)
+		{
+			if (IsEmpty())
 			{
-				m_vecLastOfSurface.push_back(old + model.m_vecLastOfSurface[i]);
+				m_vecAllPoints = std::move(model.m_vecAllPoints);
+				m_vecAllNormals = std::move(model.m_vecAllNormals);
+				m_vecTriangles = std::move(model.m_vecTriangles);
+				m_vecFaceNormals = std::move(model.m_vecFaceNormals);
+				m_vecLastOfSurface.insert(m_vecLastOfSurface.end(), model.m_vecLastOfSurface.begin(), model.m_vecLastOfSurface.end());
+				m_vecSurfaceBounds = std::move(model.m_vecSurfaceBounds);
+				m_bvh.Build(SurfaceRanges(), [this](int i) { return TriangleBox(i); });
+				UpdateAcceleration();
 			}
+			else
+				MergeModels(model);
+			model.Clear();
+		}
+
+		//appends all parts at once: sizes are summed first, buffers are allocated once
+		//and every part is copied and re-indexed independently, in parallel if tp is given
+		void MergeAll(std::span<const TessModel<T>> parts, ThreadPool* tp = nullptr)
+		{
+			for (const TessModel<T>& part : parts)
+			{
+				if (&part == this)
+				{
+					//parts are read while this model grows, merging with itself needs a copy
+					std::vector<TessModel<T>> copy(parts.begin(), parts.end());
+					MergeAll(std::span<const TessModel<T>>(copy), tp);
+					return;
+				}
+			}
+			int count = parts.size();
+			int surfaces = m_vecLastOfSurface.size();
+			int oldTriangles = m_vecTriangles.size();
+			std::vector<int> ptBase(count + 1), trBase(count + 1), srfBase(count + 1);
+			ptBase[0] = m_vecAllPoints.size();
+			trBase[0] = m_vecTriangles.size();
+			srfBase[0] = m_vecLastOfSurface.size();
+			bool normals = !m_vecAllNormals.empty();
+			for (int k = 0; k < count; k++)
+			{
+				ptBase[k + 1] = ptBase[k] + parts[k].m_vecAllPoints.size();
+				trBase[k + 1] = trBase[k] + parts[k].m_vecTriangles.size();
+				srfBase[k + 1] = srfBase[k] + parts[k].m_vecLastOfSurface.size();
+				normals = normals || !parts[k].m_vecAllNormals.empty();
+			}
+			m_vecAllPoints.resize(ptBase[count]);
+			if (normals)
+				m_vecAllNormals.resize(ptBase[count]);
+			m_vecTriangles.resize(trBase[count]);
+			m_vecFaceNormals.resize(trBase[count]);
+			m_vecLastOfSurface.resize(srfBase[count]);
+			m_vecSurfaceBounds.resize(srfBase[count]);
+
+			auto copyParts = [&](int from, int to) {
+				for (int k = from; k < to; k++)
+				{
+					const TessModel<T>& part = parts[k];
+					std::copy(part.m_vecAllPoints.begin(), part.m_vecAllPoints.end(), m_vecAllPoints.begin() + ptBase[k]);
+					if (normals)
+					{
+						int num = std::min(part.m_vecAllNormals.size(), part.m_vecAllPoints.size());
+						std::copy(part.m_vecAllNormals.begin(), part.m_vecAllNormals.begin() + num, m_vecAllNormals.begin() + ptBase[k]);
+					}
+					int base = ptBase[k];
+					Triangle* dst = m_vecTriangles.data() + trBase[k];
+					for (const Triangle& t : part.m_vecTriangles)
+						*dst++ = { t.ind[0] + base, t.ind[1] + base, t.ind[2] + base };
+					std::copy(part.m_vecFaceNormals.begin(), part.m_vecFaceNormals.end(), m_vecFaceNormals.begin() + trBase[k]);
+					for (int i = 0; i < (int)part.m_vecLastOfSurface.size(); i++)
+						m_vecLastOfSurface[srfBase[k] + i] = trBase[k] + part.m_vecLastOfSurface[i];
+					std::copy(part.m_vecSurfaceBounds.begin(), part.m_vecSurfaceBounds.end(), m_vecSurfaceBounds.begin() + srfBase[k]);
+				}
+			};
+			if (tp)
+				tp->ParallelFor(0, count, copyParts);
+			else
+				copyParts(0, count);
+
+			//a few parts go into the existing tree as subtrees, a bulk assembly is cheaper to build anew
+			if (m_bvh.IsEmpty() || (int)m_vecTriangles.size() - oldTriangles > oldTriangles)
+			{
+				m_bvh.Build(SurfaceRanges(), [this](int i) { return TriangleBox(i); }, tp);
+				UpdateAcceleration();
+			}
+			else
+				InsertSurfaces(surfaces);
 		}
 
 		void AddSurface(const std::vector<Point<T>>& pts, const std::vector<Vector<T>>& norms, const std::vector<Triangle>& tr)
 		{
 			MergeHelper(pts, norms, tr);
 			m_vecLastOfSurface.push_back(m_vecTriangles.size() - 1);
+			UpdateSurfaceBounds(m_vecLastOfSurface.size() - 1, m_vecLastOfSurface.size());
+			InsertSurfaces(m_vecLastOfSurface.size() - 1);
 		}
 
+		//buffers are taken over if the model is empty, otherwise they are copied as by the const overload
+		void AddSurface(std::vector<Point<T>>&& pts, std::vector<Vector<T>>&& norms, std::vector<Triangle>&& tr)
+		{
+			if (!IsEmpty())
+			{
+				AddSurface(pts, norms, tr);
+				return;
+			}
+			m_vecAllPoints = std::move(pts);
+			m_vecAllNormals = std::move(norms);
+			m_vecTriangles = std::move(tr);
+			if (!m_vecAllNormals.empty())
+				m_vecAllNormals.resize(m_vecAllPoints.size());
+			UpdateFaceNormals(0, m_vecTriangles.size());
+			m_vecLastOfSurface.push_back(m_vecTriangles.size() - 1);
+			UpdateSurfaceBounds(m_vecLastOfSurface.size() - 1, m_vecLastOfSurface.size());
+			InsertSurfaces(m_vecLastOfSurface.size() - 1);
+		}
+
+		//replaces the whole model by prepared buffers, used by the readers of mesh formats;
+		//surfaces must not share vertices, as everywhere else in the model
+		void Assign(std::vector<Point<T>>&& pts, std::vector<Vector<T>>&& norms, std::vector<Triangle>&& tr, std::vector<int>&& lastOfSurface, ThreadPool* tp = nullptr)
+		{
+			Clear();
+			m_vecAllPoints = std::move(pts);
+			m_vecAllNormals = std::move(norms);
+			m_vecTriangles = std::move(tr);
+			m_vecLastOfSurface = std::move(lastOfSurface);
+			if (!m_vecAllNormals.empty())
+				m_vecAllNormals.resize(m_vecAllPoints.size());
+			UpdateFaceNormals(0, m_vecTriangles.size(), tp);
+			UpdateSurfaceBounds(0, m_vecLastOfSurface.size(), tp);
+			RebuildAcceleration(tp, tp != nullptr);
+		}
+
+		//full rebuild of the acceleration structure; the linear build is several times faster than SAH
+		//and suits models queried right after loading, with a pool set the SAH tree replaces it when ready
+		void RebuildAcceleration(ThreadPool* tp = nullptr, bool linear = false)
+		{
+			auto boxOf = [this](int i) { return TriangleBox(i); };
+			if (linear)
+				m_bvh.BuildLinear(SurfaceRanges(), boxOf, tp);
+			else
+				m_bvh.Build(SurfaceRanges(), boxOf, tp);
+			UpdateAcceleration();
+			if (linear && m_pThreadPool)
+				m_bvh.ScheduleRebuild(*m_pThreadPool, SurfaceRanges(), (int)m_vecTriangles.size(), boxOf);
+		}
+
+		void Clear()
+		{
+			m_vecAllPoints.clear();
+			m_vecAllNormals.clear();
+			m_vecTriangles.clear();
+			m_vecLastOfSurface.clear();
+			m_vecFaceNormals.clear();
+			m_vecSurfaceBounds.clear();
+			m_bvh.Clear();
+		}
+
+		bool IsEmpty() const
+		{
+			return m_vecAllPoints.empty() && m_vecTriangles.empty();
+		}
+
+		inline bool HasNormals() const { return !m_vecAllNormals.empty(); }
+		inline int PointsCount() const { return m_vecAllPoints.size(); }
+		inline int TrianglesCount() const { return m_vecTriangles.size(); }
+		inline int SurfacesCount() const { return m_vecLastOfSurface.size(); }
+
 		int GetSurfaceByTriangle(int ind) const
 		{
 			return std::lower_bound(m_vecLastOfSurface.begin(), m_vecLastOfSurface.end(), ind) - m_vecLastOfSurface.begin();
 		}
 
+		//assigns the first and the last triangle of surface
+		void SurfaceRange(int surf, int& first, int& last) const
+		{
+			first = surf ? m_vecLastOfSurface[surf - 1] + 1 : 0;
+			last = m_vecLastOfSurface[surf];
+		}
+
+		//box of the vertices of the triangles of surf, kept up to date by every change of the model
+		inline const AABB<T>& SurfaceBounds(int surf) const { return m_vecSurfaceBounds[surf]; }
+
+		std::vector<std::pair<int, int>> SurfaceRanges() const
+		{
+			std::vector<std::pair<int, int>> res;
+			int first, last = -1;
+			for (int s = 0; s < (int)m_vecLastOfSurface.size(); s++)
+			{
+				SurfaceRange(s, first, last);
+				res.push_back({ first, last });
+			}
+			if (last + 1 < (int)m_vecTriangles.size())
+				res.push_back({ last + 1, (int)m_vecTriangles.size() - 1 });
+			return res;
+		}
+
+		AABB<T> TriangleBox(int ind) const
+		{
+			AABB<T> box;
+			for (int j = 0; j < 3; j++)
+				box.Expand(m_vecAllPoints[m_vecTriangles[ind].ind[j]]);
+			return box;
+		}
+
+		inline const BVH<T>& Acceleration() const { return m_bvh; }
+
+		//pool used for background rebuilds of the acceleration structure, nullptr disables them
+		inline void SetThreadPool(ThreadPool* tp) { m_pThreadPool = tp; }
+
+		//takes over a finished background rebuild, returns true if the structure was replaced
+		bool SyncAcceleration()
+		{
+			return m_bvh.AdoptRebuild([this](int i) { return TriangleBox(i); });
+		}
+
+		//moves vertices of surface by mtx and refits only its part of the acceleration structure,
+		//vertices are not shared between surfaces by any producer of this class
+		void TransformSurface(int surf, const Matrix<T>& mtx)
+		{
+			int first, last;
+			SurfaceRange(surf, first, last);
+			std::vector<int> verts;
+			verts.reserve(3 * (last - first + 1));
+			for (int i = first; i <= last; i++)
+				verts.insert(verts.end(), m_vecTriangles[i].ind, m_vecTriangles[i].ind + 3);
+			std::sort(verts.begin(), verts.end());
+			verts.erase(std::unique(verts.begin(), verts.end()), verts.end());
+			for (int v : verts)
+			{
+				m_vecAllPoints[v] = m_vecAllPoints[v] * mtx;
+				if (v < (int)m_vecAllNormals.size())
+					m_vecAllNormals[v] = m_vecAllNormals[v] * mtx;
+			}
+
+			UpdateFaceNormals(first, last + 1);
+			UpdateSurfaceBounds(surf, surf + 1);
+			std::vector<int> tris(last - first + 1);
+			for (int i = first; i <= last; i++)
+				tris[i - first] = i;
+			m_bvh.Refit(tris, [this](int i) { return TriangleBox(i); });
+			UpdateAcceleration();
+		}
+
+		//sorts triangles of every surface along the Morton curve of their centroids and renumbers vertices
+		//by first use, so triangles close in space are close in memory; surfaces keep their ranges
+		void OptimizeLayout(ThreadPool* tp = nullptr)
+		{
+			int nt = m_vecTriangles.size();
+			auto parallel = [tp](int from, int to, auto body, int grain) {
+				if (tp)
+					tp->ParallelFor(from, to, body, grain);
+				else
+					body(from, to);
+			};
+			AABB<T> box = Bounds();
+			std::vector<uint64_t> keys(nt);
+			parallel(0, nt, [&](int from, int to) {
+				for (int i = from; i < to; i++)
+				{
+					const Triangle& t = m_vecTriangles[i];
+					const Point<T>& a = m_vecAllPoints[t.ind[0]];
+					const Point<T>& b = m_vecAllPoints[t.ind[1]];
+					const Point<T>& c = m_vecAllPoints[t.ind[2]];
+					keys[i] = MortonCode63(Point<T>((a.X() + b.X() + c.X()) / 3, (a.Y() + b.Y() + c.Y()) / 3, (a.Z() + b.Z() + c.Z()) / 3), box);
+				}
+			}, 4096);
+
+			std::vector<int> perm(nt);
+			for (int i = 0; i < nt; i++)
+				perm[i] = i;
+			auto ranges = SurfaceRanges();
+			parallel(0, ranges.size(), [&](int from, int to) {
+				for (int s = from; s < to; s++)
+					std::stable_sort(perm.begin() + ranges[s].first, perm.begin() + ranges[s].second + 1, [&keys](int a, int b) { return keys[a] < keys[b]; });
+			}, 1);
+
+			std::vector<Triangle> tris(nt);
+			std::vector<Vector<T>> faceNormals(nt);
+			for (int i = 0; i < nt; i++)
+			{
+				tris[i] = m_vecTriangles[perm[i]];
+				faceNormals[i] = m_vecFaceNormals[perm[i]];
+			}
+			std::vector<int> newIndex, order;
+			NumberByFirstUse(tris, newIndex, order);
+			std::vector<Point<T>> pts(order.size());
+			std::vector<Vector<T>> norms(m_vecAllNormals.empty() ? 0 : order.size());
+			parallel(0, order.size(), [&](int from, int to) {
+				for (int v = from; v < to; v++)
+				{
+					pts[v] = m_vecAllPoints[order[v]];
+					if (!norms.empty())
+						norms[v] = m_vecAllNormals[order[v]];
+				}
+			}, 4096);
+			parallel(0, nt, [&](int from, int to) {
+				for (int i = from; i < to; i++)
+					for (int j = 0; j < 3; j++)
+						tris[i].ind[j] = newIndex[tris[i].ind[j]];
+			}, 4096);
+
+			m_vecAllPoints.swap(pts);
+			m_vecAllNormals.swap(norms);
+			m_vecTriangles.swap(tris);
+			m_vecFaceNormals.swap(faceNormals);
+			m_bvh.Build(SurfaceRanges(), [this](int i) { return TriangleBox(i); }, tp);
+			UpdateAcceleration();
+		}
+
+		//Quadric error decimation down to targetTriangles, or as far as vertices stay within maxError of the original
+		//triangles around them; see simplification::Decimator. Borders between surfaces and open edges are kept in
+		//place up to sliding along themselves, surfaces keep their order and a vertex keeps its normal. Vertices that
+		//are no longer used are dropped. Returns the number of triangles left.
+		int Simplify(int targetTriangles, T maxError = std::numeric_limits<T>::max(), ThreadPool* tp = nullptr)
+		{
+			auto ranges = SurfaceRanges();
+			int nt = m_vecTriangles.size();
+			std::vector<int> corners(3 * nt), surfaces(nt);
+			for (int s = 0; s < (int)ranges.size(); s++)
+				for (int t = ranges[s].first; t <= ranges[s].second; t++)
+				{
+					surfaces[t] = s;
+					for (int j = 0; j < 3; j++)
+						corners[3 * t + j] = m_vecTriangles[t].ind[j];
+				}
+			simplification::Decimator<T> dec(m_vecAllPoints, corners, surfaces);
+			dec.Simplify(targetTriangles, maxError, tp);
+
+			std::vector<Triangle> tris;
+			std::vector<int> lastOfSurface;
+			for (int s = 0; s < (int)ranges.size(); s++)
+			{
+				for (int t = ranges[s].first; t <= ranges[s].second; t++)
+				{
+					const auto& f = dec.m_vecFaces[t];
+					if (f.alive)
+						tris.push_back({ dec.CopyOf(f.v[0], s), dec.CopyOf(f.v[1], s), dec.CopyOf(f.v[2], s) });
+				}
+				if (s < (int)m_vecLastOfSurface.size())
+					lastOfSurface.push_back(tris.size() - 1);
+			}
+			std::vector<int> newIndex, order;
+			NumberByFirstUse(tris, newIndex, order);
+			int used = 0;
+			for (Triangle& t : tris)
+				for (int j = 0; j < 3; j++)
+				{
+					t.ind[j] = newIndex[t.ind[j]];
+					used = std::max(used, t.ind[j] + 1);
+				}
+			std::vector<Point<T>> pts(used);
+			std::vector<Vector<T>> norms(m_vecAllNormals.empty() ? 0 : used);
+			for (int v = 0; v < used; v++)
+			{
+				pts[v] = m_vecAllPoints[order[v]];
+				if (!norms.empty())
+					norms[v] = m_vecAllNormals[order[v]];
+			}
+
+			m_vecAllPoints.swap(pts);
+			m_vecAllNormals.swap(norms);
+			m_vecTriangles.swap(tris);
+			m_vecLastOfSurface.swap(lastOfSurface);
+			UpdateFaceNormals(0, m_vecTriangles.size(), tp);
+			UpdateSurfaceBounds(0, m_vecLastOfSurface.size(), tp);
+			RebuildAcceleration(tp);
+			return m_vecTriangles.size();
+		}
+
 		std::vector<Point<T>> GetPointsOfTriangle(int ind) {
 			std::vector<Point<T>> res = { m_vecAllPoints[m_vecTriangles[ind].ind[0]],
 										  m_vecAllPoints[m_vecTriangles[ind].ind[1]],
@@ -82,27 +601,76 @@ namespace geomlib
 
 		bool IntersectsTriangle(int ind, const Ray<T>& ray, Point<T>& pt) const
 		{
-			auto check = Plane<T>(m_vecAllPoints[m_vecTriangles[ind].ind[0]], NormalToTriangle(ind)).FindIntersections(ray);
-			if (check.size() == 0) 
-				return false;
-			Point<T> p = check[0];
-			Vector<T> n1 = NormalToCoords(m_vecAllPoints[m_vecTriangles[ind].ind[0]], m_vecAllPoints[m_vecTriangles[ind].ind[1]], p);
-			Vector<T> n2 = NormalToCoords(m_vecAllPoints[m_vecTriangles[ind].ind[1]], m_vecAllPoints[m_vecTriangles[ind].ind[2]], p);
-			Vector<T> n3 = NormalToCoords(m_vecAllPoints[m_vecTriangles[ind].ind[2]], m_vecAllPoints[m_vecTriangles[ind].ind[0]], p);
+			T param;
+			return IntersectsTriangle(ind, ray, pt, param);
+		}
 
-			if (!Epsilon::IsZero(n1.DotProduct(n2) - 1) || !Epsilon::IsZero(n1.DotProduct(n3) - 1)) return false;
-			pt = p;
+		//param is the parameter of pt along ray; Moller-Trumbore against the cached face normal, nothing is normalized per test
+		bool IntersectsTriangle(int ind, const Ray<T>& ray, Point<T>& pt, T& param) const
+		{
+			//relative margin of barycentric coordinates, so that rays through shared edges are not lost
+			const T tol = 1e-9;
+			const Vector<T>& dir = ray.Direction();
+			if (std::abs(dir.DotProduct(m_vecFaceNormals[ind])) <= Epsilon::EpsPow2())
+				return false;
+			const Point<T>& a = m_vecAllPoints[m_vecTriangles[ind].ind[0]];
+			Vector<T> e1 = m_vecAllPoints[m_vecTriangles[ind].ind[1]] - a, e2 = m_vecAllPoints[m_vecTriangles[ind].ind[2]] - a, s = ray.Start() - a;
+			Vector<T> p = dir.CrossProduct(e2);
+			T det = e1.DotProduct(p);
+			if (det == 0)
+				return false;
+			T u = s.DotProduct(p) / det;
+			if (u < -tol || u > 1 + tol)
+				return false;
+			Vector<T> q = s.CrossProduct(e1);
+			T v = dir.DotProduct(q) / det;
+			if (v < -tol || u + v > 1 + tol)
+				return false;
+			T t = e2.DotProduct(q) / det;
+			//a start point within eps behind the plane still counts, as for Ray::Belongs
+			if (t < 0 && t * t * dir.LengthPow2() > Epsilon::EpsPow2())
+				return false;
+			pt = ray.Start() + t * dir;
+			param = t;
 			return true;
 		}
 
+		//closest hit through the acceleration structure
+		bool FindIntersectionAccelerated(const Ray<T>& ray, Point<T>& pt, int& ind) const
+		{
+			T tmax = std::numeric_limits<T>::max();
+			Point<T> cur;
+			T t;
+			int pos = -1, tested = 0, rejected = 0;
+			m_bvh.Traverse(ray, tmax, [&](int tri, T& tm) {
+				tested++;
+				if (IntersectsTriangle(tri, ray, cur, t))
+				{
+					if (t < tm)
+					{
+						tm = t;
+						pt = cur;
+						pos = tri;
+					}
+					else
+						rejected++;
+				}
+			});
+			COUNT_EVENT(TrianglesTested, tested);
+			COUNT_EVENT(HitsRejected, rejected);
+			ind = pos;
+			return pos >= 0;
+		}
+
+		//whole model queries go through the acceleration structure, explicit ranges are scanned linearly
 		bool FindIntersection(const Ray<T>& ray, Point<T>& pt, int& ind, int left = 0, int right = INT_MAX) const
 		{
-			START_AUTO_TIMER(parallel3);
-			std::cout << left << " " << right << std::endl;
+			if (left == 0 && right == INT_MAX && !m_bvh.IsEmpty())
+				return FindIntersectionAccelerated(ray, pt, ind);
 
 			Point<T> ans(DBL_MAX, DBL_MAX, DBL_MAX), cur(DBL_MAX, DBL_MAX, DBL_MAX);
 			T dist = DBL_MAX;
-			int pos = -1, lim = std::min(right, (int)m_vecTriangles.size());
+			int pos = -1, lim = std::min(right, (int)m_vecTriangles.size()), rejected = 0;
 			for (int i = left; i < lim; i++)
 			{
 				if (IntersectsTriangle(i, ray, cur))
@@ -113,16 +681,211 @@ namespace geomlib
 						pos = i;
 						dist = newDist;
 					}
+					else
+						rejected++;
 				}
 			}
+			COUNT_EVENT(TrianglesTested, std::max(0, lim - left));
+			COUNT_EVENT(HitsRejected, rejected);
 			pt = ans;
 			ind = pos;
-			if (dist == INT_MAX)
-				return false;
-			return true;
+			return pos >= 0;
+		}
+
+		//closest hit of an asynchronous query, ind is -1 if nothing is hit
+		struct RayHit
+		{
+			Point<T> pt;
+			int ind = -1;
+		};
+
+		//closest hit computed on tp, the model must not change until the result is ready
+		Async<RayHit> FindIntersectionAsync(const Ray<T>& ray, ThreadPool& tp) const
+		{
+			return RunAsync(tp, [this, ray]() {
+				RayHit hit;
+				FindIntersection(ray, hit.pt, hit.ind);
+				return hit;
+			});
+		}
+
+		//closest hits of rays in chunks spread over tp, the last chunk to finish completes the result;
+		//after Cancel the chunks that have not started are skipped and the result is cancelled,
+		//an exception of a chunk fails the result once all chunks are over
+		Async<std::vector<RayHit>> FindIntersectionsAsync(std::vector<Ray<T>> rays, ThreadPool& tp, int chunk = 256) const
+		{
+			struct Batch
+			{
+				std::vector<Ray<T>> rays;
+				std::vector<RayHit> hits;
+				std::atomic<int> remaining;
+				std::mutex mtx;
+				std::exception_ptr error;
+			};
+			Promise<std::vector<RayHit>> promise;
+			int n = rays.size(), chunks = std::max(1, (n + chunk - 1) / chunk);
+			std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+			batch->rays = std::move(rays);
+			batch->hits.resize(n);
+			batch->remaining = chunks;
+			for (int c = 0; c < chunks; c++)
+			{
+				int from = c * chunk, to = std::min(n, from + chunk);
+				tp.AssignTask(std::make_shared<FunctionTask>([this, batch, promise, from, to]() mutable {
+					try
+					{
+						if (!promise.IsCancelled())
+							for (int i = from; i < to; i++)
+								FindIntersection(batch->rays[i], batch->hits[i].pt, batch->hits[i].ind);
+					}
+					catch (...)
+					{
+						std::lock_guard<std::mutex> lock(batch->mtx);
+						if (!batch->error)
+							batch->error = std::current_exception();
+					}
+					if (--batch->remaining == 0)
+					{
+						//the counter orders the other chunks before this one, their error is visible without the lock
+						if (batch->error)
+							promise.SetException(batch->error);
+						else if (promise.IsCancelled())
+							promise.SetCancelled();
+						else
+							promise.Set(std::move(batch->hits));
+					}
+				}));
+			}
+			return promise.GetAsync();
+		}
+
+		//Closest hits of a batch of rays, hits[i] belongs to rays[i]. With coherent set the rays are copied
+		//in CoherentRayOrder, queried in that order and the hits scattered back, which pays off for scattered
+		//rays on models that do not fit in cache.
+		void FindIntersections(std::span<const Ray<T>> rays, std::span<RayHit> hits, ThreadPool* tp = nullptr, bool coherent = true) const
+		{
+			int n = std::min(rays.size(), hits.size());
+			std::vector<int> order;
+			std::vector<Ray<T>> sorted;
+			std::vector<RayHit> found;
+			if (coherent)
+			{
+				order = CoherentRayOrder<T>(rays.first(n), tp);
+				sorted.resize(n);
+				found.resize(n);
+			}
+			auto query = [&](int from, int to) {
+				if (!coherent)
+				{
+					for (int i = from; i < to; i++)
+						FindIntersection(rays[i], hits[i].pt, hits[i].ind);
+					return;
+				}
+				//gathered first, the queries then read their rays in sequence
+				for (int i = from; i < to; i++)
+					sorted[i] = rays[order[i]];
+				for (int i = from; i < to; i++)
+					FindIntersection(sorted[i], found[i].pt, found[i].ind);
+				for (int i = from; i < to; i++)
+					hits[order[i]] = found[i];
+			};
+			//consecutive rays stay on one thread to keep their locality
+			if (tp)
+				tp->ParallelFor(0, n, query, 256);
+			else
+				query(0, n);
+		}
+
+		//Whether pt is inside the closed surface formed by all triangles, points on the surface count as inside.
+		//Crossings of a ray from pt are counted through the acceleration structure; a ray that grazes an edge,
+		//a vertex or the plane of a triangle gives no answer, so the next of a few fixed directions is tried.
+		bool Contains(const Point<T>& pt, T eps = Epsilon::Eps()) const
+		{
+			//directions are far from the axes and from each other, models are often aligned to both
+			static const T dirs[4][3] = { { 0.5124, 0.6987, 0.4993 }, { -0.6203, 0.3519, -0.7010 }, { 0.2467, -0.8355, -0.4909 }, { -0.7702, -0.2894, 0.5683 } };
+			int res = 0;
+			for (auto& d : dirs)
+			{
+				res = CrossingParity(pt, Vector<T>(d[0], d[1], d[2]).Normalize(), eps);
+				if (res >= 0)
+					return res == 1;
+			}
+			//every direction was ambiguous, the last count is the best guess
+			return -res - 2 == 1;
+		}
+
+		//Contains for many points, inside[i] is set for pts[i]; returns the number of points inside.
+		//Points are classified in Morton order, so that the rays of consecutive points meet the same nodes.
+		int Contains(std::span<const Point<T>> pts, std::span<char> inside, ThreadPool* tp = nullptr, T eps = Epsilon::Eps()) const
+		{
+			int n = std::min(pts.size(), inside.size());
+			std::vector<int> order = MortonPointOrder<T>(pts.first(n), tp);
+			std::atomic<int> count{ 0 };
+			auto classify = [&](int from, int to) {
+				int local = 0;
+				for (int i = from; i < to; i++)
+				{
+					inside[order[i]] = Contains(pts[order[i]], eps);
+					local += inside[order[i]];
+				}
+				count += local;
+			};
+			if (tp)
+				tp->ParallelFor(0, n, classify, 1024);
+			else
+				classify(0, n);
+			return count;
 		}
 
 	private:
+		//Parity of the crossings of the ray from pt along the unit vector dir: 1 if odd or pt is on a triangle, 0 if even.
+		//Ambiguous rays give -2 - parity.
+		int CrossingParity(const Point<T>& pt, const Vector<T>& dir, T eps) const
+		{
+			//relative margin of barycentric coordinates and of the cosine to the plane
+			const T tol = 1e-9;
+			int crossings = 0;
+			bool onSurface = false, ambiguous = false;
+			auto visit = [&](int tri, T&) {
+				const Point<T>& a = m_vecAllPoints[m_vecTriangles[tri].ind[0]];
+				Vector<T> e1 = m_vecAllPoints[m_vecTriangles[tri].ind[1]] - a, e2 = m_vecAllPoints[m_vecTriangles[tri].ind[2]] - a, s = pt - a;
+				Vector<T> p = dir.CrossProduct(e2);
+				T det = e1.DotProduct(p);
+				if (std::abs(det) <= tol * e1.CrossProduct(e2).Length())
+				{
+					//the ray runs along the plane, it matters only if it lies in it
+					if (std::abs(s.DotProduct(m_vecFaceNormals[tri])) <= eps)
+						ambiguous = true;
+					return;
+				}
+				Vector<T> q = s.CrossProduct(e1);
+				T u = s.DotProduct(p) / det, v = dir.DotProduct(q) / det, t = e2.DotProduct(q) / det;
+				if (u < -tol || v < -tol || u + v > 1 + tol || t < -eps)
+					return;
+				if (t <= eps)
+					onSurface = true;
+				else if (u <= tol || v <= tol || u + v >= 1 - tol)
+					ambiguous = true;
+				else
+					crossings++;
+			};
+			if (m_bvh.IsEmpty())
+			{
+				T tmax = std::numeric_limits<T>::max();
+				for (int i = 0; i < (int)m_vecTriangles.size(); i++)
+					visit(i, tmax);
+			}
+			else
+			{
+				//tmax stays unlimited, every crossing is needed and not only the closest one
+				T tmax = std::numeric_limits<T>::max();
+				m_bvh.Traverse(Ray<T>(pt, dir), tmax, visit);
+			}
+			if (onSurface)
+				return 1;
+			return ambiguous ? -2 - crossings % 2 : crossings % 2;
+		}
+
 		class TriangleTask : public ThreadTask
 		{
 		private:
@@ -219,15 +982,17 @@ namespace geomlib
 
 		void SplitCylinder(const Cylinder<T>& cyl, T h, T deviation)
 		{
+			int surfaces = m_vecLastOfSurface.size();
 			int n = acos(-1) / acos(1 - deviation / cyl.Radius()) + 1;
 			T angle = 2 * acos(-1) / n;
 			Vector<T> cur = cyl.Direction().GetOrthogonal() * cyl.Radius();
 			Vector<T> norm = cyl.Direction().Opposite();
+			Quaternion<T> step = Quaternion<T>::RotationInit(cyl.Direction(), angle);
 			for (int i = 0; i < n; i++)
 			{
 				m_vecAllPoints.push_back(cyl.Start() + cur);
 				m_vecAllNormals.push_back(norm);
-				cur = cur.Rotate(cyl.Direction(), angle);
+				cur = step.Rotate(cur);
 			}
 			m_vecAllPoints.push_back(cyl.Start());
 			m_vecAllNormals.push_back(norm);
@@ -238,9 +1003,10 @@ namespace geomlib
 				m_vecAllPoints.push_back(m_vecAllPoints[i] + toUpper);
 				m_vecAllNormals.push_back(norm);
 			}
+			//the bottom faces away from the cylinder, as its normals do
 			for (int i = 0; i < n; i++)
 			{
-				m_vecTriangles.push_back({ i, (i + 1) % n, n });
+				m_vecTriangles.push_back({ (i + 1) % n, i, n });
 			}
 			m_vecLastOfSurface.push_back(n - 1);
 
@@ -260,12 +1026,15 @@ namespace geomlib
 
 			for (int i = 2 * (n + 1); i < 3 * (n + 1); i++)
 			{
-				m_vecAllNormals.push_back(m_vecAllPoints[i] - m_vecAllPoints[3 * n + 2]);
+				m_vecAllNormals.push_back((m_vecAllPoints[i] - m_vecAllPoints[3 * n + 2]).Normalize());
 			}
 			for (int i = 3 * (n + 1); i < 4 * (n + 1); i++)
 			{
-				m_vecAllNormals.push_back(m_vecAllPoints[i] - m_vecAllPoints[4 * n + 3]);
+				m_vecAllNormals.push_back((m_vecAllPoints[i] - m_vecAllPoints[4 * n + 3]).Normalize());
 			}
+			UpdateFaceNormals(surfaces ? m_vecLastOfSurface[surfaces - 1] + 1 : 0, m_vecTriangles.size());
+			UpdateSurfaceBounds(surfaces, m_vecLastOfSurface.size());
+			InsertSurfaces(surfaces);
 		}
 
 		std::string ToString() const
@@ -335,6 +1104,183 @@ namespace geomlib
 			m_vecLastOfSurface.resize(n);
 			for (auto& q : m_vecLastOfSurface)
 				in.read((char*)&q, sizeof(int));
+			UpdateFaceNormals(0, m_vecTriangles.size());
+			UpdateSurfaceBounds(0, m_vecLastOfSurface.size());
+			m_bvh.Build(SurfaceRanges(), [this](int i) { return TriangleBox(i); });
+		}
+
+		AABB<T> Bounds() const
+		{
+			AABB<T> box;
+			for (const Point<T>& p : m_vecAllPoints)
+				box.Expand(p);
+			return box;
+		}
+
+		//Compact archive format. Positions are quantized to posBits per axis within the model bounds,
+		//so every coordinate is restored with an error of at most half of (extent / (2^posBits - 1)).
+		//Normals are octahedral with normBits per component. Triangles are reordered for the vertex cache
+		//inside every surface, vertices are renumbered by first use and every index is written as a varint
+		//of its distance to the next unused vertex.
+		void SerializeCompressed(std::ostream& out, int posBits = 16, int normBits = 12) const
+		{
+			int nv = m_vecAllPoints.size(), nt = m_vecTriangles.size(), ns = m_vecLastOfSurface.size();
+			std::vector<Triangle> tris = m_vecTriangles;
+			std::vector<int> local(nv, -1);
+			for (auto& r : SurfaceRanges())
+				OptimizeVertexCache(tris.data() + r.first, r.second - r.first + 1, local);
+
+			std::vector<int> newIndex, order;
+			NumberByFirstUse(tris, newIndex, order);
+
+			AABB<T> box = Bounds();
+			T mn[3] = { 0, 0, 0 }, step[3] = { 0, 0, 0 };
+			if (nv)
+			{
+				Vector<T> ext = box.Extent();
+				T levels = (T)((1ull << posBits) - 1);
+				mn[0] = box.Min().X(); mn[1] = box.Min().Y(); mn[2] = box.Min().Z();
+				step[0] = ext.X() / levels; step[1] = ext.Y() / levels; step[2] = ext.Z() / levels;
+			}
+			int hasNormals = (int)m_vecAllNormals.size() == nv && nv > 0;
+
+			std::vector<unsigned char> buf;
+			buf.reserve(nv * (3 * posBits + 2 * normBits) / 8 + 3 * nt + ns + 16);
+			BitWriter bits(buf);
+			for (int v : order)
+			{
+				const Point<T>& p = m_vecAllPoints[v];
+				T c[3] = { p.X(), p.Y(), p.Z() };
+				for (int k = 0; k < 3; k++)
+					bits.Write(step[k] > 0 ? (uint32_t)std::llround((c[k] - mn[k]) / step[k]) : 0, posBits);
+			}
+			bits.Flush();
+			if (hasNormals)
+			{
+				T levels = (T)((1ull << normBits) - 1);
+				for (int v : order)
+				{
+					T u, w;
+					OctahedralEncode(m_vecAllNormals[v], u, w);
+					bits.Write((uint32_t)std::llround((u + 1) / 2 * levels), normBits);
+					bits.Write((uint32_t)std::llround((w + 1) / 2 * levels), normBits);
+				}
+				bits.Flush();
+			}
+			int nextNew = 0;
+			for (const Triangle& t : tris)
+				for (int j = 0; j < 3; j++)
+				{
+					int idx = newIndex[t.ind[j]];
+					WriteVarint(buf, nextNew - idx);
+					if (idx == nextNew)
+						nextNew++;
+				}
+			for (int s = 0; s < ns; s++)
+				WriteVarint(buf, m_vecLastOfSurface[s] - (s ? m_vecLastOfSurface[s - 1] : -1));
+
+			int header[6] = { posBits, normBits, nv, hasNormals, nt, ns };
+			out.write((char*)header, sizeof(header));
+			out.write((char*)mn, sizeof(mn));
+			out.write((char*)step, sizeof(step));
+			int size = buf.size();
+			out.write((char*)&size, sizeof(int));
+			out.write((char*)buf.data(), size);
+		}
+
+		//Reads the format of SerializeCompressed in one linear pass over the payload. Returns false and leaves the
+		//model empty if the stream ends early or its counts, bit widths or indices do not fit together.
+		bool DeserializeCompressed(std::istream& in)
+		{
+			Clear();
+			int header[6], size;
+			T mn[3], step[3];
+			in.read((char*)header, sizeof(header));
+			in.read((char*)mn, sizeof(mn));
+			in.read((char*)step, sizeof(step));
+			in.read((char*)&size, sizeof(int));
+			if (!in || size < 0)
+				return false;
+			int posBits = header[0], normBits = header[1], nv = header[2], hasNormals = header[3], nt = header[4], ns = header[5];
+			if (posBits < 1 || posBits > 32 || normBits < 1 || normBits > 32 || nv < 0 || nt < 0 || ns < 0 || (hasNormals != 0 && hasNormals != 1))
+				return false;
+			//every vertex takes its bits, every triangle at least three bytes and every surface one,
+			//so the counts are checked against the payload before anything is sized by them
+			int64_t need = ((int64_t)nv * 3 * posBits + 7) / 8 + (hasNormals ? ((int64_t)nv * 2 * normBits + 7) / 8 : 0) + 3 * (int64_t)nt + ns;
+			if (need > size)
+				return false;
+			//the buffer grows with what was actually read, a corrupt size does not allocate ahead of the data
+			std::vector<unsigned char> buf;
+			const int chunk = 1 << 20;
+			for (int done = 0; done < size; done += chunk)
+			{
+				int part = std::min(chunk, size - done);
+				buf.resize(done + part);
+				in.read((char*)buf.data() + done, part);
+				if (!in)
+					return false;
+			}
+
+			m_vecAllPoints.resize(nv);
+			BitReader bits(buf.data(), buf.data() + size);
+			for (int v = 0; v < nv; v++)
+			{
+				T x = mn[0] + step[0] * bits.Read(posBits);
+				T y = mn[1] + step[1] * bits.Read(posBits);
+				T z = mn[2] + step[2] * bits.Read(posBits);
+				m_vecAllPoints[v] = Point<T>(x, y, z);
+			}
+			if (hasNormals)
+			{
+				bits = BitReader(bits.Position(), buf.data() + size);
+				m_vecAllNormals.resize(nv);
+				T scale = 2 / (T)((1ull << normBits) - 1);
+				for (int v = 0; v < nv; v++)
+				{
+					T u = bits.Read(normBits) * scale - 1;
+					T w = bits.Read(normBits) * scale - 1;
+					m_vecAllNormals[v] = OctahedralDecode(u, w);
+				}
+			}
+			const unsigned char* p = bits.Position();
+			const unsigned char* end = buf.data() + size;
+			m_vecTriangles.resize(nt);
+			int nextNew = 0;
+			uint32_t val;
+			for (Triangle& t : m_vecTriangles)
+				for (int j = 0; j < 3; j++)
+				{
+					if (!ReadVarint(p, end, val) || val > (uint32_t)nextNew || (val == 0 && nextNew == nv))
+					{
+						Clear();
+						return false;
+					}
+					int idx = nextNew - (int)val;
+					if (idx == nextNew)
+						nextNew++;
+					t.ind[j] = idx;
+				}
+			m_vecLastOfSurface.resize(ns);
+			for (int s = 0; s < ns; s++)
+			{
+				int prev = s ? m_vecLastOfSurface[s - 1] : -1;
+				if (!ReadVarint(p, end, val) || val == 0 || val > (uint32_t)(nt - 1 - prev))
+				{
+					Clear();
+					return false;
+				}
+				m_vecLastOfSurface[s] = prev + (int)val;
+			}
+			if ((ns ? m_vecLastOfSurface.back() : -1) != nt - 1)
+			{
+				Clear();
+				return false;
+			}
+
+			UpdateFaceNormals(0, m_vecTriangles.size());
+			UpdateSurfaceBounds(0, m_vecLastOfSurface.size());
+			m_bvh.Build(SurfaceRanges(), [this](int i) { return TriangleBox(i); });
+			return true;
 		}
 	};
 }
\ No newline at end of file
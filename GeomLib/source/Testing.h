@@ -2,12 +2,18 @@
 #include "Segment.h"
 #include "Line.h"
 #include "Ray.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
 #include <fstream>
+#include <iostream>
+#include <sstream>
 #include <string>
 #include <vector>
 #include <map>
 
-#define TESTING_SECTION_OPEN std::ofstream fout("test_log.txt");
+#define TESTING_SECTION_OPEN std::ofstream fout("test_log.txt"); PerfBaseline perfBaseline("perf_baseline.txt");
 
 #define TEST(name) fout << "Test \"""" << name << "\""" results:" << std::endl;
 
@@ -41,7 +47,22 @@
 		fout << "RTE with message " << std::endl << e.what() << std::endl;					\
 	};	
 
-#define TESTING_SECTION_CLOSE fout.close();
+//times the statements after samples, reports WA if the median is slower than the baseline by more than the tolerance
+#define SUBTEST_PERF(subname, samples, ...) fout << "	Subtest \"""" << subname << "\""": ";	\
+	try {																					\
+		fout << perfBaseline.Report(subname, PerfStats::Measure([&]() { __VA_ARGS__; }, samples)) << std::endl;	\
+	}																						\
+	catch (std::exception e) {																\
+		fout << "RTE with message " << std::endl << e.what() << std::endl;					\
+	};
+
+//allowed relative slowdown, 0.25 by default
+#define PERF_TOLERANCE(tolerance) perfBaseline.SetTolerance(tolerance);
+
+//stores the timings of this run as the new baseline
+#define PERF_UPDATE_BASELINE perfBaseline.SetUpdate(true);
+
+#define TESTING_SECTION_CLOSE fout.close(); perfBaseline.Save();
 
 template <class T, class S>
 class CheckEquality {
@@ -59,3 +80,114 @@ public:
 		return arg1 == arg2;
 	}
 };
+
+//Timings of a body, in nanoseconds per call. Warm-up doubles the number of calls in a batch until
+//a batch lasts a millisecond, then every sample times one batch; median and median absolute
+//deviation do not move with the few samples a context switch spoils.
+class PerfStats {
+public:
+	double m_dblMedian = 0;
+	double m_dblDeviation = 0;
+
+	template <class F>
+	static PerfStats Measure(F body, int samples)
+	{
+		using Clock = std::chrono::steady_clock;
+		int batch = 1;
+		while (batch < (1 << 24))
+		{
+			Clock::time_point start = Clock::now();
+			for (int i = 0; i < batch; i++)
+				body();
+			if (Clock::now() - start >= std::chrono::milliseconds(1))
+				break;
+			batch *= 2;
+		}
+		std::vector<double> times(std::max(samples, 1));
+		for (double& time : times)
+		{
+			Clock::time_point start = Clock::now();
+			for (int i = 0; i < batch; i++)
+				body();
+			time = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / batch;
+		}
+		PerfStats res;
+		res.m_dblMedian = Median(times);
+		for (double& time : times)
+			time = std::abs(time - res.m_dblMedian);
+		res.m_dblDeviation = Median(times);
+		return res;
+	}
+
+	static double Median(std::vector<double> vals)
+	{
+		std::nth_element(vals.begin(), vals.begin() + vals.size() / 2, vals.end());
+		return vals[vals.size() / 2];
+	}
+};
+
+//Median timings by subtest name, kept in a text file of "name<tab>nanoseconds" lines.
+//Names missing in the file are added, known ones change only after PERF_UPDATE_BASELINE.
+class PerfBaseline {
+protected:
+	std::string m_sPath;
+	double m_dblTolerance = 0.25;
+	bool m_bUpdate = false;
+	std::map<std::string, double> m_mapBaseline;
+	std::map<std::string, double> m_mapCurrent;
+public:
+	PerfBaseline(const std::string& path) : m_sPath(path)
+	{
+		std::ifstream in(path);
+		std::string line;
+		for (int num = 1; std::getline(in, line); num++)
+		{
+			if (line.find_first_not_of(" \t\r") == std::string::npos)
+				continue;
+			//a line that is not a name and a number is skipped, the rest of the baseline stays usable
+			size_t tab = line.rfind('\t');
+			double val = 0;
+			const char* end = line.data() + line.size();
+			std::from_chars_result res = { nullptr, std::errc::invalid_argument };
+			if (tab != std::string::npos && tab > 0)
+				res = std::from_chars(line.data() + tab + 1, end, val);
+			if (res.ec != std::errc() || std::any_of(res.ptr, end, [](char c) { return c != ' ' && c != '\r'; }))
+			{
+				std::cerr << "Skipping malformed line " << num << " of " << path << std::endl;
+				continue;
+			}
+			m_mapBaseline[line.substr(0, tab)] = val;
+		}
+	}
+
+	void SetTolerance(double tolerance) { m_dblTolerance = tolerance; }
+	void SetUpdate(bool update) { m_bUpdate = update; }
+
+	//a regression has to exceed both the tolerance and three deviations of this run
+	std::string Report(const std::string& name, const PerfStats& stats)
+	{
+		m_mapCurrent[name] = stats.m_dblMedian;
+		std::stringstream out;
+		auto known = m_mapBaseline.find(name);
+		bool slow = known != m_mapBaseline.end() && stats.m_dblMedian > known->second * (1 + m_dblTolerance) &&
+			stats.m_dblMedian - known->second > 3 * stats.m_dblDeviation;
+		out << (slow ? "WA" : "OK") << " (median " << stats.m_dblMedian << " ns, deviation " << stats.m_dblDeviation << " ns";
+		if (known != m_mapBaseline.end())
+			out << ", baseline " << known->second << " ns";
+		else
+			out << ", new baseline";
+		out << ")";
+		return out.str();
+	}
+
+	void Save() const
+	{
+		std::map<std::string, double> res = m_mapBaseline;
+		for (auto& p : m_mapCurrent)
+			if (m_bUpdate || !res.count(p.first))
+				res[p.first] = p.second;
+		std::ofstream out(m_sPath);
+		for (auto& p : res)
+			out << p.first << '\t' << p.second << std::endl;
+	}
+};
\ No newline at end of file
@@ -1,11 +1,15 @@
 #pragma once
 #include "Timer.h"
+#include "Counters.h"
 #include <condition_variable>
 #include <functional>
 #include <vector>
 #include <thread>
+#include <algorithm>
 #include <atomic>
+#include <exception>
 #include <future>
+#include <memory>
 #include <queue>
 #include <set>
 
@@ -23,6 +27,83 @@ namespace geomlib
 		ThreadTask() : Id(0) { }
 	};
 
+	//counts unfinished tasks of one batch, so that the caller waits only for them and not for the whole pool
+	class TaskGroup
+	{
+	private:
+		std::mutex mtx;
+		std::condition_variable cv;
+		int pending = 0;
+		std::exception_ptr error;
+
+	public:
+		void Add(int num)
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			pending += num;
+		}
+		void Done()
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			if (--pending == 0)
+			{
+				lock.unlock();
+				cv.notify_all();
+			}
+		}
+		bool IsDone()
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			return pending == 0;
+		}
+		void Wait()
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			cv.wait(lock, [this]() { return pending == 0; });
+		}
+		//keeps the first exception thrown by a task of the group
+		void Fail(std::exception_ptr err)
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (!error)
+				error = err;
+		}
+		std::exception_ptr Error()
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			return error;
+		}
+	};
+
+	class FunctionTask : public ThreadTask
+	{
+	private:
+		std::function<void()> func;
+		std::shared_ptr<TaskGroup> group;
+
+	public:
+		FunctionTask(std::function<void()> _func, const std::shared_ptr<TaskGroup>& _group = nullptr) : func(std::move(_func)), group(_group) {}
+		void ToDo() override
+		{
+			//the group is finished even if func throws, otherwise its waiter never returns
+			struct DoneGuard
+			{
+				TaskGroup* group;
+				~DoneGuard() { if (group) group->Done(); }
+			} guard{ group.get() };
+			try
+			{
+				func();
+			}
+			catch (...)
+			{
+				if (!group)
+					throw;
+				group->Fail(std::current_exception());
+			}
+		}
+	};
+
 	class ThreadPool
 	{
 	private:
@@ -33,7 +114,7 @@ namespace geomlib
 		std::condition_variable cvAssigner;
 		std::condition_variable cvFinish;
 		bool end = false;
-		int taskIndex = 0;
+		std::atomic<int> taskIndex{ 0 };
 		std::mutex mtxCompleted;
 		std::mutex mtxAvailable;
 		std::mutex mtxIndex;
@@ -41,22 +122,50 @@ namespace geomlib
 		std::atomic<bool> stop;
 		friend class ThreadTask;
 
+		//after stop the queue is still drained, so every assigned task runs and completes its results
 		void Run()
 		{
-			while (!stop) {
+			while (true) {
 				std::unique_lock<std::mutex> qLock(mtxQueue);
 				cvAssigner.wait(qLock, [this]()->bool { return !qTasks.empty() || stop; });
-				if (!qTasks.empty())
-				{
-					std::shared_ptr<ThreadTask> task = std::move(qTasks.front());
-					qTasks.pop();
-					qLock.unlock();
-					task->RunTask();
+				if (qTasks.empty())
+					return;
+				std::shared_ptr<ThreadTask> task = std::move(qTasks.front());
+				qTasks.pop();
+				qLock.unlock();
+				Execute(task);
+			}
+		}
 
-					completed++;
-					cvFinish.notify_all();
-				}
+		void Execute(const std::shared_ptr<ThreadTask>& task)
+		{
+			try
+			{
+				task->RunTask();
 			}
+			catch (...)
+			{
+				//a task without a group has nobody to report to, it still counts as completed so WaitEnd returns
+			}
+
+			//counter is changed under the lock, otherwise WaitEnd may miss the notification
+			std::unique_lock<std::mutex> fin(mtxCompleted);
+			completed++;
+			fin.unlock();
+			cvFinish.notify_all();
+		}
+
+		//runs one queued task on the calling thread, returns false if the queue is empty
+		bool RunOne()
+		{
+			std::unique_lock<std::mutex> qLock(mtxQueue);
+			if (qTasks.empty())
+				return false;
+			std::shared_ptr<ThreadTask> task = std::move(qTasks.front());
+			qTasks.pop();
+			qLock.unlock();
+			Execute(task);
+			return true;
 		}
 
 	public:
@@ -79,23 +188,76 @@ namespace geomlib
 			cvAssigner.notify_one();
 		}
 
+		inline int ThreadCount() const { return (int)vecThreads.size(); }
+
+		//waits for the tasks of group only, the calling thread helps with queued tasks meanwhile,
+		//so it is safe to call from inside a task of this pool
+		void Wait(TaskGroup& group)
+		{
+			while (!group.IsDone())
+			{
+				if (RunOne())
+				{
+					COUNT_EVENT(TasksStolen, 1);
+				}
+				else
+				{
+					//the rest of the group is already taken by workers
+					COUNT_WAIT_SCOPE;
+					group.Wait();
+				}
+			}
+		}
+
+		//splits [begin, end) into chunks of at least grain elements and runs body(from, to) on them in parallel;
+		//the first exception thrown by body is rethrown once every chunk has finished
+		template <class F>
+		void ParallelFor(int begin, int end, F body, int grain = 1)
+		{
+			if (end <= begin)
+				return;
+			int chunks = std::max(1, std::min((end - begin + grain - 1) / grain, 4 * std::max(1, ThreadCount())));
+			if (chunks == 1)
+			{
+				body(begin, end);
+				return;
+			}
+			int size = (end - begin + chunks - 1) / chunks;
+			std::shared_ptr<TaskGroup> group = std::make_shared<TaskGroup>();
+			group->Add(chunks);
+			for (int i = 0; i < chunks; i++)
+			{
+				int from = std::min(end, begin + i * size), to = std::min(end, from + size);
+				AssignTask(std::make_shared<FunctionTask>([&body, from, to]() { if (from < to) body(from, to); }, group));
+			}
+			Wait(*group);
+			if (std::exception_ptr err = group->Error())
+				std::rethrow_exception(err);
+		}
+
 		void WaitEnd()
 		{
+			COUNT_WAIT_SCOPE;
 			std::unique_lock<std::mutex> fin(mtxCompleted);
+			//every assigned task is completed only when the queue is empty too, so the queue is not read here without its lock
 			cvFinish.wait(fin, [this]()->bool 
 				{
-					return qTasks.empty() && taskIndex == completed;
+					return taskIndex == completed;
 				});
 		}
 
 		~ThreadPool()
 		{
+			std::unique_lock<std::mutex> qLock(mtxQueue);
 			stop = true;
+			qLock.unlock();
 			cvAssigner.notify_all();
 			for (int i = 0; i < vecThreads.size(); i++)
 			{
 				vecThreads[i].join();
 			}
+			//a pool without threads runs what is left itself
+			while (RunOne());
 		}
 
 	};
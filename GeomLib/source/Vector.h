@@ -12,9 +12,9 @@ namespace geomlib
 	class Vector : public Coordinates<T>
 	{
 	public:
-		Vector() : Coordinates<T>() {};
-		Vector(T xx, T yy, T zz = 0) : Coordinates<T>(xx, yy, zz) {};
-		Vector(T* begin) : Coordinates<T>(begin) {};
+		constexpr Vector() : Coordinates<T>() {};
+		constexpr Vector(T xx, T yy, T zz = 0) : Coordinates<T>(xx, yy, zz) {};
+		constexpr Vector(T* begin) : Coordinates<T>(begin) {};
 		bool operator== (const Vector<T>& rhs) const
 		{
 			return IsEqual(rhs);
@@ -24,7 +24,7 @@ namespace geomlib
 			return !IsEqual(rhs);
 		}
 		template <typename N, typename std::enable_if<(std::is_arithmetic<N>()), int>::type = 0>
-		Vector<T>& operator*= (N mul) {
+		constexpr Vector<T>& operator*= (N mul) {
 			this->SetX(this->X() * mul);
 			this->SetY(this->Y() * mul);
 			this->SetZ(this->Z() * mul);
@@ -38,7 +38,7 @@ namespace geomlib
 		{
 			return std::sqrt(this->X() * this->X() + this->Y() * this->Y() + this->Z() * this->Z());
 		}
-		T LengthPow2() const
+		constexpr T LengthPow2() const
 		{
 			return this->X() * this->X() + this->Y() * this->Y() + this->Z() * this->Z();
 		}
@@ -87,16 +87,16 @@ namespace geomlib
 			quatx /= val, quaty /= val, quatz /= val, quatw /= val;
 
 			T ansx = resw * quatx + resx * quatw + resy * quatz - resz * quaty;
-			T ansy = resw * quaty - resx * quatz + resy * quatw - resz * quatx;
+			T ansy = resw * quaty - resx * quatz + resy * quatw + resz * quatx;
 			T ansz = resw * quatz + resx * quaty - resy * quatx + resz * quatw;
 
 			return Vector<T>(ansx, ansy, ansz).Normalize() * len;
 		}
-		T DotProduct(const Vector<T>& vec) const
+		constexpr T DotProduct(const Vector<T>& vec) const
 		{
 			return this->X() * vec.X() + this->Y() * vec.Y() + this->Z() * vec.Z();
 		}
-		Vector<T> CrossProduct(const Vector<T>& vec) const
+		constexpr Vector<T> CrossProduct(const Vector<T>& vec) const
 		{
 			return Vector<T>(
 				this->Y() * vec.Z() - this->Z() * vec.Y(),
@@ -104,7 +104,7 @@ namespace geomlib
 				this->X() * vec.Y() - this->Y() * vec.X()
 				);
 		}
-		Vector<T> Opposite() const {
+		constexpr Vector<T> Opposite() const {
 			return Vector<T>(-this->X(), -this->Y(), -this->Z());
 		}
 		bool IsOpposite(const Vector<T>& vec, T eps = Epsilon::Eps()) const
@@ -125,7 +125,7 @@ namespace geomlib
 			}
 			return Vector<T>(0, this->Z(), -this->Y()).Normalize();
 		}
-		~Vector() {};
+		constexpr ~Vector() {};
 
 		std::string ToString() const override
 		{
@@ -137,17 +137,17 @@ namespace geomlib
 	};
 
 	FLOATING_AND_ARITHMETIC(T, N)
-	Vector<T> operator* (const Vector<T>& vec, N mul) {
+	constexpr Vector<T> operator* (const Vector<T>& vec, N mul) {
 		return Vector<T>(vec.X() * mul, vec.Y() * mul, vec.Z() * mul);
 	}
 
 	FLOATING_AND_ARITHMETIC(T, N)
-	Vector<T> operator* (N mul, const Vector<T>& vec) {
+	constexpr Vector<T> operator* (N mul, const Vector<T>& vec) {
 		return Vector<T>(vec.X() * mul, vec.Y() * mul, vec.Z() * mul);
 	}
 
 	FLOATING(T)
-	Vector<T> operator- (const Point<T>& lhs, const Point<T>& rhs)
+	constexpr Vector<T> operator- (const Point<T>& lhs, const Point<T>& rhs)
 	{
 		return Vector<T>(lhs.X() - rhs.X(), lhs.Y() - rhs.Y(), lhs.Z() - rhs.Z());
 	}
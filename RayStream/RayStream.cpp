@@ -0,0 +1,250 @@
+#include "../GeomLib/source/ThreadPool.h"
+#include "../GeomLib/source/TessModel.h"
+#include "../GeomLib/source/MeshIO.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+using namespace geomlib;
+
+//Streams rays through a model: a reader thread fills chunks, the pool intersects them and a writer
+//thread stores the hits, while a fixed set of chunk buffers is passed around between the three stages.
+//
+//  RayStream model.stl|model.obj [rays|-] [hits|-] [-threads N] [-chunk N] [-buffers N]
+//
+//A ray is 6 little-endian doubles: start x, y, z and direction x, y, z. A hit record is
+//uint64 ray index, int32 triangle (-1 for a miss), int32 surface and 3 doubles of the point.
+
+struct HitRecord
+{
+	uint64_t ray;
+	int32_t triangle;
+	int32_t surface;
+	double pt[3];
+};
+static_assert(sizeof(HitRecord) == 40, "hit records are written as they are in memory");
+
+struct Chunk
+{
+	uint64_t first = 0;
+	int count = 0;
+	std::vector<double> rays;
+	std::vector<HitRecord> hits;
+};
+
+//blocking queue between two stages, Pop returns false once the queue is closed and empty
+template <class V>
+class Channel
+{
+private:
+	std::mutex mtx;
+	std::condition_variable cv;
+	std::queue<V> items;
+	bool closed = false;
+
+public:
+	void Push(V item)
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		items.push(std::move(item));
+		cv.notify_one();
+	}
+
+	bool Pop(V& item)
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		cv.wait(lock, [this]() { return closed || !items.empty(); });
+		if (items.empty())
+			return false;
+		item = std::move(items.front());
+		items.pop();
+		return true;
+	}
+
+	void Close()
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		closed = true;
+		cv.notify_all();
+	}
+};
+
+static bool EndsWith(const std::string& str, const std::string& end)
+{
+	return str.size() >= end.size() && std::equal(end.rbegin(), end.rend(), str.rbegin(), [](char a, char b) { return std::tolower(a) == b; });
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::string> files;
+	int threads = std::thread::hardware_concurrency(), chunkSize = 1 << 16, buffers = 4;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-threads" && i + 1 < argc)
+			threads = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "-chunk" && i + 1 < argc)
+			chunkSize = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "-buffers" && i + 1 < argc)
+			buffers = std::max(2, std::atoi(argv[++i]));
+		else
+			files.push_back(arg);
+	}
+	if (files.empty())
+	{
+		std::cerr << "usage: RayStream model.stl|model.obj [rays|-] [hits|-] [-threads N] [-chunk N] [-buffers N]" << std::endl;
+		return 1;
+	}
+	files.resize(3, "-");
+
+	ThreadPool tp(threads);
+	TessModel<double> model;
+	bool loaded = EndsWith(files[0], ".obj") ? LoadOBJ(model, files[0], &tp) : LoadSTL(model, files[0], &tp);
+	if (!loaded)
+	{
+		std::cerr << "cannot load " << files[0] << std::endl;
+		return 1;
+	}
+	//loading with the pool already builds the linear BVH, so no second tree is built here
+
+#ifdef _WIN32
+	_setmode(_fileno(stdin), _O_BINARY);
+	_setmode(_fileno(stdout), _O_BINARY);
+#endif
+	std::ifstream inFile;
+	std::ofstream outFile;
+	if (files[1] != "-")
+		inFile.open(files[1], std::ios::binary);
+	if (files[2] != "-")
+		outFile.open(files[2], std::ios::binary);
+	std::istream& in = files[1] != "-" ? inFile : std::cin;
+	std::ostream& out = files[2] != "-" ? outFile : std::cout;
+	if (!in || !out)
+	{
+		std::cerr << "cannot open " << (!in ? files[1] : files[2]) << std::endl;
+		return 1;
+	}
+
+	//memory stays at buffers chunks whatever the size of the input
+	Channel<std::unique_ptr<Chunk>> spare, read, done;
+	for (int i = 0; i < buffers; i++)
+	{
+		std::unique_ptr<Chunk> chunk = std::make_unique<Chunk>();
+		chunk->rays.resize(6 * chunkSize);
+		chunk->hits.resize(chunkSize);
+		spare.Push(std::move(chunk));
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	//bytes of a ray record cut off at the end of the input, the rays before it are still queried
+	size_t partial = 0;
+	std::thread reader([&]() {
+		uint64_t next = 0;
+		std::unique_ptr<Chunk> chunk;
+		while (spare.Pop(chunk))
+		{
+			in.read((char*)chunk->rays.data(), chunk->rays.size() * sizeof(double));
+			size_t got = in.gcount();
+			partial = got % (6 * sizeof(double));
+			chunk->count = got / (6 * sizeof(double));
+			chunk->first = next;
+			next += chunk->count;
+			if (chunk->count == 0)
+				break;
+			read.Push(std::move(chunk));
+			if (!in)
+				break;
+		}
+		read.Close();
+	});
+
+	//after a failed write the chunks are only passed back, so the other stages still finish
+	uint64_t total = 0;
+	bool writeFailed = false;
+	std::thread writer([&]() {
+		std::unique_ptr<Chunk> chunk;
+		while (done.Pop(chunk))
+		{
+			if (!writeFailed)
+			{
+				out.write((const char*)chunk->hits.data(), chunk->count * sizeof(HitRecord));
+				writeFailed = !out;
+				if (!writeFailed)
+					total += chunk->count;
+			}
+			spare.Push(std::move(chunk));
+		}
+		if (!writeFailed)
+			writeFailed = !out.flush();
+	});
+
+	std::unique_ptr<Chunk> chunk;
+	while (read.Pop(chunk))
+	{
+		Chunk& cur = *chunk;
+		tp.ParallelFor(0, cur.count, [&cur, &model](int from, int to) {
+			for (int i = from; i < to; i++)
+			{
+				const double* r = &cur.rays[6 * i];
+				Ray<double> ray(Point<double>(r[0], r[1], r[2]), Vector<double>(r[3], r[4], r[5]));
+				Point<double> pt;
+				int ind = -1;
+				HitRecord& hit = cur.hits[i];
+				hit.ray = cur.first + i;
+				if (model.FindIntersection(ray, pt, ind))
+				{
+					hit.triangle = ind;
+					hit.surface = model.GetSurfaceByTriangle(ind);
+					hit.pt[0] = pt.X();
+					hit.pt[1] = pt.Y();
+					hit.pt[2] = pt.Z();
+				}
+				else
+				{
+					hit.triangle = hit.surface = -1;
+					hit.pt[0] = hit.pt[1] = hit.pt[2] = 0;
+				}
+			}
+		}, 256);
+		done.Push(std::move(chunk));
+	}
+	done.Close();
+	writer.join();
+	//the reader may still wait for a free buffer if the input ended exactly at a chunk border
+	spare.Close();
+	reader.join();
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cerr << total << " rays in " << seconds << " s, " << (seconds > 0 ? total / seconds / 1e6 : 0) << " Mrays/s" << std::endl;
+	if (in.bad())
+	{
+		std::cerr << "cannot read " << files[1] << std::endl;
+		return 1;
+	}
+	if (partial)
+	{
+		std::cerr << "input ends with a partial ray of " << partial << " bytes" << std::endl;
+		return 1;
+	}
+	if (writeFailed)
+	{
+		std::cerr << "cannot write " << files[2] << std::endl;
+		return 1;
+	}
+	return 0;
+}
\ No newline at end of file
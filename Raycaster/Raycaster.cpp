@@ -0,0 +1,94 @@
+#include "../GeomLib/source/ThreadPool.h"
+#include "../GeomLib/source/TessModel.h"
+#include "../GeomLib/source/MeshIO.h"
+#include "../GeomLib/source/Raycaster.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace geomlib;
+
+//Renders depth, normal and surface images of a model and reports the ray throughput; the camera looks at the
+//center of the model from a corner direction, far enough to see all of it.
+//
+//  Raycaster model.stl|model.obj [-size W H] [-tile N] [-threads N] [-fov degrees] [-repeat N] [-out prefix]
+//
+//Writes prefix_depth.pgm, prefix_depth.pfm, prefix_normals.pfm and prefix_surfaces.pgm.
+
+static bool EndsWith(const std::string& str, const std::string& end)
+{
+	return str.size() >= end.size() && std::equal(end.rbegin(), end.rend(), str.rbegin(), [](char a, char b) { return std::tolower(a) == b; });
+}
+
+int main(int argc, char** argv)
+{
+	std::string path, prefix = "raycast";
+	int width = 1024, height = 768, tile = 16, repeat = 3, threads = std::thread::hardware_concurrency();
+	double fov = 40;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-size" && i + 2 < argc)
+		{
+			width = std::max(1, std::atoi(argv[++i]));
+			height = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (arg == "-tile" && i + 1 < argc)
+			tile = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "-threads" && i + 1 < argc)
+			threads = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "-fov" && i + 1 < argc)
+			fov = std::atof(argv[++i]);
+		else if (arg == "-repeat" && i + 1 < argc)
+			repeat = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "-out" && i + 1 < argc)
+			prefix = argv[++i];
+		else
+			path = arg;
+	}
+	if (path.empty())
+	{
+		std::cerr << "usage: Raycaster model.stl|model.obj [-size W H] [-tile N] [-threads N] [-fov degrees] [-repeat N] [-out prefix]" << std::endl;
+		return 1;
+	}
+
+	ThreadPool tp(threads);
+	TessModel<double> model;
+	bool loaded = EndsWith(path, ".obj") ? LoadOBJ(model, path, &tp) : LoadSTL(model, path, &tp);
+	if (!loaded || model.TrianglesCount() == 0)
+	{
+		std::cerr << "cannot load " << path << std::endl;
+		return 1;
+	}
+	model.RebuildAcceleration(&tp);
+
+	AABB<double> box = model.Bounds();
+	double radius = box.Extent().Length() / 2, angle = fov * 3.14159265358979323846 / 180;
+	Vector<double> view = Vector<double>(1, -2, 1).Normalize() * (radius / std::sin(std::min(angle, (double)width / height * angle) / 2));
+	Camera<double> camera = Camera<double>::LookAt(box.Center() + view, box.Center(), Vector<double>(0, 0, 1), angle);
+
+	//the best of the repeats, the first one also pays for page faults of the buffers
+	RaycastImage<double> image;
+	double best = 0;
+	for (int i = 0; i < repeat; i++)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		Raycast(model, camera, image, width, height, &tp, tile);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		best = i == 0 ? seconds : std::min(best, seconds);
+	}
+	std::cout << model.TrianglesCount() << " triangles, " << width << "x" << height << " rays, " << image.HitsCount() << " hits, "
+		<< best << " s, " << (best > 0 ? (double)width * height / best / 1e6 : 0) << " Mrays/s" << std::endl;
+
+	if (!image.SaveDepthPGM(prefix + "_depth.pgm") || !image.SaveDepthPFM(prefix + "_depth.pfm") ||
+		!image.SaveNormalsPFM(prefix + "_normals.pfm") || !image.SaveSurfacesPGM(prefix + "_surfaces.pgm"))
+	{
+		std::cerr << "cannot write the images " << prefix << "_*" << std::endl;
+		return 1;
+	}
+	return 0;
+}
\ No newline at end of file